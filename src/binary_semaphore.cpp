@@ -0,0 +1,77 @@
+#include "binary_semaphore.h"
+#include "serial_exc.h"
+
+#include <cerrno>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+TBinarySemaphore::TBinarySemaphore(): Fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (Fd < 0) {
+        throw std::runtime_error("can't create eventfd: " + FormatErrno(errno));
+    }
+}
+
+TBinarySemaphore::~TBinarySemaphore()
+{
+    close(Fd);
+}
+
+bool TBinarySemaphore::Wait(std::chrono::microseconds timeout)
+{
+    timeout = std::max(timeout, std::chrono::microseconds::zero());
+    timespec ts;
+    ts.tv_sec = timeout.count() / 1000000;
+    ts.tv_nsec = (timeout.count() % 1000000) * 1000;
+    pollfd fd{Fd, POLLIN, 0};
+    int r = ppoll(&fd, 1, &ts, nullptr);
+    if (r < 0 && errno != EINTR) {
+        throw std::runtime_error("eventfd poll failed: " + FormatErrno(errno));
+    }
+    std::lock_guard<std::mutex> lock(Mutex);
+    return std::any_of(Signals.begin(), Signals.end(), [](PBinarySemaphoreSignal item) { return item->value; });
+}
+
+bool TBinarySemaphore::GetSignalValue(PBinarySemaphoreSignal signal)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    bool r = signal->value;
+    signal->value = false;
+    if (r && std::none_of(Signals.begin(), Signals.end(), [](PBinarySemaphoreSignal item) { return item->value; })) {
+        uint64_t value;
+        if (read(Fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+            throw std::runtime_error("eventfd read failed: " + FormatErrno(errno));
+        }
+    }
+    return r;
+}
+
+void TBinarySemaphore::Signal(PBinarySemaphoreSignal signal)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (signal->value) {
+        return;
+    }
+    signal->value = true;
+    uint64_t value = 1;
+    if (write(Fd, &value, sizeof(value)) < 0) {
+        throw std::runtime_error("eventfd write failed: " + FormatErrno(errno));
+    }
+}
+
+PBinarySemaphoreSignal TBinarySemaphore::MakeSignal()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    PBinarySemaphoreSignal new_signal = std::make_shared<TBinarySemaphoreSignal>();
+    Signals.push_back(new_signal);
+    new_signal->value = false;
+    return new_signal;
+}
+
+int TBinarySemaphore::GetFd() const
+{
+    return Fd;
+}
@@ -2,7 +2,6 @@
 
 #include <algorithm>
 #include <chrono>
-#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -15,47 +14,39 @@ public:
 
 typedef std::shared_ptr<TBinarySemaphoreSignal> PBinarySemaphoreSignal;
 
+/**
+ * @brief Signals are delivered by eventfd, so a port thread can wait for them together with port's descriptors
+ */
 class TBinarySemaphore
 {
 public:
+    TBinarySemaphore();
+    ~TBinarySemaphore();
+
+    TBinarySemaphore(const TBinarySemaphore&) = delete;
+    TBinarySemaphore& operator=(const TBinarySemaphore&) = delete;
+
+    //! Returns true if a signal is set before the time point
     template<class Clock, class Duration> bool Wait(const std::chrono::time_point<Clock, Duration>& until)
     {
-        std::unique_lock<std::mutex> lock(Mutex);
-
-        return Cond.wait_until(lock, until, [this]() {
-            return std::any_of(Signals.begin(), Signals.end(), [](PBinarySemaphoreSignal item) { return item->value; });
-        });
+        return Wait(std::chrono::ceil<std::chrono::microseconds>(until - Clock::now()));
     }
 
-    bool GetSignalValue(PBinarySemaphoreSignal signal)
-    {
-        std::lock_guard<std::mutex> lock(Mutex);
+    bool GetSignalValue(PBinarySemaphoreSignal signal);
 
-        bool r = signal->value;
-        signal->value = false;
-        return r;
-    }
+    void Signal(PBinarySemaphoreSignal signal);
 
-    void Signal(PBinarySemaphoreSignal signal)
-    {
-        std::lock_guard<std::mutex> lock(Mutex);
-        signal->value = true;
-        Cond.notify_all();
-    }
+    PBinarySemaphoreSignal MakeSignal();
 
-    PBinarySemaphoreSignal MakeSignal()
-    {
-        std::lock_guard<std::mutex> lock(Mutex);
-        PBinarySemaphoreSignal new_signal = std::make_shared<TBinarySemaphoreSignal>();
-        Signals.push_back(new_signal);
-        new_signal->value = false;
-        return new_signal;
-    }
+    //! The descriptor is readable while any signal is set
+    int GetFd() const;
 
 private:
     std::vector<PBinarySemaphoreSignal> Signals;
     std::mutex Mutex;
-    std::condition_variable Cond;
+    int Fd;
+
+    bool Wait(std::chrono::microseconds timeout);
 };
 
 typedef std::shared_ptr<TBinarySemaphore> PBinarySemaphore;
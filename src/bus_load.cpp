@@ -0,0 +1,148 @@
+#include "bus_load.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "log.h"
+#include "read_plan.h"
+#include "serial_device.h"
+
+#define LOG(logger) logger.Log() << "[bus load] "
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+namespace
+{
+    // Part of bus time reserved for writes, events reading and retries
+    const double MAX_POLLING_LOAD = 0.9;
+
+    double GetLoad(microseconds pollTime, milliseconds period)
+    {
+        if (period <= milliseconds::zero()) {
+            return 0;
+        }
+        return duration_cast<duration<double>>(pollTime).count() / duration_cast<duration<double>>(period).count();
+    }
+
+    std::string FormatLoad(double load)
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << load * 100 << "%";
+        return ss.str();
+    }
+
+    std::string FormatLoad(const TBusLoad& load)
+    {
+        std::stringstream ss;
+        ss << "high priority " << FormatLoad(load.HighPriority) << ", low priority " << FormatLoad(load.LowPriority)
+           << ", low priority cycle " << duration_cast<milliseconds>(load.LowPriorityCycleTime).count() << " ms, "
+           << load.Requests << " requests";
+        if (load.UnestimatedRequests) {
+            ss << " (" << load.UnestimatedRequests << " without estimation)";
+        }
+        return ss.str();
+    }
+
+    Json::Value ToJson(const TBusLoad& load)
+    {
+        Json::Value res;
+        res["high_priority_load"] = load.HighPriority;
+        res["low_priority_load"] = load.LowPriority;
+        res["low_priority_cycle_ms"] = Json::Int64(duration_cast<milliseconds>(load.LowPriorityCycleTime).count());
+        res["requests"] = Json::UInt64(load.Requests);
+        res["unestimated_requests"] = Json::UInt64(load.UnestimatedRequests);
+        return res;
+    }
+}
+
+void TBusLoad::Add(const TBusLoad& other)
+{
+    HighPriority += other.HighPriority;
+    LowPriority += other.LowPriority;
+    LowPriorityCycleTime += other.LowPriorityCycleTime;
+    Requests += other.Requests;
+    UnestimatedRequests += other.UnestimatedRequests;
+}
+
+bool TBusLoadReport::IsFeasible() const
+{
+    return Total.HighPriority + Total.LowPriority <= MAX_POLLING_LOAD;
+}
+
+Json::Value TBusLoadReport::ToJson() const
+{
+    auto res = ::ToJson(Total);
+    res["feasible"] = IsFeasible();
+    Json::Value devices(Json::arrayValue);
+    for (const auto& device: Devices) {
+        auto item = ::ToJson(device.Load);
+        item["device"] = device.Device->ToString();
+        devices.append(item);
+    }
+    res["devices"] = devices;
+    return res;
+}
+
+TBusLoadReport CalculateBusLoad(const std::list<PRegister>& regList, const TSerialClientSettings& settings)
+{
+    TBusLoadReport report;
+    TReadPlan plan(settings);
+    plan.Build(regList);
+    for (const auto& device: plan.GetDevices()) {
+        TDeviceBusLoad deviceLoad{device, TBusLoad()};
+        for (const auto& entry: plan.GetEntries(device)) {
+            auto& load = deviceLoad.Load;
+            ++load.Requests;
+            if (entry->PollTime == microseconds::zero()) {
+                ++load.UnestimatedRequests;
+                continue;
+            }
+            const auto& reg = entry->Registers.front();
+            if (reg->IsHighPriority()) {
+                load.HighPriority += GetLoad(entry->PollTime, *reg->ReadPeriod);
+            } else if (reg->ReadRateLimit) {
+                load.LowPriority += GetLoad(entry->PollTime, *reg->ReadRateLimit);
+            } else {
+                load.LowPriorityCycleTime += entry->PollTime;
+            }
+        }
+        report.Total.Add(deviceLoad.Load);
+        report.Devices.push_back(deviceLoad);
+    }
+    return report;
+}
+
+void LogBusLoad(const std::string& portDescription, const TBusLoadReport& report)
+{
+    for (const auto& device: report.Devices) {
+        LOG(Info) << portDescription << " " << device.Device->ToString() << ": " << FormatLoad(device.Load);
+    }
+    LOG(Info) << portDescription << " total: " << FormatLoad(report.Total);
+    if (report.Total.HighPriority > MAX_POLLING_LOAD) {
+        LOG(Warn) << portDescription << " registers with read_period_ms need "
+                  << FormatLoad(report.Total.HighPriority)
+                  << " of bus time, configured read periods can't be met at current baud rate";
+    } else if (!report.IsFeasible()) {
+        LOG(Warn) << portDescription << " registers with read_period_ms and read_rate_limit_ms need "
+                  << FormatLoad(report.Total.HighPriority + report.Total.LowPriority)
+                  << " of bus time, low priority registers will delay high priority ones";
+    }
+}
+
+double StretchLowPriorityRateLimits(const std::list<PRegister>& regList, const TBusLoadReport& report)
+{
+    const auto available = MAX_POLLING_LOAD - report.Total.HighPriority;
+    if (report.Total.LowPriority <= available || available <= 0) {
+        return 1;
+    }
+    const auto factor = report.Total.LowPriority / available;
+    for (const auto& reg: regList) {
+        if (!reg->IsHighPriority() && reg->ReadRateLimit) {
+            auto rateLimit = std::ceil(reg->ReadRateLimit->count() * factor);
+            reg->ReadRateLimit = milliseconds(static_cast<milliseconds::rep>(rateLimit));
+        }
+    }
+    return factor;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <wblib/json/json.h>
+
+#include "register.h"
+#include "serial_client_settings.h"
+
+class TSerialDevice;
+typedef std::shared_ptr<TSerialDevice> PSerialDevice;
+
+//! Share of bus time, which is needed to poll registers with configured periods
+struct TBusLoad
+{
+    //! Load of high priority registers, i.e. registers with read_period_ms
+    double HighPriority = 0;
+
+    //! Load of low priority registers with read_rate_limit_ms
+    double LowPriority = 0;
+
+    //! Time to read once all low priority registers without read_rate_limit_ms
+    std::chrono::microseconds LowPriorityCycleTime = std::chrono::microseconds::zero();
+
+    //! Number of planned read requests
+    size_t Requests = 0;
+
+    //! Number of requests without poll time estimation, they are not counted in load
+    size_t UnestimatedRequests = 0;
+
+    void Add(const TBusLoad& other);
+};
+
+struct TDeviceBusLoad
+{
+    PSerialDevice Device;
+    TBusLoad Load;
+};
+
+/**
+ * @brief Bus utilisation of a port estimated by devices' request cost models.
+ *        Registers are grouped into requests as in the port's read plan.
+ *        Without merging every register is counted as a separate request,
+ *        though the serial client may read some of them together.
+ *        Registers with unknown availability are not merged by some protocols,
+ *        so the estimation made at startup is an upper bound.
+ */
+struct TBusLoadReport
+{
+    std::vector<TDeviceBusLoad> Devices;
+    TBusLoad Total;
+
+    //! All configured read periods and rate limits fit bus capacity with a reserve for writes and retries
+    bool IsFeasible() const;
+
+    Json::Value ToJson() const;
+};
+
+//! Register ranges are taken from devices' pools, which belong to the polling thread.
+//! So the function must be called by the polling thread or before polling is started
+TBusLoadReport CalculateBusLoad(const std::list<PRegister>& regList, const TSerialClientSettings& settings);
+
+void LogBusLoad(const std::string& portDescription, const TBusLoadReport& report);
+
+/**
+ * @brief Increases read_rate_limit_ms of low priority registers,
+ *        so low and high priority registers together fit bus capacity.
+ *        Registers without read_rate_limit_ms use remaining bus time and are not changed.
+ *
+ * @return factor rate limits are multiplied by, 1 if they are not changed
+ */
+double StretchLowPriorityRateLimits(const std::list<PRegister>& regList, const TBusLoadReport& report);
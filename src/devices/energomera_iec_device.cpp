@@ -1,5 +1,6 @@
 #include "energomera_iec_device.h"
 
+#include <algorithm>
 #include <string.h>
 
 #include "iec_common.h"
@@ -58,8 +59,7 @@ namespace
 
         void UpdateMasks()
         {
-            std::list<PRegister> sortedRegList = RegisterList();
-            sortedRegList.sort([](const PRegister& a, const PRegister& b) -> bool {
+            std::stable_sort(RegisterList().begin(), RegisterList().end(), [](const PRegister& a, const PRegister& b) {
                 if (GetParamId(a) < GetParamId(b))
                     return true;
                 if (GetParamId(a) > GetParamId(b))
@@ -72,7 +72,6 @@ namespace
 
                 return false;
             });
-            RegisterList().swap(sortedRegList);
             for (auto reg: RegisterList()) {
                 auto param_id = GetParamId(reg);
                 auto value_num = GetValueNum(reg);
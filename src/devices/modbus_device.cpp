@@ -1,5 +1,13 @@
 #include "modbus_device.h"
+#include "log.h"
 #include "modbus_common.h"
+#include "serial_port.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 
 #define LOG(logger) logger.Log() << "[modbus] "
 
@@ -12,6 +20,52 @@ namespace
                                               {Modbus::REG_DISCRETE, "discrete", "switch", U8, true},
                                               {Modbus::REG_INPUT, "input", "value", U16, true}});
 
+    const std::string READ_REGISTERS_LIMITS_DIR = "/var/lib/wb-mqtt-serial/max_read_registers";
+
+    //! Limits are shared by devices of the same type with the same slave id on the same port.
+    //! Serial ports are told apart by device path, other ports by full description with TCP address and port
+    std::string GetReadRegistersLimitFileName(const TPort& port, const TDeviceConfig& config, const IProtocol& protocol)
+    {
+        auto portName = dynamic_cast<const TSerialPort*>(&port) ? port.GetDescription(false) : port.GetDescription();
+        auto name = portName + "_" + (config.DeviceType.empty() ? protocol.GetName() : config.DeviceType) + "_" +
+                    config.SlaveId;
+        std::replace_if(
+            name.begin(),
+            name.end(),
+            [](unsigned char c) { return !std::isalnum(c) && c != '-' && c != '_'; },
+            '_');
+        name.erase(0, name.find_first_not_of('_'));
+        return READ_REGISTERS_LIMITS_DIR + "/" + name;
+    }
+
+    //! The file stores the limit and its upper bound. The limit is searched again if the bound is changed
+    int LoadReadRegistersLimit(const std::string& fileName, int maxCount)
+    {
+        std::ifstream f(fileName);
+        int limit = 0;
+        int storedMaxCount = 0;
+        if (!(f >> limit >> storedMaxCount) || limit <= 0 || storedMaxCount != maxCount) {
+            return 0;
+        }
+        return limit;
+    }
+
+    void SaveReadRegistersLimit(const std::string& fileName, const Modbus::TReadRegistersLimit& limit)
+    {
+        // Write and rename, so the file isn't left half written on power loss
+        std::error_code ec;
+        std::filesystem::create_directories(READ_REGISTERS_LIMITS_DIR, ec);
+        const auto tmpFileName = fileName + ".tmp";
+        {
+            std::ofstream f(tmpFileName);
+            f << limit.Get() << " " << limit.GetMaxCount();
+            if (!f) {
+                throw std::runtime_error("can't write " + tmpFileName);
+            }
+        }
+        std::filesystem::rename(tmpFileName, fileName);
+    }
+
     class TModbusProtocol: public IProtocol
     {
     public:
@@ -48,16 +102,66 @@ TModbusDevice::TModbusDevice(std::unique_ptr<Modbus::IModbusTraits> modbusTraits
       TUInt32SlaveId(config.CommonConfig->SlaveId),
       ModbusTraits(std::move(modbusTraits)),
       ResponseTime(std::chrono::milliseconds::zero()),
-      EnableWbContinuousRead(config.EnableWbContinuousRead)
+      EnableWbContinuousRead(config.EnableWbContinuousRead),
+      MaxWriteRegisters(config.MaxWriteRegisters),
+      MaxWriteRegHole(config.MaxWriteRegHole),
+      AutoHoles(config.AutoHoles),
+      EnableReadWriteMultipleRegisters(config.EnableReadWriteMultipleRegisters)
 {
     config.CommonConfig->FrameTimeout =
         std::max(config.CommonConfig->FrameTimeout,
                  std::chrono::ceil<std::chrono::milliseconds>(port->GetSendTimeBytes(3.5)));
+    if (config.AutoMaxReadRegisters) {
+        // Unknown limit is the configured value until the device rejects a request.
+        // Stored limit replaces the configured value after the first read
+        const auto maxCount = config.CommonConfig->MaxReadRegisters;
+        const auto fileName = GetReadRegistersLimitFileName(*port, *config.CommonConfig, *protocol);
+        ReadRegistersLimit =
+            std::make_shared<Modbus::TReadRegistersLimit>(maxCount, LoadReadRegistersLimit(fileName, maxCount));
+    }
 }
 
 PRegisterRange TModbusDevice::CreateRegisterRange() const
 {
-    return Modbus::CreateRegisterRange(ResponseTime.GetValue());
+    auto range = RangePool.Get(ResponseTime.GetValue());
+    if (AutoHoles) {
+        range->SetAutoHoles(GetAutoHoles());
+    }
+    range->SetReadRegistersLimit(ReadRegistersLimit);
+    return range;
+}
+
+Modbus::THoles TModbusDevice::GetAutoHoles() const
+{
+    auto holes = Modbus::GetCostEffectiveHoles(*Port(), *DeviceConfig(), ResponseTime.GetValue());
+    // Response time jitter shouldn't change ranges every cycle
+    auto isChanged = [](int oldValue, int newValue) { return std::abs(newValue - oldValue) * 4 > oldValue; };
+    if (isChanged(CostEffectiveHoles.Registers, holes.Registers) || isChanged(CostEffectiveHoles.Bits, holes.Bits)) {
+        CostEffectiveHoles = holes;
+        LOG(Info) << "device " << ToString() << ": max_reg_hole " << holes.Registers << ", max_bit_hole " << holes.Bits
+                  << " are chosen by response time " << ResponseTime.GetValue().count() << " us";
+    }
+    return CostEffectiveHoles;
+}
+
+void TModbusDevice::UpdateMaxReadRegisters()
+{
+    if (!ReadRegistersLimit || DeviceConfig()->MaxReadRegisters == ReadRegistersLimit->Get()) {
+        return;
+    }
+    DeviceConfig()->MaxReadRegisters = ReadRegistersLimit->Get();
+    if (!ReadRegistersLimit->IsLearned()) {
+        LOG(Info) << "device " << ToString() << ": trying max_read_registers " << ReadRegistersLimit->Get();
+        return;
+    }
+    LOG(Info) << "device " << ToString() << ": max_read_registers " << ReadRegistersLimit->Get() << " is found";
+    const auto fileName = GetReadRegistersLimitFileName(*Port(), *DeviceConfig(), *Protocol());
+    try {
+        SaveReadRegistersLimit(fileName, *ReadRegistersLimit);
+    } catch (const std::exception& e) {
+        LOG(Warn) << "device " << ToString() << ": failed to save max_read_registers to " << fileName << ": "
+                  << e.what();
+    }
 }
 
 void TModbusDevice::WriteRegisterImpl(PRegister reg, const TRegisterValue& value)
@@ -65,6 +169,52 @@ void TModbusDevice::WriteRegisterImpl(PRegister reg, const TRegisterValue& value
     Modbus::WriteRegister(*ModbusTraits, *Port(), SlaveId, *reg, value, ModbusCache);
 }
 
+void TModbusDevice::WriteRegistersImpl(std::vector<TRegisterWrite>& writes)
+{
+    if (MaxWriteRegisters > 1) {
+        Modbus::WriteRegisters(*ModbusTraits, *Port(), SlaveId, writes, ModbusCache, MaxWriteRegisters, MaxWriteRegHole);
+    }
+}
+
+bool TModbusDevice::SupportsWriteAndRead() const
+{
+    return EnableReadWriteMultipleRegisters;
+}
+
+void TModbusDevice::WriteRegisterAndReadRangeImpl(TRegisterWrite& write, PRegisterRange range)
+{
+    auto modbusRange = std::dynamic_pointer_cast<Modbus::TModbusRegisterRange>(range);
+    if (!EnableReadWriteMultipleRegisters || !modbusRange) {
+        return;
+    }
+    try {
+        write.Done = Modbus::WriteRegisterAndReadRange(*ModbusTraits,
+                                                       *Port(),
+                                                       SlaveId,
+                                                       *write.Register,
+                                                       write.Value,
+                                                       *modbusRange,
+                                                       ModbusCache);
+        if (write.Done) {
+            ResponseTime.AddValue(modbusRange->GetResponseTime());
+        }
+    } catch (const Modbus::TIllegalFunctionError& e) {
+        LOG(Warn) << "device " << ToString()
+                  << " doesn't support read/write multiple registers function, writes and reads are made separately";
+        EnableReadWriteMultipleRegisters = false;
+    } catch (const TSerialDevicePermanentRegisterException& e) {
+        // The same as for reads, holes are the first suspect. Otherwise the write or some of read registers
+        // is rejected, separate requests find out which one
+        if (modbusRange->HasHoles()) {
+            SetSupportsHoles(false);
+        }
+        LOG(Debug) << "device " << ToString() << " rejected combined write and read: " << e.what();
+        throw;
+    } catch (const TSerialDeviceException& e) {
+        LOG(Debug) << "combined write and read failed, they will be made separately: " << e.what();
+    }
+}
+
 void TModbusDevice::ReadRegisterRange(PRegisterRange range)
 {
     auto modbus_range = std::dynamic_pointer_cast<Modbus::TModbusRegisterRange>(range);
@@ -73,6 +223,24 @@ void TModbusDevice::ReadRegisterRange(PRegisterRange range)
     }
     Modbus::ReadRegisterRange(*ModbusTraits, *Port(), SlaveId, *modbus_range, ModbusCache);
     ResponseTime.AddValue(modbus_range->GetResponseTime());
+    UpdateMaxReadRegisters();
+}
+
+void TModbusDevice::ReadRegisterRanges(const std::vector<PRegisterRange>& ranges, size_t maxRequestsInFlight)
+{
+    std::vector<Modbus::TModbusRegisterRange*> modbusRanges;
+    for (const auto& range: ranges) {
+        auto modbusRange = dynamic_cast<Modbus::TModbusRegisterRange*>(range.get());
+        if (!modbusRange) {
+            throw std::runtime_error("modbus range expected");
+        }
+        modbusRanges.push_back(modbusRange);
+    }
+    Modbus::ReadRegisterRanges(*ModbusTraits, *Port(), SlaveId, modbusRanges, ModbusCache, maxRequestsInFlight);
+    for (const auto range: modbusRanges) {
+        ResponseTime.AddValue(range->GetResponseTime());
+    }
+    UpdateMaxReadRegisters();
 }
 
 void TModbusDevice::WriteSetupRegisters()
@@ -21,6 +21,25 @@ public:
      *
      */
     bool EnableWbContinuousRead = false;
+
+    //! Maximum number of registers written by a single request. 1 disables combining of writes
+    int MaxWriteRegisters = 1;
+
+    //! Maximum number of not written registers between written ones, which are filled by cached values.
+    //! 0 - only registers with adjacent addresses are written together
+    int MaxWriteRegHole = 0;
+
+    //! Increase max_reg_hole and max_bit_hole up to sizes of holes which are read faster than a separate request
+    bool AutoHoles = false;
+
+    //! Find maximum number of registers in a read request by errors of large requests.
+    //! The search starts from configured max_read_registers, which is also the upper bound of the found value.
+    //! The found value is stored and used instead of max_read_registers
+    bool AutoMaxReadRegisters = false;
+
+    //! The device supports read/write multiple registers function (0x17),
+    //! so a write and the next read of holding registers can be done by one request
+    bool EnableReadWriteMultipleRegisters = false;
 };
 
 template<class Dev> class TModbusDeviceFactory: public IDeviceFactory
@@ -43,6 +62,11 @@ public:
         TModbusDeviceConfig config;
         config.CommonConfig = deviceConfig;
         WBMQTT::JSON::Get(data, "enable_wb_continuous_read", config.EnableWbContinuousRead);
+        WBMQTT::JSON::Get(data, "max_write_registers", config.MaxWriteRegisters);
+        WBMQTT::JSON::Get(data, "max_write_reg_hole", config.MaxWriteRegHole);
+        WBMQTT::JSON::Get(data, "auto_holes", config.AutoHoles);
+        WBMQTT::JSON::Get(data, "auto_max_read_registers", config.AutoMaxReadRegisters);
+        WBMQTT::JSON::Get(data, "enable_read_write_multiple_registers", config.EnableReadWriteMultipleRegisters);
         auto dev = std::make_shared<Dev>(ModbusTraitsFactory->GetModbusTraits(port), config, port, protocol);
         dev->InitSetupItems();
         return dev;
@@ -53,8 +77,23 @@ class TModbusDevice: public TSerialDevice, public TUInt32SlaveId
 {
     std::unique_ptr<Modbus::IModbusTraits> ModbusTraits;
     Modbus::TRegisterCache ModbusCache;
+    mutable Modbus::TRegisterRangePool RangePool;
     TRunningAverage<std::chrono::microseconds, 10> ResponseTime;
     bool EnableWbContinuousRead;
+    int MaxWriteRegisters;
+    int MaxWriteRegHole;
+    bool AutoHoles;
+    bool EnableReadWriteMultipleRegisters;
+
+    //! Holes chosen by cost of requests, they are changed only on significant change of the cost
+    mutable Modbus::THoles CostEffectiveHoles;
+
+    Modbus::THoles GetAutoHoles() const;
+
+    //! Set only if max_read_registers is found automatically
+    Modbus::PReadRegistersLimit ReadRegistersLimit;
+
+    void UpdateMaxReadRegisters();
 
 public:
     TModbusDevice(std::unique_ptr<Modbus::IModbusTraits> modbusTraits,
@@ -64,6 +103,8 @@ public:
 
     PRegisterRange CreateRegisterRange() const override;
     void ReadRegisterRange(PRegisterRange range) override;
+    void ReadRegisterRanges(const std::vector<PRegisterRange>& ranges, size_t maxRequestsInFlight) override;
+    bool SupportsWriteAndRead() const override;
     void WriteSetupRegisters() override;
 
     void OnEnabledEvent(uint16_t addr, bool res);
@@ -72,4 +113,6 @@ public:
 
 protected:
     void WriteRegisterImpl(PRegister reg, const TRegisterValue& value) override;
+    void WriteRegistersImpl(std::vector<TRegisterWrite>& writes) override;
+    void WriteRegisterAndReadRangeImpl(TRegisterWrite& write, PRegisterRange range) override;
 };
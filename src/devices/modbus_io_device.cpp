@@ -68,7 +68,7 @@ TModbusIODevice::TModbusIODevice(std::unique_ptr<Modbus::IModbusTraits> modbusTr
 
 PRegisterRange TModbusIODevice::CreateRegisterRange() const
 {
-    return Modbus::CreateRegisterRange(ResponseTime.GetValue());
+    return RangePool.Get(ResponseTime.GetValue());
 }
 
 void TModbusIODevice::WriteRegisterImpl(PRegister reg, const TRegisterValue& value)
@@ -13,6 +13,7 @@ class TModbusIODevice: public TSerialDevice, public TUInt32SlaveId
     std::unique_ptr<Modbus::IModbusTraits> ModbusTraits;
     int Shift = 0;
     Modbus::TRegisterCache ModbusCache;
+    mutable Modbus::TRegisterRangePool RangePool;
     TRunningAverage<std::chrono::microseconds, 10> ResponseTime;
 
 public:
@@ -1,12 +1,12 @@
 #include "file_descriptor_port.h"
-#include "binary_semaphore.h"
 #include "common_utils.h"
 #include "serial_exc.h"
 
 #include <iomanip>
 #include <iostream>
+#include <poll.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
+#include <thread>
 #include <unistd.h>
 #include <wblib/utils.h>
 
@@ -73,18 +73,16 @@ void TFileDescriptorPort::WriteBytes(const uint8_t* buf, int count)
 
 bool TFileDescriptorPort::Select(const chrono::microseconds& us)
 {
-    fd_set rfds;
-    struct timeval tv, *tvp = 0;
-
-    FD_ZERO(&rfds);
-    FD_SET(Fd, &rfds);
+    // poll() is used instead of select() as descriptors of TCP ports can exceed FD_SETSIZE
+    pollfd fd{Fd, POLLIN, 0};
+    timespec ts, *tsp = nullptr;
     if (us.count() > 0) {
-        tv.tv_sec = us.count() / 1000000;
-        tv.tv_usec = us.count() % 1000000;
-        tvp = &tv;
+        ts.tv_sec = us.count() / 1000000;
+        ts.tv_nsec = (us.count() % 1000000) * 1000;
+        tsp = &ts;
     }
 
-    int r = select(Fd + 1, &rfds, NULL, NULL, tvp);
+    int r = ppoll(&fd, 1, tsp, nullptr);
     if (r < 0) {
         throw TSerialDeviceErrnoException("TFileDescriptorPort::Select() failed: ", errno);
     }
@@ -243,3 +241,26 @@ void TFileDescriptorPort::SleepSinceLastInteraction(const chrono::microseconds&
     std::this_thread::sleep_for(us - delta);
     LOG(Debug) << GetDescription(false) << ": Sleep " << us.count() << " us";
 }
+
+bool TFileDescriptorPort::SleepSinceLastInteractionOrWakeup(const chrono::microseconds& us, int wakeupFd)
+{
+    auto now = chrono::steady_clock::now();
+    auto timeout = us - chrono::duration_cast<chrono::microseconds>(now - LastInteraction);
+    if (timeout <= chrono::microseconds::zero()) {
+        return true;
+    }
+    timespec ts;
+    ts.tv_sec = timeout.count() / 1000000;
+    ts.tv_nsec = (timeout.count() % 1000000) * 1000;
+    pollfd fd{wakeupFd, POLLIN, 0};
+    int r = ppoll(&fd, 1, &ts, nullptr);
+    if (r < 0 && errno != EINTR) {
+        throw TSerialDeviceErrnoException("TFileDescriptorPort::SleepSinceLastInteractionOrWakeup() failed: ", errno);
+    }
+    if (r > 0) {
+        LOG(Debug) << GetDescription(false) << ": Sleep " << us.count() << " us is cut short";
+        return false;
+    }
+    LOG(Debug) << GetDescription(false) << ": Sleep " << us.count() << " us";
+    return true;
+}
@@ -24,6 +24,7 @@ public:
     bool IsOpen() const override;
 
     void SleepSinceLastInteraction(const std::chrono::microseconds& us) override;
+    bool SleepSinceLastInteractionOrWakeup(const std::chrono::microseconds& us, int wakeupFd) override;
 
 protected:
     bool Select(const std::chrono::microseconds& us);
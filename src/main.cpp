@@ -17,6 +17,7 @@
 #include "config_schema_generator.h"
 
 #include "device_template_generator.h"
+#include "poll_simulator.h"
 #include "rpc_config.h"
 #include "rpc_handler.h"
 #include "serial_port.h"
@@ -76,6 +77,8 @@ namespace
              << "  -j                 Make JSON for wb-mqtt-confed from /etc/wb-mqtt-serial.conf" << endl
              << "  -J                 Make /etc/wb-mqtt-serial.conf from wb-mqtt-confed output" << endl
              << "  -G       options   Generate device template. Type \"-G help\" for options description" << endl
+             << "  -S       options   Simulate polling of registers from config without real devices." << endl
+             << "                     Type \"-S help\" for options description" << endl
              << "  -v                 Print the version" << endl;
     }
 
@@ -199,11 +202,29 @@ namespace
         exit(2);
     }
 
+    bool SimulatePolling(const string& configFilename, const char* options)
+    {
+        return ::SimulatePolling(APP_NAME, options, [&](TPortFactoryFn portFactory) {
+            TSerialDeviceFactory deviceFactory;
+            RegisterProtocols(deviceFactory);
+            shared_ptr<Json::Value> configSchema;
+            shared_ptr<TTemplateMap> templates;
+            std::tie(configSchema, templates) = LoadTemplates();
+            return LoadConfig(configFilename,
+                              deviceFactory,
+                              *configSchema,
+                              *templates,
+                              std::make_shared<TRPCConfig>(),
+                              portFactory);
+        });
+    }
+
     void ParseCommadLine(int argc, char* argv[], WBMQTT::TMosquittoMqttConfig& mqttConfig, string& customConfig)
     {
         int c;
+        const char* simulationOptions = nullptr;
 
-        while ((c = getopt(argc, argv, "d:c:h:H:p:u:P:T:jJgG:v")) != -1) {
+        while ((c = getopt(argc, argv, "d:c:h:H:p:u:P:T:jJgG:S:v")) != -1) {
             switch (c) {
                 case 'd':
                     SetDebugLevel(optarg);
@@ -239,6 +260,9 @@ namespace
                 case 'G':
                     GenerateDeviceTemplate(APP_NAME, USER_TEMPLATES_DIR, optarg);
                     exit(EXIT_SUCCESS);
+                case 'S':
+                    simulationOptions = optarg;
+                    break;
                 case 'v':
                     PrintStartupInfo();
                     exit(EXIT_SUCCESS);
@@ -255,6 +279,11 @@ namespace
                 cout << "Skipping unknown argument " << argv[index] << endl;
             }
         }
+
+        // Simulation needs config file, so it is started after all options are parsed
+        if (simulationOptions) {
+            exit(SimulatePolling(customConfig, simulationOptions) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
     }
 }
 
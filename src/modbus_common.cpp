@@ -4,9 +4,13 @@
 #include "log.h"
 #include "serial_device.h"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
 #include <math.h>
 #include <netinet/in.h>
 #include <string.h>
@@ -25,6 +29,9 @@ namespace Modbus // modbus protocol declarations
 
     const int MAX_READ_REGISTERS = 125;
 
+    // Maximum number of registers written by read/write multiple registers request
+    const int MAX_READ_WRITE_REGISTERS = 121;
+
     const size_t EXCEPTION_RESPONSE_PDU_SIZE = 2;
     const size_t WRITE_RESPONSE_PDU_SIZE = 5;
 
@@ -33,6 +40,15 @@ namespace Modbus // modbus protocol declarations
 
     const uint16_t ENABLE_CONTINUOUS_READ_REGISTER = 114;
 
+    // Modbus TCP ADU: 7 bytes MBAP header and up to 253 bytes PDU
+    const size_t MAX_ADU_SIZE = 260;
+
+    // Each device has its own pool. Only ranges of one poll cycle are alive at once, so few of them are kept
+    const size_t MAX_POOLED_RANGES = 8;
+
+    // Enough for read plans of most devices, requests of larger plans are replaced one by one
+    const size_t MAX_CACHED_READ_REQUESTS = 32;
+
     enum Error : uint8_t
     {
         ERR_NONE = 0x0,
@@ -57,6 +73,14 @@ namespace Modbus // modbus protocol declarations
         };
     };
 
+    //! Words composed for writing to consecutive addresses
+    struct TWrittenWords
+    {
+        int Type = 0;
+        int Address = 0;
+        std::vector<uint16_t> Values;
+    };
+
     void ComposeReadRequestPDU(uint8_t* pdu, const TModbusRegisterRange& range, int shift);
     size_t InferReadResponsePDUSize(int type, size_t registerCount);
     // parses modbus response and stores result
@@ -69,6 +93,10 @@ namespace Modbus // modbus protocol declarations
                                   const TRequest& request,
                                   TResponse& response,
                                   const TDeviceConfig& config);
+    void CheckResponse(IModbusTraits& traits,
+                       const TRequest& request,
+                       const TResponse& response,
+                       const TReadFrameResult& readResult);
 }
 
 namespace // general utilities
@@ -116,17 +144,228 @@ namespace Modbus // modbus protocol common utilities
     TInvalidCRCError::TInvalidCRCError(): TMalformedResponseError("invalid crc")
     {}
 
-    TModbusRegisterRange::TModbusRegisterRange(std::chrono::microseconds averageResponseTime)
-        : AverageResponseTime(averageResponseTime),
-          ResponseTime(averageResponseTime)
+    TTruncatedResponseError::TTruncatedResponseError(const std::string& what): TMalformedResponseError(what)
+    {}
+
+    TIllegalFunctionError::TIllegalFunctionError(): TSerialDevicePermanentRegisterException("illegal function")
+    {}
+
+    TIllegalDataValueError::TIllegalDataValueError(): TSerialDevicePermanentRegisterException("illegal data value")
     {}
 
-    TModbusRegisterRange::~TModbusRegisterRange()
+    const uint16_t* TRegisterCache::Find(int type, int address) const
+    {
+        if (type < 0 || static_cast<size_t>(type) >= Pages.size() || address < 0 || address > 0xFFFF) {
+            return nullptr;
+        }
+        const auto& page = Pages[type][address / PAGE_SIZE];
+        const auto index = address % PAGE_SIZE;
+        return (page && page->Known[index]) ? &page->Values[index] : nullptr;
+    }
+
+    TRegisterCache::TPage* TRegisterCache::GetPage(int type, int address)
+    {
+        if (type < 0 || address < 0 || address > 0xFFFF) {
+            return nullptr;
+        }
+        if (static_cast<size_t>(type) >= Pages.size()) {
+            Pages.resize(type + 1);
+        }
+        auto& page = Pages[type][address / PAGE_SIZE];
+        if (!page) {
+            page = std::make_unique<TPage>();
+        }
+        return page.get();
+    }
+
+    void TRegisterCache::Set(int type, int address, uint16_t value)
+    {
+        Set(type, address, &value, 1);
+    }
+
+    void TRegisterCache::Set(int type, int address, const uint16_t* values, size_t count)
+    {
+        while (count) {
+            auto page = GetPage(type, address);
+            if (!page) {
+                ++address;
+                ++values;
+                --count;
+                continue;
+            }
+            const size_t index = address % PAGE_SIZE;
+            const auto n = std::min(count, PAGE_SIZE - index);
+            std::copy(values, values + n, page->Values.begin() + index);
+            for (size_t i = index; i < index + n; ++i) {
+                page->Known.set(i);
+            }
+            address += n;
+            values += n;
+            count -= n;
+        }
+    }
+
+    const TRequest* TReadRequestCache::Find(uint64_t key) const
+    {
+        for (const auto& request: Requests) {
+            if (request.first == key) {
+                return &request.second;
+            }
+        }
+        return nullptr;
+    }
+
+    void TReadRequestCache::Add(uint64_t key, const TRequest& request)
+    {
+        if (Requests.size() < MAX_CACHED_READ_REQUESTS) {
+            Requests.emplace_back(key, request);
+            return;
+        }
+        auto& replaced = Requests[NextReplaced];
+        replaced.first = key;
+        replaced.second.assign(request.begin(), request.end());
+        NextReplaced = (NextReplaced + 1) % Requests.size();
+    }
+
+    TModbusRegisterRange::TModbusRegisterRange(std::chrono::microseconds averageResponseTime,
+                                               PReadRequestCache requestCache)
+        : RequestCache(requestCache),
+          AverageResponseTime(averageResponseTime),
+          ResponseTime(averageResponseTime)
+    {
+        Request.reserve(MAX_ADU_SIZE);
+        Response.reserve(MAX_ADU_SIZE);
+    }
+
+    bool THoles::operator==(const THoles& other) const
+    {
+        return Registers == other.Registers && Bits == other.Bits;
+    }
+
+    THoles GetCostEffectiveHoles(const TPort& port, const TDeviceConfig& config, std::chrono::microseconds responseTime)
+    {
+        // Time of one register's data is estimated on maximum response to reduce rounding error
+        const double wordTime = port.GetSendTimeBytes(MAX_READ_REGISTERS * 2).count() / double(MAX_READ_REGISTERS);
+        if (wordTime <= 0) {
+            return THoles();
+        }
+        // Request 8 bytes: SlaveID, Operation, Addr, Count, CRC
+        // Response 5 bytes except data: SlaveID, Operation, Size, CRC
+        const auto overhead = port.GetSendTimeBytes(8 + 5) + responseTime + config.RequestDelay +
+                              2 * std::chrono::duration_cast<std::chrono::microseconds>(config.FrameTimeout);
+        const double words = std::max<double>(overhead.count(), 0) / wordTime;
+        THoles holes;
+        holes.Registers = static_cast<int>(std::min<double>(words, MAX_READ_REGISTERS));
+        holes.Bits = static_cast<int>(std::min<double>(words * 16, MAX_READ_BITS));
+        return holes;
+    }
+
+    TReadRegistersLimit::TReadRegistersLimit(int maxCount, int learnedLimit)
+        : MaxCount(std::max(maxCount, 0)),
+          MaxGoodCount(std::max(learnedLimit, 0)),
+          Learned(learnedLimit > 0)
+    {
+        if (MaxCount != 0) {
+            MaxGoodCount = std::min(MaxGoodCount, MaxCount);
+        }
+    }
+
+    int TReadRegistersLimit::Get() const
+    {
+        if (Learned) {
+            return MaxGoodCount;
+        }
+        if (MinBadCount == 0) {
+            return MaxCount;
+        }
+        return std::max(1, (MaxGoodCount + MinBadCount) / 2);
+    }
+
+    int TReadRegistersLimit::GetMaxCount() const
+    {
+        return MaxCount;
+    }
+
+    bool TReadRegistersLimit::IsLearned() const
+    {
+        return Learned;
+    }
+
+    void TReadRegistersLimit::OnReadSuccess(int count)
+    {
+        // Failures of smaller or the same sizes aren't caused by request size
+        if (count >= FailedCount) {
+            FailedCount = 0;
+            Failures = 0;
+        }
+        if (Learned) {
+            Confirmed = Confirmed || (count >= MaxGoodCount);
+            return;
+        }
+        if (count <= MaxGoodCount) {
+            return;
+        }
+        MaxGoodCount = count;
+        Learned = ((MinBadCount != 0) && (MinBadCount - MaxGoodCount <= 1)) ||
+                  ((MaxCount != 0) && (MaxGoodCount >= MaxCount));
+        Confirmed = Learned;
+    }
+
+    bool TReadRegistersLimit::OnReadFailure(int count)
+    {
+        // Single registers and sizes already read successfully are rejected for other reasons
+        if (count <= 1 || count < MaxGoodCount || (count == MaxGoodCount && (!Learned || Confirmed))) {
+            return false;
+        }
+        // Ranges larger than the learned limit can be read before the device config is updated by it
+        if (Learned && count > MaxGoodCount) {
+            return true;
+        }
+        if (Failures == 0 || count < FailedCount) {
+            FailedCount = count;
+        }
+        if (++Failures < FAILURES_TO_DECREASE) {
+            return true;
+        }
+        MinBadCount = FailedCount;
+        FailedCount = 0;
+        Failures = 0;
+        if (Learned) {
+            // The device doesn't accept stored limit anymore, it is searched again
+            Learned = false;
+            MaxGoodCount = 0;
+        }
+        Learned = (MaxGoodCount != 0) && (MinBadCount - MaxGoodCount <= 1);
+        Confirmed = Learned;
+        return true;
+    }
+
+    void TModbusRegisterRange::SetAutoHoles(const THoles& holes)
+    {
+        AutoHoles = holes;
+    }
+
+    void TModbusRegisterRange::SetReadRegistersLimit(PReadRegistersLimit limit)
+    {
+        ReadRegistersLimit = limit;
+    }
+
+    const PReadRegistersLimit& TModbusRegisterRange::GetReadRegistersLimit() const
+    {
+        return ReadRegistersLimit;
+    }
+
+    void TModbusRegisterRange::Reset(std::chrono::microseconds averageResponseTime)
     {
-        if (Bits)
-            delete[] Bits;
-        if (Words)
-            delete[] Words;
+        RegisterList().clear();
+        HasHolesFlg = false;
+        Start = 0;
+        Count = 0;
+        AverageResponseTime = averageResponseTime;
+        ResponseTime = averageResponseTime;
+        PollTime = std::chrono::microseconds::zero();
+        AutoHoles = THoles();
+        ReadRegistersLimit.reset();
     }
 
     bool TModbusRegisterRange::Add(PRegister reg, std::chrono::milliseconds pollLimit)
@@ -156,7 +395,8 @@ namespace Modbus // modbus protocol common utilities
             // Can't add register separated from last in the range by more than maxHole registers
             int maxHole = 0;
             if (reg->Device()->GetSupportsHoles()) {
-                maxHole = isSingleBit ? deviceConfig.MaxBitHole : deviceConfig.MaxRegHole;
+                maxHole = isSingleBit ? std::max(deviceConfig.MaxBitHole, AutoHoles.Bits)
+                                      : std::max(deviceConfig.MaxRegHole, AutoHoles.Registers);
             }
             if (Start + Count + maxHole < addr) {
                 return false;
@@ -203,8 +443,8 @@ namespace Modbus // modbus protocol common utilities
         // Request 8 bytes: SlaveID, Operation, Addr, Count, CRC
         // Response 5 bytes except data: SlaveID, Operation, Size, CRC
         auto sendTime = reg->Device()->Port()->GetSendTimeBytes(newPduSize + 8 + 5);
-        auto newPollTime = std::chrono::ceil<std::chrono::milliseconds>(
-            sendTime + AverageResponseTime + deviceConfig.RequestDelay + 2 * deviceConfig.FrameTimeout);
+        auto pollTime = sendTime + AverageResponseTime + deviceConfig.RequestDelay + 2 * deviceConfig.FrameTimeout;
+        auto newPollTime = std::chrono::ceil<std::chrono::milliseconds>(pollTime);
 
         if (((Count != 0) && !AddingRegisterIncreasesSize(isSingleBit, extend)) || (newPollTime <= pollLimit)) {
 
@@ -212,6 +452,7 @@ namespace Modbus // modbus protocol common utilities
                 Start = addr;
             }
 
+            PollTime = pollTime;
             RegisterList().push_back(reg);
             Count += extend;
             return true;
@@ -231,18 +472,16 @@ namespace Modbus // modbus protocol common utilities
     {
         if (!IsSingleBitType(Type()))
             throw std::runtime_error("GetBits() for non-bit register");
-        if (!Bits)
-            Bits = new uint8_t[Count];
-        return Bits;
+        Bits.resize(Count);
+        return Bits.data();
     }
 
     uint16_t* TModbusRegisterRange::GetWords()
     {
         if (IsSingleBitType(Type()))
             throw std::runtime_error("GetWords() for non-word register");
-        if (!Words)
-            Words = new uint16_t[Count];
-        return Words;
+        Words.resize(Count);
+        return Words.data();
     }
 
     int TModbusRegisterRange::GetStart() const
@@ -260,18 +499,6 @@ namespace Modbus // modbus protocol common utilities
         return HasHolesFlg;
     }
 
-    TRequest TModbusRegisterRange::GetRequest(IModbusTraits& traits, uint8_t slaveId, int shift) const
-    {
-        TRequest request;
-        // 1 byte - function code, 2 bytes - starting register address, 2 bytes - quantity of registers
-        const uint16_t REQUEST_PDU_SIZE = 5;
-
-        request.resize(traits.GetPacketSize(REQUEST_PDU_SIZE));
-        Modbus::ComposeReadRequestPDU(traits.GetPDU(request), *this, shift);
-        traits.FinalizeRequest(request, slaveId);
-        return request;
-    }
-
     size_t TModbusRegisterRange::GetResponseSize(IModbusTraits& traits) const
     {
         return traits.GetPacketSize(InferReadResponsePDUSize(Type(), GetCount()));
@@ -304,6 +531,57 @@ namespace Modbus // modbus protocol common utilities
         return (Count + extend) > maxRegsCount;
     }
 
+    void TModbusRegisterRange::ExtendToMinReadRegisters()
+    {
+        const auto& deviceConfig = *(Device()->DeviceConfig());
+        if (GetCount() < deviceConfig.MinReadRegisters) {
+            Count = deviceConfig.MinReadRegisters;
+        }
+    }
+
+    const TRequest& TModbusRegisterRange::PrepareReadRequest(IModbusTraits& traits, uint8_t slaveId, int shift)
+    {
+        ExtendToMinReadRegisters();
+        // 1 byte - function code, 2 bytes - starting register address, 2 bytes - quantity of registers
+        const uint16_t REQUEST_PDU_SIZE = 5;
+        uint8_t pdu[REQUEST_PDU_SIZE];
+
+        if (!RequestCache) {
+            Modbus::ComposeReadRequestPDU(pdu, *this, shift);
+            Request.assign(traits.GetPacketSize(REQUEST_PDU_SIZE), 0);
+            std::copy(pdu, pdu + REQUEST_PDU_SIZE, traits.GetPDU(Request));
+            traits.FinalizeRequest(Request, slaveId);
+            return Request;
+        }
+
+        // Register type, address as it is sent, count and slave id define the function and the whole request,
+        // so the PDU is composed only for requests missing in the cache
+        uint64_t key = (uint64_t(Type()) << 40) | (uint64_t(uint16_t(GetStart() + shift)) << 24) |
+                       (uint64_t(uint16_t(GetCount())) << 8) | slaveId;
+        if (auto cached = RequestCache->Find(key)) {
+            Request.assign(cached->begin(), cached->end());
+            traits.RefreshRequest(Request);
+            return Request;
+        }
+        Modbus::ComposeReadRequestPDU(pdu, *this, shift);
+        Request.assign(traits.GetPacketSize(REQUEST_PDU_SIZE), 0);
+        std::copy(pdu, pdu + REQUEST_PDU_SIZE, traits.GetPDU(Request));
+        traits.FinalizeRequest(Request, slaveId);
+        RequestCache->Add(key, Request);
+        return Request;
+    }
+
+    void TModbusRegisterRange::ProcessReadResponse(IModbusTraits& traits,
+                                                   const TRequest& request,
+                                                   const TResponse& response,
+                                                   const TReadFrameResult& readResult,
+                                                   Modbus::TRegisterCache& cache)
+    {
+        CheckResponse(traits, request, response, readResult);
+        ResponseTime = readResult.ResponseTime;
+        ParseReadResponse(traits.GetPDU(response), readResult.Count, *this, cache);
+    }
+
     void TModbusRegisterRange::ReadRange(IModbusTraits& traits,
                                          TPort& port,
                                          uint8_t slaveId,
@@ -311,17 +589,16 @@ namespace Modbus // modbus protocol common utilities
                                          Modbus::TRegisterCache& cache)
     {
         try {
-            const auto& deviceConfig = *(Device()->DeviceConfig());
-            if (GetCount() < deviceConfig.MinReadRegisters) {
-                Count = deviceConfig.MinReadRegisters;
-            }
-            auto request = GetRequest(traits, slaveId, shift);
+            const auto& request = PrepareReadRequest(traits, slaveId, shift);
             port.SleepSinceLastInteraction(Device()->DeviceConfig()->RequestDelay);
             port.WriteBytes(request.data(), request.size());
-            TResponse response(GetResponseSize(traits));
-            auto readRes = ReadResponse(traits, port, request, response, *Device()->DeviceConfig());
-            ResponseTime = readRes.ResponseTime;
-            ParseReadResponse(traits.GetPDU(response), readRes.Count, *this, cache);
+            Response.assign(GetResponseSize(traits), 0);
+            auto readRes = traits.ReadFrame(port,
+                                            Device()->DeviceConfig()->ResponseTimeout,
+                                            Device()->DeviceConfig()->FrameTimeout,
+                                            request,
+                                            Response);
+            ProcessReadResponse(traits, request, Response, readRes, cache);
         } catch (const TMalformedResponseError&) {
             try {
                 port.SkipNoise();
@@ -337,6 +614,11 @@ namespace Modbus // modbus protocol common utilities
         return ResponseTime;
     }
 
+    std::chrono::microseconds TModbusRegisterRange::GetPollTime() const
+    {
+        return PollTime;
+    }
+
     ostream& operator<<(ostream& s, const TModbusRegisterRange& range)
     {
         s << range.GetCount() << " " << range.TypeName() << "(s) @ " << range.GetStart() << " of device "
@@ -356,6 +638,7 @@ namespace Modbus // modbus protocol common utilities
         FN_WRITE_SINGLE_REGISTER = 0x6,
         FN_WRITE_MULTIPLE_COILS = 0xF,
         FN_WRITE_MULTIPLE_REGISTERS = 0x10,
+        FN_READ_WRITE_MULTIPLE_REGISTERS = 0x17,
     };
 
     enum class OperationType : uint8_t
@@ -469,6 +752,12 @@ namespace Modbus // modbus protocol common utilities
         if (code < sizeof(errs) / sizeof(TModbusException)) {
             const auto& err = errs[code];
             if (err.first != nullptr) {
+                if (code + 1 == ERR_ILLEGAL_FUNCTION) {
+                    throw TIllegalFunctionError();
+                }
+                if (code + 1 == ERR_ILLEGAL_DATA_VALUE) {
+                    throw TIllegalDataValueError();
+                }
                 if (err.second) {
                     throw TSerialDevicePermanentRegisterException(err.first);
                 }
@@ -566,8 +855,7 @@ namespace Modbus // modbus protocol common utilities
                                         const TRegister& reg,
                                         const std::vector<TRegisterWord>& value,
                                         int shift,
-                                        Modbus::TRegisterCache& tmpCache,
-                                        const Modbus::TRegisterCache& cache)
+                                        TWrittenWords& words)
     {
         pdu[0] = GetFunction(reg, OperationType::OP_WRITE);
 
@@ -577,9 +865,8 @@ namespace Modbus // modbus protocol common utilities
 
         auto baseAddress = addr + shift;
 
-        TAddress address{0};
-
-        address.Type = reg.Type;
+        words.Type = reg.Type;
+        words.Address = baseAddress;
 
         WriteAs2Bytes(pdu + 1, baseAddress);
         WriteAs2Bytes(pdu + 3, widthInModbusWords);
@@ -587,10 +874,8 @@ namespace Modbus // modbus protocol common utilities
         pdu[5] = widthInModbusWords * 2;
 
         for (uint32_t i = 0; (i < widthInModbusWords) && (i < value.size()); ++i) {
-            address.Address = baseAddress + i;
-
             auto data = value.at(i);
-            tmpCache[address.AbsAddress] = data;
+            words.Values.push_back(data);
             WriteAs2Bytes(pdu + 6 + i * 2, data);
         }
     }
@@ -600,7 +885,7 @@ namespace Modbus // modbus protocol common utilities
                                         const TRegister& reg,
                                         uint64_t value,
                                         int shift,
-                                        Modbus::TRegisterCache& tmpCache,
+                                        TWrittenWords& words,
                                         const Modbus::TRegisterCache& cache)
     {
         pdu[0] = GetFunction(reg, OperationType::OP_WRITE);
@@ -611,9 +896,8 @@ namespace Modbus // modbus protocol common utilities
 
         auto baseAddress = addr + shift;
 
-        TAddress address{0};
-
-        address.Type = reg.Type;
+        words.Type = reg.Type;
+        words.Address = baseAddress;
 
         WriteAs2Bytes(pdu + 1, baseAddress);
         WriteAs2Bytes(pdu + 3, widthInModbusWords);
@@ -624,12 +908,8 @@ namespace Modbus // modbus protocol common utilities
 
         auto bitsToAllocate = bitWidth;
         for (uint32_t i = 0; i < widthInModbusWords; ++i) {
-            address.Address = baseAddress + i;
-
-            uint16_t cachedValue = 0;
-            if (cache.count(address.AbsAddress)) {
-                cachedValue = cache.at(address.AbsAddress);
-            }
+            auto cached = cache.Find(reg.Type, baseAddress + i);
+            uint16_t cachedValue = cached ? *cached : 0;
 
             auto localBitOffset = std::max(static_cast<int32_t>(reg.GetDataOffset()) - bitPos, 0);
 
@@ -643,7 +923,7 @@ namespace Modbus // modbus protocol common utilities
 
             auto wordValue = (~mask & cachedValue) | (valuePart << localBitOffset);
 
-            tmpCache[address.AbsAddress] = wordValue & 0xffff;
+            words.Values.push_back(wordValue & 0xffff);
 
             WriteAs2Bytes(pdu + 6 + i * 2, wordValue & 0xffff);
             bitsToAllocate -= bitCount;
@@ -656,7 +936,7 @@ namespace Modbus // modbus protocol common utilities
                                       TRegisterWord value,
                                       int shift,
                                       uint8_t wordIndex,
-                                      Modbus::TRegisterCache& tmpCache,
+                                      TWrittenWords& words,
                                       const Modbus::TRegisterCache& cache)
     {
         auto bitWidth = reg.GetDataWidth();
@@ -665,17 +945,13 @@ namespace Modbus // modbus protocol common utilities
             bitWidth = 16;
         }
 
-        TAddress address;
-
-        address.Type = reg.Type;
-
         auto addr = GetUint32RegisterAddress(reg.GetWriteAddress());
-        address.Address = addr + shift + wordIndex;
+        words.Type = reg.Type;
+        words.Address = addr + shift;
+        int address = words.Address + wordIndex;
 
-        uint16_t cachedValue = 0;
-        if (cache.count(address.AbsAddress)) {
-            cachedValue = cache.at(address.AbsAddress);
-        }
+        auto cached = cache.Find(reg.Type, address);
+        uint16_t cachedValue = cached ? *cached : 0;
 
         auto localBitOffset = std::max(static_cast<int32_t>(reg.GetDataOffset()) - wordIndex * 16, 0);
 
@@ -685,11 +961,14 @@ namespace Modbus // modbus protocol common utilities
 
         auto wordValue = (~mask & cachedValue) | (mask & (value << localBitOffset));
 
-        tmpCache[address.AbsAddress] = wordValue & 0xffff;
+        if (words.Values.size() <= wordIndex) {
+            words.Values.resize(wordIndex + 1);
+        }
+        words.Values[wordIndex] = wordValue & 0xffff;
 
         pdu[0] = GetFunction(reg, OperationType::OP_WRITE);
 
-        WriteAs2Bytes(pdu + 1, address.Address);
+        WriteAs2Bytes(pdu + 1, address);
         WriteAs2Bytes(pdu + 3, wordValue);
     }
 
@@ -699,12 +978,6 @@ namespace Modbus // modbus protocol common utilities
                            TModbusRegisterRange& range,
                            Modbus::TRegisterCache& cache)
     {
-        TAddress address;
-
-        address.Type = range.Type();
-
-        auto baseAddress = range.GetStart();
-
         ThrowIfModbusException(GetExceptionCode(pdu));
 
         uint8_t byte_count = pdu[1];
@@ -714,9 +987,23 @@ namespace Modbus // modbus protocol common utilities
                                           std::to_string(pduSize - 2));
         }
 
+        // Registers added to reach device's minimum read count can be omitted
+        const bool isSingleBit = IsSingleBitType(range.Type());
+        size_t requiredCount = 0;
+        for (const auto& reg: range.RegisterList()) {
+            size_t end = GetUint32RegisterAddress(reg->GetAddress()) - range.GetStart() +
+                         (isSingleBit ? 1 : GetModbusDataWidthIn16BitWords(*reg));
+            requiredCount = std::max(requiredCount, end);
+        }
+        const size_t expectedByteCount = isSingleBit ? (requiredCount + 7) / 8 : requiredCount * 2;
+        if (byte_count < expectedByteCount) {
+            throw TTruncatedResponseError("read response byte count: " + std::to_string(byte_count) + ", expected " +
+                                          std::to_string(expectedByteCount));
+        }
+
         auto start = pdu + 2;
         auto end = start + byte_count;
-        if (IsSingleBitType(range.Type())) {
+        if (isSingleBit) {
             auto destination = range.GetBits();
             auto coil_count = range.GetCount();
             while (start != end) {
@@ -739,12 +1026,10 @@ namespace Modbus // modbus protocol common utilities
 
         auto destination = range.GetWords();
         for (int i = 0; i < byte_count / 2; ++i) {
-            address.Address = baseAddress + i;
-
-            cache[address.AbsAddress] = destination[i] = (*start << 8) | *(start + 1);
-
+            destination[i] = (*start << 8) | *(start + 1);
             start += 2;
         }
+        cache.Set(range.Type(), range.GetStart(), destination, byte_count / 2);
 
         for (auto reg: range.RegisterList()) {
 
@@ -810,16 +1095,32 @@ namespace Modbus // modbus protocol common utilities
         return std::make_shared<TModbusRegisterRange>(averageResponseTime);
     }
 
-    TReadFrameResult ReadResponse(IModbusTraits& traits,
-                                  TPort& port,
-                                  const TRequest& request,
-                                  TResponse& response,
-                                  const TDeviceConfig& config)
+    TRegisterRangePool::TRegisterRangePool(): RequestCache(std::make_shared<TReadRequestCache>())
+    {}
+
+    std::shared_ptr<TModbusRegisterRange> TRegisterRangePool::Get(std::chrono::microseconds averageResponseTime)
+    {
+        for (const auto& range: Ranges) {
+            if (range.use_count() == 1) {
+                range->Reset(averageResponseTime);
+                return range;
+            }
+        }
+        auto range = std::make_shared<TModbusRegisterRange>(averageResponseTime, RequestCache);
+        if (Ranges.size() < MAX_POOLED_RANGES) {
+            Ranges.push_back(range);
+        }
+        return range;
+    }
+
+    void CheckResponse(IModbusTraits& traits,
+                       const TRequest& request,
+                       const TResponse& response,
+                       const TReadFrameResult& readResult)
     {
-        auto res = traits.ReadFrame(port, config.ResponseTimeout, config.FrameTimeout, request, response);
         // PDU size must be at least 2 bytes
-        if (res.Count < 2) {
-            throw TMalformedResponseError("Wrong PDU size: " + to_string(res.Count));
+        if (readResult.Count < 2) {
+            throw TMalformedResponseError("Wrong PDU size: " + to_string(readResult.Count));
         }
         auto requestFunctionCode = traits.GetPDU(request)[0];
         auto responseFunctionCode = traits.GetPDU(response)[0] & 127; // get actual function code even if exception
@@ -827,26 +1128,28 @@ namespace Modbus // modbus protocol common utilities
         if (requestFunctionCode != responseFunctionCode) {
             throw TSerialDeviceTransientErrorException("request and response function code mismatch");
         }
-        return res;
     }
 
-    void WriteRegister(IModbusTraits& traits,
-                       TPort& port,
-                       uint8_t slaveId,
-                       TRegister& reg,
-                       const TRegisterValue& value,
-                       Modbus::TRegisterCache& cache,
-                       int shift)
+    TReadFrameResult ReadResponse(IModbusTraits& traits,
+                                  TPort& port,
+                                  const TRequest& request,
+                                  TResponse& response,
+                                  const TDeviceConfig& config)
     {
-        Modbus::TRegisterCache tmpCache;
-
-        LOG(Debug) << "write " << GetModbusDataWidthIn16BitWords(reg) << " " << reg.TypeName << "(s) @ "
-                   << reg.GetWriteAddress() << " of device " << reg.Device()->ToString();
-
-        // 1 byte - function code, 2 bytes - register address, 2 bytes - value
-        const uint16_t WRITE_RESPONSE_PDU_SIZE = 5;
-        TResponse response(traits.GetPacketSize(WRITE_RESPONSE_PDU_SIZE));
+        auto res = traits.ReadFrame(port, config.ResponseTimeout, config.FrameTimeout, request, response);
+        CheckResponse(traits, request, response, res);
+        return res;
+    }
 
+    // composes requests writing the register, written words are stored in words
+    vector<TRequest> ComposeWriteRequests(IModbusTraits& traits,
+                                          uint8_t slaveId,
+                                          const TRegister& reg,
+                                          const TRegisterValue& value,
+                                          int shift,
+                                          TWrittenWords& words,
+                                          const Modbus::TRegisterCache& cache)
+    {
         vector<TRequest> requests(InferWriteRequestsCount(reg));
 
         if (IsPacking(reg)) {
@@ -860,9 +1163,9 @@ namespace Modbus // modbus protocol common utilities
                 auto str = value.Get<std::string>();
                 std::vector<TRegisterWord> payloadBuf;
                 std::for_each(str.begin(), str.end(), [&payloadBuf](char ch) { payloadBuf.push_back(ch); });
-                ComposeMultipleWriteRequestPDU(traits.GetPDU(req), reg, payloadBuf, shift, tmpCache, cache);
+                ComposeMultipleWriteRequestPDU(traits.GetPDU(req), reg, payloadBuf, shift, words);
             } else {
-                ComposeMultipleWriteRequestPDU(traits.GetPDU(req), reg, value.Get<uint64_t>(), shift, tmpCache, cache);
+                ComposeMultipleWriteRequestPDU(traits.GetPDU(req), reg, value.Get<uint64_t>(), shift, words, cache);
             }
             traits.FinalizeRequest(req, slaveId);
         } else {
@@ -876,34 +1179,215 @@ namespace Modbus // modbus protocol common utilities
                                              static_cast<uint16_t>(val & 0xffff),
                                              shift,
                                              requests.size() - i - 1,
-                                             tmpCache,
+                                             words,
                                              cache);
 
                 val >>= 16;
                 traits.FinalizeRequest(req, slaveId);
             }
         }
+        return requests;
+    }
+
+    void SendWriteRequest(IModbusTraits& traits, TPort& port, const TRequest& request, const TDeviceConfig& config)
+    {
+        // 1 byte - function code, 2 bytes - register address, 2 bytes - value
+        TResponse response(traits.GetPacketSize(WRITE_RESPONSE_PDU_SIZE));
+        try {
+            port.SleepSinceLastInteraction(config.RequestDelay);
+            port.WriteBytes(request.data(), request.size());
+            auto pduSize = ReadResponse(traits, port, request, response, config).Count;
+            ParseWriteResponse(traits.GetPDU(response), pduSize);
+        } catch (const TMalformedResponseError&) {
+            try {
+                port.SkipNoise();
+            } catch (const std::exception& e) {
+                LOG(Warn) << "SkipNoise failed: " << e.what();
+            }
+            throw;
+        }
+    }
+
+    void WriteRegister(IModbusTraits& traits,
+                       TPort& port,
+                       uint8_t slaveId,
+                       TRegister& reg,
+                       const TRegisterValue& value,
+                       Modbus::TRegisterCache& cache,
+                       int shift)
+    {
+        TWrittenWords words;
+
+        LOG(Debug) << "write " << GetModbusDataWidthIn16BitWords(reg) << " " << reg.TypeName << "(s) @ "
+                   << reg.GetWriteAddress() << " of device " << reg.Device()->ToString();
+
+        for (const auto& request: ComposeWriteRequests(traits, slaveId, reg, value, shift, words, cache)) {
+            SendWriteRequest(traits, port, request, *reg.Device()->DeviceConfig());
+        }
+
+        cache.Set(words.Type, words.Address, words.Values.data(), words.Values.size());
+    }
+
+    namespace
+    {
+        const int MAX_WRITE_REGISTERS = 123;
+        const int MAX_WRITE_BITS = 1968;
+
+        int64_t GetCacheKey(int type, int address)
+        {
+            TAddress res{0};
+            res.Type = type;
+            res.Address = address;
+            return res.AbsAddress;
+        }
+
+        struct TCombinedWrite
+        {
+            int Type;
+            int Start;
+            std::vector<uint16_t> Words;
+            std::vector<TRegisterWrite*> Writes;
+        };
+
+        void SendCombinedWrite(IModbusTraits& traits,
+                               TPort& port,
+                               uint8_t slaveId,
+                               const TCombinedWrite& write,
+                               const TDeviceConfig& config)
+        {
+            const auto count = write.Words.size();
+            const bool isSingleBit = IsSingleBitType(write.Type);
+            const size_t dataSize = isSingleBit ? (count + 7) / 8 : count * 2;
+            TRequest request(traits.GetPacketSize(6 + dataSize));
+            auto pdu = traits.GetPDU(request);
+            pdu[0] = isSingleBit ? FN_WRITE_MULTIPLE_COILS : FN_WRITE_MULTIPLE_REGISTERS;
+            WriteAs2Bytes(pdu + 1, write.Start);
+            WriteAs2Bytes(pdu + 3, count);
+            pdu[5] = dataSize;
+            for (size_t i = 0; i < count; ++i) {
+                if (isSingleBit) {
+                    if (write.Words[i]) {
+                        pdu[6 + i / 8] |= 1 << (i % 8);
+                    }
+                } else {
+                    WriteAs2Bytes(pdu + 6 + i * 2, write.Words[i]);
+                }
+            }
+            traits.FinalizeRequest(request, slaveId);
+            SendWriteRequest(traits, port, request, config);
+        }
+    }
 
-        for (const auto& request: requests) {
+    void WriteRegisters(IModbusTraits& traits,
+                        TPort& port,
+                        uint8_t slaveId,
+                        std::vector<TRegisterWrite>& writes,
+                        Modbus::TRegisterCache& cache,
+                        int maxWriteRegisters,
+                        int maxHole,
+                        int shift)
+    {
+        if (writes.empty()) {
+            return;
+        }
+
+        // Words of every register by address. Registers sharing words with others are written one by one
+        struct TRegisterWords
+        {
+            TRegisterWrite* Write;
+            TWrittenWords Words;
+        };
+        std::vector<TRegisterWords> registers;
+        std::unordered_map<int64_t, size_t> wordOwners;
+        for (auto& write: writes) {
+            const auto& reg = *write.Register;
+            if ((reg.Type != REG_HOLDING && reg.Type != REG_HOLDING_MULTI && reg.Type != REG_COIL) ||
+                reg.Format == RegisterFormat::String)
+            {
+                continue;
+            }
+            TRegisterWords item{&write, {}};
             try {
-                port.SleepSinceLastInteraction(reg.Device()->DeviceConfig()->RequestDelay);
-                port.WriteBytes(request.data(), request.size());
-                auto pduSize = ReadResponse(traits, port, request, response, *reg.Device()->DeviceConfig()).Count;
-                ParseWriteResponse(traits.GetPDU(response), pduSize);
-            } catch (const TMalformedResponseError&) {
-                try {
-                    port.SkipNoise();
-                } catch (const std::exception& e) {
-                    LOG(Warn) << "SkipNoise failed: " << e.what();
+                ComposeWriteRequests(traits, slaveId, reg, write.Value, shift, item.Words, cache);
+            } catch (const TSerialDeviceException&) {
+                continue;
+            }
+            if (item.Words.Values.empty()) {
+                continue;
+            }
+            bool sharesWords = false;
+            for (size_t i = 0; i < item.Words.Values.size(); ++i) {
+                auto res = wordOwners.emplace(GetCacheKey(item.Words.Type, item.Words.Address + i), registers.size());
+                if (!res.second) {
+                    sharesWords = true;
+                    if (res.first->second != std::numeric_limits<size_t>::max()) {
+                        registers[res.first->second].Write = nullptr;
+                        res.first->second = std::numeric_limits<size_t>::max();
+                    }
                 }
-                throw;
             }
+            if (sharesWords) {
+                item.Write = nullptr;
+            }
+            registers.push_back(std::move(item));
+        }
+        registers.erase(
+            std::remove_if(registers.begin(), registers.end(), [](const auto& item) { return !item.Write; }),
+            registers.end());
+        std::sort(registers.begin(), registers.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.Words.Type, a.Words.Address) < std::tie(b.Words.Type, b.Words.Address);
+        });
+
+        std::vector<TCombinedWrite> combinedWrites;
+        for (auto& item: registers) {
+            const auto type = item.Words.Type;
+            const int first = item.Words.Address;
+            const int last = first + item.Words.Values.size() - 1;
+            const int maxCount =
+                std::min(maxWriteRegisters, IsSingleBitType(type) ? MAX_WRITE_BITS : MAX_WRITE_REGISTERS);
+            bool append = false;
+            if (!combinedWrites.empty() && combinedWrites.back().Type == type) {
+                auto& current = combinedWrites.back();
+                const int currentEnd = current.Start + current.Words.size();
+                append = (first - currentEnd <= maxHole) && (last - current.Start + 1 <= maxCount);
+                // Holes are filled by known values only
+                for (int address = currentEnd; append && address < first; ++address) {
+                    append = cache.Find(type, address) != nullptr;
+                }
+            }
+            if (!append) {
+                combinedWrites.push_back({type, first, {}, {}});
+            }
+            auto& current = combinedWrites.back();
+            for (int address = current.Start + current.Words.size(); address < first; ++address) {
+                current.Words.push_back(*cache.Find(type, address));
+            }
+            current.Words.insert(current.Words.end(), item.Words.Values.begin(), item.Words.Values.end());
+            current.Writes.push_back(item.Write);
         }
 
-        cache.insert(tmpCache.begin(), tmpCache.end());
+        const auto& config = *writes.front().Register->Device()->DeviceConfig();
+        for (const auto& write: combinedWrites) {
+            // Single registers are written as usual
+            if (write.Writes.size() < 2) {
+                continue;
+            }
+            LOG(Debug) << "write " << write.Words.size() << " " << write.Writes.front()->Register->TypeName
+                       << "(s) @ " << write.Start << " of device " << config.GetDescription() << " at once";
+            try {
+                SendCombinedWrite(traits, port, slaveId, write, config);
+            } catch (const TSerialDeviceException& e) {
+                LOG(Debug) << "combined write failed, registers will be written one by one: " << e.what();
+                continue;
+            }
+            cache.Set(write.Type, write.Start, write.Words.data(), write.Words.size());
+            for (auto registerWrite: write.Writes) {
+                registerWrite->Done = true;
+            }
+        }
     }
 
-    void ProcessRangeException(TModbusRegisterRange& range, const char* msg)
+    void SetRangeReadError(TModbusRegisterRange& range, const char* msg)
     {
         for (auto& reg: range.RegisterList()) {
             reg->SetError(TRegister::TError::ReadError);
@@ -911,22 +1395,39 @@ namespace Modbus // modbus protocol common utilities
 
         auto& logger = range.Device()->GetIsDisconnected() ? Debug : Warn;
         LOG(logger) << "failed to read " << range << ": " << msg;
+    }
+
+    void ProcessRangeException(TModbusRegisterRange& range, const char* msg)
+    {
+        SetRangeReadError(range, msg);
         range.Device()->SetTransferResult(false);
     }
 
-    void ReadRegisterRange(IModbusTraits& traits,
-                           TPort& port,
-                           uint8_t slaveId,
-                           TModbusRegisterRange& range,
-                           Modbus::TRegisterCache& cache,
-                           int shift)
+    template<class TReadFn> void ProcessRangeRead(TModbusRegisterRange& range, TReadFn readFn)
     {
-        if (range.RegisterList().empty()) {
-            return;
-        }
+        const auto& limit = range.GetReadRegistersLimit();
         try {
-            range.ReadRange(traits, port, slaveId, shift, cache);
+            readFn();
+            if (limit) {
+                limit->OnReadSuccess(range.GetCount());
+            }
             range.Device()->SetTransferResult(true);
+        } catch (const TIllegalDataValueError& e) {
+            // Too large requests are rejected by some devices, registers can be available
+            if (range.HasHoles()) {
+                range.Device()->SetSupportsHoles(false);
+            } else if (!limit || !limit->OnReadFailure(range.GetCount())) {
+                for (auto& reg: range.RegisterList()) {
+                    reg->SetAvailable(TRegisterAvailability::UNAVAILABLE);
+                }
+            }
+            ProcessRangeException(range, e.what());
+        } catch (const TTruncatedResponseError& e) {
+            // Responses to too large requests can be truncated
+            if (limit) {
+                limit->OnReadFailure(range.GetCount());
+            }
+            ProcessRangeException(range, e.what());
         } catch (const TSerialDevicePermanentRegisterException& e) {
             if (range.HasHoles()) {
                 range.Device()->SetSupportsHoles(false);
@@ -941,6 +1442,179 @@ namespace Modbus // modbus protocol common utilities
         }
     }
 
+    void ReadRegisterRange(IModbusTraits& traits,
+                           TPort& port,
+                           uint8_t slaveId,
+                           TModbusRegisterRange& range,
+                           Modbus::TRegisterCache& cache,
+                           int shift)
+    {
+        if (range.RegisterList().empty()) {
+            return;
+        }
+        ProcessRangeRead(range, [&]() { range.ReadRange(traits, port, slaveId, shift, cache); });
+    }
+
+    bool WriteRegisterAndReadRange(IModbusTraits& traits,
+                                   TPort& port,
+                                   uint8_t slaveId,
+                                   TRegister& reg,
+                                   const TRegisterValue& value,
+                                   TModbusRegisterRange& range,
+                                   Modbus::TRegisterCache& cache,
+                                   int shift)
+    {
+        auto isHolding = [](int type) { return type == REG_HOLDING || type == REG_HOLDING_MULTI; };
+        if (!isHolding(reg.Type) || range.RegisterList().empty() || !isHolding(range.Type())) {
+            return false;
+        }
+        // The read part is extended like usual read request
+        range.ExtendToMinReadRegisters();
+        if (range.GetCount() > MAX_READ_REGISTERS) {
+            return false;
+        }
+
+        // Words of the register are composed like for usual write
+        TWrittenWords words;
+        ComposeWriteRequests(traits, slaveId, reg, value, shift, words, cache);
+        if (words.Values.empty() || words.Values.size() > static_cast<size_t>(MAX_READ_WRITE_REGISTERS)) {
+            return false;
+        }
+
+        LOG(Debug) << "write " << words.Values.size() << " " << reg.TypeName << "(s) @ " << reg.GetWriteAddress()
+                   << " and read " << range << " at once";
+
+        // 1 byte - function code, 2 bytes - read address, 2 bytes - read quantity,
+        // 2 bytes - write address, 2 bytes - write quantity, 1 byte - write byte count
+        const size_t pduSize = 10 + words.Values.size() * 2;
+        TRequest request(traits.GetPacketSize(pduSize));
+        auto pdu = traits.GetPDU(request);
+        ComposeReadRequestPDU(pdu, range, shift);
+        pdu[0] = FN_READ_WRITE_MULTIPLE_REGISTERS;
+        WriteAs2Bytes(pdu + 5, words.Address);
+        WriteAs2Bytes(pdu + 7, words.Values.size());
+        pdu[9] = words.Values.size() * 2;
+        for (size_t i = 0; i < words.Values.size(); ++i) {
+            WriteAs2Bytes(pdu + 10 + i * 2, words.Values[i]);
+        }
+        traits.FinalizeRequest(request, slaveId);
+
+        const auto& config = *range.Device()->DeviceConfig();
+        TResponse response(range.GetResponseSize(traits));
+        try {
+            port.SleepSinceLastInteraction(config.RequestDelay);
+            port.WriteBytes(request.data(), request.size());
+            auto readRes = traits.ReadFrame(port, config.ResponseTimeout, config.FrameTimeout, request, response);
+            range.ProcessReadResponse(traits, request, response, readRes, cache);
+        } catch (const TMalformedResponseError&) {
+            try {
+                port.SkipNoise();
+            } catch (const std::exception& e) {
+                LOG(Warn) << "SkipNoise failed: " << e.what();
+            }
+            throw;
+        }
+        // Read back words are already cached
+        for (size_t i = 0; i < words.Values.size(); ++i) {
+            int address = words.Address + i;
+            if (words.Type != range.Type() || address < range.GetStart() ||
+                address >= range.GetStart() + range.GetCount())
+            {
+                cache.Set(words.Type, address, words.Values[i]);
+            }
+        }
+        return true;
+    }
+
+    void ReadRegisterRanges(IModbusTraits& traits,
+                            TPort& port,
+                            uint8_t slaveId,
+                            const std::vector<TModbusRegisterRange*>& ranges,
+                            Modbus::TRegisterCache& cache,
+                            size_t maxRequestsInFlight,
+                            int shift)
+    {
+        struct TRequestInFlight
+        {
+            TModbusRegisterRange* Range;
+            const TRequest* Request;
+            chrono::steady_clock::time_point SendTime;
+        };
+        // Requests are kept in order of sending, the first one is the oldest
+        std::vector<TRequestInFlight> requestsInFlight;
+        const size_t maxInFlight = std::max<size_t>(maxRequestsInFlight, 1);
+        auto nextRange = ranges.begin();
+        while (nextRange != ranges.end() || !requestsInFlight.empty()) {
+            try {
+                while (nextRange != ranges.end() && requestsInFlight.size() < maxInFlight) {
+                    auto& range = **nextRange;
+                    ++nextRange;
+                    if (range.RegisterList().empty()) {
+                        continue;
+                    }
+                    const auto& request = range.PrepareReadRequest(traits, slaveId, shift);
+                    if (!traits.GetTransactionId(request)) {
+                        ReadRegisterRange(traits, port, slaveId, range, cache, shift);
+                        continue;
+                    }
+                    port.SleepSinceLastInteraction(range.Device()->DeviceConfig()->RequestDelay);
+                    requestsInFlight.push_back({&range, &request, chrono::steady_clock::now()});
+                    port.WriteBytes(request.data(), request.size());
+                }
+                if (requestsInFlight.empty()) {
+                    continue;
+                }
+
+                // Response timeout is counted from sending of the oldest request
+                const auto& oldest = requestsInFlight.front();
+                const auto& config = *oldest.Range->Device()->DeviceConfig();
+                auto responseTimeout = std::max(
+                    chrono::ceil<chrono::milliseconds>(oldest.SendTime + config.ResponseTimeout -
+                                                       chrono::steady_clock::now()),
+                    chrono::milliseconds::zero());
+                TResponse response;
+                auto readRes = traits.ReadAnyFrame(port, responseTimeout, config.FrameTimeout, response);
+                auto transactionId = traits.GetTransactionId(response).value_or(0);
+                auto it = std::find_if(requestsInFlight.begin(),
+                                       requestsInFlight.end(),
+                                       [&](const TRequestInFlight& item) {
+                                           return traits.GetTransactionId(*item.Request) == transactionId;
+                                       });
+                if (it == requestsInFlight.end()) {
+                    LOG(Warn) << "response with unexpected transaction id " << transactionId << " is skipped";
+                    continue;
+                }
+                auto requestInFlight = *it;
+                requestsInFlight.erase(it);
+                auto& range = *requestInFlight.Range;
+                ProcessRangeRead(range, [&]() {
+                    // Unit identifier precedes PDU
+                    if (*(traits.GetPDU(*requestInFlight.Request) - 1) != *(traits.GetPDU(response) - 1)) {
+                        throw TSerialDeviceTransientErrorException("request and response unit identifier mismatch");
+                    }
+                    range.ProcessReadResponse(traits, *requestInFlight.Request, response, readRes, cache);
+                });
+            } catch (const TSerialDeviceException& e) {
+                if (dynamic_cast<const TMalformedResponseError*>(&e)) {
+                    try {
+                        port.SkipNoise();
+                    } catch (const std::exception& skipError) {
+                        LOG(Warn) << "SkipNoise failed: " << skipError.what();
+                    }
+                }
+                // Responses to requests in flight are lost, they fail together as one exchange.
+                // Not sent requests are sent as usual
+                if (!requestsInFlight.empty()) {
+                    for (auto& request: requestsInFlight) {
+                        SetRangeReadError(*request.Range, e.what());
+                    }
+                    requestsInFlight.front().Range->Device()->SetTransferResult(false);
+                    requestsInFlight.clear();
+                }
+            }
+        }
+    }
+
     void WarnFailedRegisterSetup(const PDeviceSetupItem& item, const char* msg)
     {
         LOG(Warn) << "failed to write: " << item->Register->ToString() << ": " << msg;
@@ -979,6 +1653,22 @@ namespace Modbus // modbus protocol common utilities
 
     // TModbusRTUTraits
 
+    TReadFrameResult IModbusTraits::ReadAnyFrame(TPort& port,
+                                                 const std::chrono::milliseconds& responseTimeout,
+                                                 const std::chrono::milliseconds& frameTimeout,
+                                                 TResponse& resp) const
+    {
+        throw std::runtime_error("reading responses without requests is not supported");
+    }
+
+    std::optional<uint16_t> IModbusTraits::GetTransactionId(const std::vector<uint8_t>& frame) const
+    {
+        return std::nullopt;
+    }
+
+    void IModbusTraits::RefreshRequest(TRequest& request)
+    {}
+
     TPort::TFrameCompletePred TModbusRTUTraits::ExpectNBytes(size_t n) const
     {
         return [=](uint8_t* buf, size_t size) {
@@ -1077,6 +1767,13 @@ namespace Modbus // modbus protocol common utilities
         SetMBAP(request, *TransactionId, request.size() - MBAP_SIZE, slaveId);
     }
 
+    void TModbusTCPTraits::RefreshRequest(TRequest& request)
+    {
+        ++(*TransactionId);
+        request[0] = ((*TransactionId >> 8) & 0xFF);
+        request[1] = (*TransactionId & 0xFF);
+    }
+
     TReadFrameResult TModbusTCPTraits::ReadFrame(TPort& port,
                                                  const std::chrono::milliseconds& responseTimeout,
                                                  const std::chrono::milliseconds& frameTimeout,
@@ -1087,31 +1784,7 @@ namespace Modbus // modbus protocol common utilities
         while (chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime) <
                responseTimeout + frameTimeout)
         {
-            if (res.size() < MBAP_SIZE) {
-                res.resize(MBAP_SIZE);
-            }
-            auto rc = port.ReadFrame(res.data(), MBAP_SIZE, responseTimeout + frameTimeout, frameTimeout);
-
-            if (rc.Count < MBAP_SIZE) {
-                throw TMalformedResponseError("Can't read full MBAP");
-            }
-
-            auto len = GetLengthFromMBAP(res);
-            // MBAP length should be at least 1 byte for unit identifier
-            if (len == 0) {
-                throw TMalformedResponseError("Wrong MBAP length value: 0");
-            }
-            --len; // length includes one byte of unit identifier which is already in buffer
-
-            if (len + MBAP_SIZE > res.size()) {
-                res.resize(len + MBAP_SIZE);
-            }
-
-            rc = port.ReadFrame(res.data() + MBAP_SIZE, len, frameTimeout, frameTimeout);
-            if (rc.Count != len) {
-                throw TMalformedResponseError("Wrong PDU size: " + to_string(rc.Count) + ", expected " +
-                                              to_string(len));
-            }
+            auto rc = ReadAnyFrame(port, responseTimeout, frameTimeout, res);
 
             // check transaction id
             if (req[0] == res[0] && req[1] == res[1]) {
@@ -1127,6 +1800,46 @@ namespace Modbus // modbus protocol common utilities
         throw TResponseTimeoutException();
     }
 
+    TReadFrameResult TModbusTCPTraits::ReadAnyFrame(TPort& port,
+                                                    const std::chrono::milliseconds& responseTimeout,
+                                                    const std::chrono::milliseconds& frameTimeout,
+                                                    TResponse& res) const
+    {
+        if (res.size() < MBAP_SIZE) {
+            res.resize(MBAP_SIZE);
+        }
+        auto rc = port.ReadFrame(res.data(), MBAP_SIZE, responseTimeout + frameTimeout, frameTimeout);
+
+        if (rc.Count < MBAP_SIZE) {
+            throw TMalformedResponseError("Can't read full MBAP");
+        }
+
+        auto len = GetLengthFromMBAP(res);
+        // MBAP length should be at least 1 byte for unit identifier
+        if (len == 0) {
+            throw TMalformedResponseError("Wrong MBAP length value: 0");
+        }
+        --len; // length includes one byte of unit identifier which is already in buffer
+
+        if (len + MBAP_SIZE > res.size()) {
+            res.resize(len + MBAP_SIZE);
+        }
+
+        rc = port.ReadFrame(res.data() + MBAP_SIZE, len, frameTimeout, frameTimeout);
+        if (rc.Count != len) {
+            throw TMalformedResponseError("Wrong PDU size: " + to_string(rc.Count) + ", expected " + to_string(len));
+        }
+        return rc;
+    }
+
+    std::optional<uint16_t> TModbusTCPTraits::GetTransactionId(const std::vector<uint8_t>& frame) const
+    {
+        if (frame.size() < MBAP_SIZE) {
+            return std::nullopt;
+        }
+        return (frame[0] << 8) | frame[1];
+    }
+
     uint8_t* TModbusTCPTraits::GetPDU(std::vector<uint8_t>& frame) const
     {
         return &frame[MBAP_SIZE];
@@ -6,7 +6,10 @@
 #include "serial_device.h"
 #include <array>
 #include <bitset>
+#include <memory>
+#include <optional>
 #include <ostream>
+#include <vector>
 
 namespace Modbus // modbus protocol common utilities
 {
@@ -22,7 +25,36 @@ namespace Modbus // modbus protocol common utilities
 
     typedef std::vector<uint8_t> TRequest;
     typedef std::vector<uint8_t> TResponse;
-    typedef std::map<int64_t, uint16_t> TRegisterCache;
+
+    /**
+     * @brief Last known values of device's registers and coils by type and address.
+     *        Values are stored in flat pages allocated on first access, so lookups take constant time
+     *        and don't allocate memory. Addresses out of 16-bit range are not cached.
+     */
+    class TRegisterCache
+    {
+    public:
+        //! Returns nullptr if the value is unknown
+        const uint16_t* Find(int type, int address) const;
+
+        void Set(int type, int address, uint16_t value);
+        void Set(int type, int address, const uint16_t* values, size_t count);
+
+    private:
+        static const size_t PAGE_SIZE = 256;
+        static const size_t PAGES_COUNT = 0x10000 / PAGE_SIZE;
+
+        struct TPage
+        {
+            std::array<uint16_t, PAGE_SIZE> Values;
+            std::bitset<PAGE_SIZE> Known;
+        };
+
+        //! Pages by register type and address / PAGE_SIZE
+        std::vector<std::array<std::unique_ptr<TPage>, PAGES_COUNT>> Pages;
+
+        TPage* GetPage(int type, int address);
+    };
 
     class IModbusTraits
     {
@@ -33,6 +65,9 @@ namespace Modbus // modbus protocol common utilities
 
         virtual void FinalizeRequest(TRequest& request, uint8_t slaveId) = 0;
 
+        //! Prepare finalized request for sending again. Only fields unique for every request are changed
+        virtual void RefreshRequest(TRequest& request);
+
         /**
          * @brief Read response to specified request.
          *        Throws TSerialDeviceTransientErrorException on timeout.
@@ -45,6 +80,21 @@ namespace Modbus // modbus protocol common utilities
                                            const TRequest& req,
                                            TResponse& resp) const = 0;
 
+        /**
+         * @brief Read next response regardless of the request it answers.
+         *        Used to read responses to several requests sent at once.
+         *        Throws TSerialDeviceTransientErrorException on timeout.
+         *
+         * @return size_t PDU size in bytes
+         */
+        virtual TReadFrameResult ReadAnyFrame(TPort& port,
+                                              const std::chrono::milliseconds& responseTimeout,
+                                              const std::chrono::milliseconds& frameTimeout,
+                                              TResponse& resp) const;
+
+        //! Transaction id of a request or a response. Empty if responses can't be matched to requests
+        virtual std::optional<uint16_t> GetTransactionId(const std::vector<uint8_t>& frame) const;
+
         virtual uint8_t* GetPDU(std::vector<uint8_t>& frame) const = 0;
         virtual const uint8_t* GetPDU(const std::vector<uint8_t>& frame) const = 0;
     };
@@ -86,12 +136,22 @@ namespace Modbus // modbus protocol common utilities
 
         void FinalizeRequest(TRequest& request, uint8_t slaveId) override;
 
+        //! Sets next transaction id
+        void RefreshRequest(TRequest& request) override;
+
         TReadFrameResult ReadFrame(TPort& port,
                                    const std::chrono::milliseconds& responseTimeout,
                                    const std::chrono::milliseconds& frameTimeout,
                                    const TRequest& req,
                                    TResponse& resp) const override;
 
+        TReadFrameResult ReadAnyFrame(TPort& port,
+                                      const std::chrono::milliseconds& responseTimeout,
+                                      const std::chrono::milliseconds& frameTimeout,
+                                      TResponse& resp) const override;
+
+        std::optional<uint16_t> GetTransactionId(const std::vector<uint8_t>& frame) const override;
+
         uint8_t* GetPDU(std::vector<uint8_t>& frame) const override;
         const uint8_t* GetPDU(const std::vector<uint8_t>& frame) const override;
     };
@@ -117,11 +177,109 @@ namespace Modbus // modbus protocol common utilities
         std::unique_ptr<Modbus::IModbusTraits> GetModbusTraits(PPort port) override;
     };
 
+    /**
+     * @brief Finalized read requests of a device by register type, address, count of registers and slave id.
+     *        Requests of a stable poll plan are composed and finalized only once.
+     */
+    class TReadRequestCache
+    {
+    public:
+        //! Returns nullptr if the request is not cached
+        const TRequest* Find(uint64_t key) const;
+
+        void Add(uint64_t key, const TRequest& request);
+
+    private:
+        std::vector<std::pair<uint64_t, TRequest>> Requests;
+        size_t NextReplaced = 0;
+    };
+
+    typedef std::shared_ptr<TReadRequestCache> PReadRequestCache;
+
+    //! Maximum numbers of not polled registers, which can be read to join neighbouring registers in one request
+    struct THoles
+    {
+        int Registers = 0;
+        int Bits = 0;
+
+        bool operator==(const THoles& other) const;
+    };
+
+    /**
+     * @brief Holes which are read faster than a separate request is made.
+     *        Overhead of a request includes the response time, guard interval, frame timeouts
+     *        and service bytes of request and response. Zero if the port doesn't estimate send time.
+     */
+    THoles GetCostEffectiveHoles(const TPort& port,
+                                 const TDeviceConfig& config,
+                                 std::chrono::microseconds responseTime);
+
+    /**
+     * @brief Maximum count of registers in a read request accepted by a device.
+     *        Request size is bisected between the largest successfully read range
+     *        and the smallest range rejected by illegal data value or truncated response.
+     *        The limit is decreased after FAILURES_TO_DECREASE failures in a row
+     *        without successful reads of the smallest failed size or larger.
+     */
+    class TReadRegistersLimit
+    {
+    public:
+        static const int FAILURES_TO_DECREASE = 3;
+
+        /**
+         * @param maxCount Upper bound of the limit, 0 - maximum of the protocol
+         * @param learnedLimit Previously learned limit, 0 - unknown
+         */
+        explicit TReadRegistersLimit(int maxCount = 0, int learnedLimit = 0);
+
+        //! Limit for new ranges, 0 - not limited
+        int Get() const;
+
+        int GetMaxCount() const;
+
+        //! The limit is found and isn't changed anymore until it fails without successful reads
+        bool IsLearned() const;
+
+        void OnReadSuccess(int count);
+
+        /**
+         * @brief Returns true if the error can be caused by request size.
+         *        Learned limit is searched again if it fails the same way before any successful read of its size.
+         *        Failures of sizes larger than the learned limit don't change it.
+         */
+        bool OnReadFailure(int count);
+
+    private:
+        int MaxCount;
+        int MaxGoodCount;
+        int MinBadCount = 0;
+        bool Learned;
+
+        //! Learned limit was read successfully
+        bool Confirmed = false;
+
+        //! The smallest size of failed requests and number of failures in a row
+        int FailedCount = 0;
+        int Failures = 0;
+    };
+
+    typedef std::shared_ptr<TReadRegistersLimit> PReadRegistersLimit;
+
     class TModbusRegisterRange: public TRegisterRange
     {
     public:
-        TModbusRegisterRange(std::chrono::microseconds averageResponseTime);
-        ~TModbusRegisterRange();
+        TModbusRegisterRange(std::chrono::microseconds averageResponseTime,
+                             PReadRequestCache requestCache = PReadRequestCache());
+
+        //! Prepare the range for reuse. Registers are removed, allocated buffers are kept
+        void Reset(std::chrono::microseconds averageResponseTime);
+
+        //! Holes allowed in addition to configured ones if the device supports holes
+        void SetAutoHoles(const THoles& holes);
+
+        //! Results of reading the range are used to find the limit
+        void SetReadRegistersLimit(PReadRegistersLimit limit);
+        const PReadRegistersLimit& GetReadRegistersLimit() const;
 
         bool Add(PRegister reg, std::chrono::milliseconds pollLimit) override;
 
@@ -134,27 +292,66 @@ namespace Modbus // modbus protocol common utilities
         int Type() const;
         PSerialDevice Device() const;
 
-        TRequest GetRequest(IModbusTraits& traits, uint8_t slaveId, int shift) const;
         size_t GetResponseSize(IModbusTraits& traits) const;
 
+        //! Extend the range to device's minimum number of registers to read
+        void ExtendToMinReadRegisters();
+
+        //! Make read request. The range is extended to device's minimum number of registers to read.
+        //! The request is stored in the range's buffer and is valid until the next call
+        const TRequest& PrepareReadRequest(IModbusTraits& traits, uint8_t slaveId, int shift);
+
+        //! Check response to the read request and store read values
+        void ProcessReadResponse(IModbusTraits& traits,
+                                 const TRequest& request,
+                                 const TResponse& response,
+                                 const TReadFrameResult& readResult,
+                                 Modbus::TRegisterCache& cache);
+
         void ReadRange(IModbusTraits& traits, TPort& port, uint8_t slaveId, int shift, Modbus::TRegisterCache& cache);
 
         std::chrono::microseconds GetResponseTime() const;
 
+        std::chrono::microseconds GetPollTime() const override;
+
     private:
         bool HasHolesFlg = false;
         uint32_t Start;
         size_t Count = 0;
-        uint8_t* Bits = 0;
-        uint16_t* Words = 0;
+        std::vector<uint8_t> Bits;
+        std::vector<uint16_t> Words;
+        TRequest Request;
+        TResponse Response;
+        PReadRequestCache RequestCache;
+        THoles AutoHoles;
+        PReadRegistersLimit ReadRegistersLimit;
         std::chrono::microseconds AverageResponseTime;
         std::chrono::microseconds ResponseTime;
+        std::chrono::microseconds PollTime = std::chrono::microseconds::zero();
 
         bool AddingRegisterIncreasesSize(bool isSingleBit, size_t extend) const;
     };
 
     PRegisterRange CreateRegisterRange(std::chrono::microseconds averageResponseTime);
 
+    /**
+     * @brief Register ranges which are reused when nobody holds them anymore,
+     *        so steady polling doesn't allocate ranges and their buffers.
+     *        Ranges of the pool share read requests cache.
+     *        Must be used from one thread: the polling thread or the thread which prepares polling before its start.
+     */
+    class TRegisterRangePool
+    {
+    public:
+        TRegisterRangePool();
+
+        std::shared_ptr<TModbusRegisterRange> Get(std::chrono::microseconds averageResponseTime);
+
+    private:
+        std::vector<std::shared_ptr<TModbusRegisterRange>> Ranges;
+        PReadRequestCache RequestCache;
+    };
+
     void WriteRegister(IModbusTraits& traits,
                        TPort& port,
                        uint8_t slaveId,
@@ -163,6 +360,21 @@ namespace Modbus // modbus protocol common utilities
                        TRegisterCache& cache,
                        int shift = 0);
 
+    /**
+     * @brief Write registers with near addresses by single FN_WRITE_MULTIPLE_REGISTERS or FN_WRITE_MULTIPLE_COILS
+     *        requests. Holes up to maxHole registers between them are filled by cached values if they are known.
+     *        Registers written this way are marked as done, other registers must be written one by one.
+     *        Errors of combined requests are not reported.
+     */
+    void WriteRegisters(IModbusTraits& traits,
+                        TPort& port,
+                        uint8_t slaveId,
+                        std::vector<TRegisterWrite>& writes,
+                        TRegisterCache& cache,
+                        int maxWriteRegisters,
+                        int maxHole,
+                        int shift = 0);
+
     void ReadRegisterRange(IModbusTraits& traits,
                            TPort& port,
                            uint8_t slaveId,
@@ -170,6 +382,36 @@ namespace Modbus // modbus protocol common utilities
                            TRegisterCache& cache,
                            int shift = 0);
 
+    /**
+     * @brief Write the register and read the range by one FN_READ_WRITE_MULTIPLE_REGISTERS request.
+     *        The device writes before reading, so written registers can be read back by the same request.
+     *        Only holding registers are supported, returns false if the request can't be composed.
+     *        Errors are thrown without changing the range's registers.
+     */
+    bool WriteRegisterAndReadRange(IModbusTraits& traits,
+                                   TPort& port,
+                                   uint8_t slaveId,
+                                   TRegister& reg,
+                                   const TRegisterValue& value,
+                                   TModbusRegisterRange& range,
+                                   TRegisterCache& cache,
+                                   int shift = 0);
+
+    /**
+     * @brief Read several ranges of the device sending up to maxRequestsInFlight requests
+     *        without waiting for responses. Responses are matched to requests by transaction id.
+     *        A timeout or a malformed response fails only the requests in flight,
+     *        the rest of ranges are sent after them.
+     *        If the protocol has no transaction ids, ranges are read one by one.
+     */
+    void ReadRegisterRanges(IModbusTraits& traits,
+                            TPort& port,
+                            uint8_t slaveId,
+                            const std::vector<TModbusRegisterRange*>& ranges,
+                            TRegisterCache& cache,
+                            size_t maxRequestsInFlight,
+                            int shift = 0);
+
     void WriteSetupRegisters(IModbusTraits& traits,
                              TPort& port,
                              uint8_t slaveId,
@@ -189,6 +431,25 @@ namespace Modbus // modbus protocol common utilities
         TInvalidCRCError();
     };
 
+    //! Response with valid framing and less data than requested
+    class TTruncatedResponseError: public TMalformedResponseError
+    {
+    public:
+        TTruncatedResponseError(const std::string& what);
+    };
+
+    class TIllegalFunctionError: public TSerialDevicePermanentRegisterException
+    {
+    public:
+        TIllegalFunctionError();
+    };
+
+    class TIllegalDataValueError: public TSerialDevicePermanentRegisterException
+    {
+    public:
+        TIllegalDataValueError();
+    };
+
     void EnableWbContinuousRead(PSerialDevice device,
                                 IModbusTraits& traits,
                                 TPort& port,
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <queue>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 template<typename TItem> class TPriorityQueue: public std::priority_queue<TItem>
 {
@@ -14,25 +20,27 @@ public:
     }
 };
 
-template<class TEntry, typename ComparePredicate> class TPriorityQueueSchedule
+template<class TEntry, typename ComparePredicate> struct TScheduleItem
 {
-public:
-    struct TItem
-    {
-        TEntry Data;
-        std::chrono::steady_clock::time_point Deadline;
+    TEntry Data;
+    std::chrono::steady_clock::time_point Deadline;
 
-        bool operator<(const TItem& item) const
-        {
-            if (Deadline > item.Deadline) {
-                return true;
-            }
-            if (Deadline == item.Deadline) {
-                return ComparePredicate()(Data, item.Data);
-            }
-            return false;
+    bool operator<(const TScheduleItem& item) const
+    {
+        if (Deadline > item.Deadline) {
+            return true;
         }
-    };
+        if (Deadline == item.Deadline) {
+            return ComparePredicate()(Data, item.Data);
+        }
+        return false;
+    }
+};
+
+template<class TEntry, typename ComparePredicate> class TPriorityQueueSchedule
+{
+public:
+    using TItem = TScheduleItem<TEntry, ComparePredicate>;
 
     bool IsEmpty() const
     {
@@ -76,6 +84,508 @@ private:
     TPriorityQueue<TItem> Entries;
 };
 
+/**
+ * @brief State of an entry in a schedule: position in an indexed heap and deadline in a timing wheel.
+ *        Objects of shared_ptr entries derived from it keep their own state,
+ *        so such an entry can be in only one heap and one timing wheel at a time.
+ */
+struct TScheduleEntryState
+{
+    static constexpr size_t NPOS = std::numeric_limits<size_t>::max();
+
+    //! Position in an indexed heap, NPOS if the entry is not in a heap
+    size_t HeapPosition = NPOS;
+
+    //! Timing wheel containing the entry, nullptr if the entry is not in a wheel
+    const void* Wheel = nullptr;
+    std::chrono::steady_clock::time_point WheelDeadline;
+
+    bool IsUnused() const
+    {
+        return HeapPosition == NPOS && Wheel == nullptr;
+    }
+};
+
+//! States of arbitrary entries are kept in a hash map and erased as soon as entries leave the schedule
+template<class TEntry, class Enable = void> class TScheduleEntryStates
+{
+public:
+    TScheduleEntryState& Get(const TEntry& entry)
+    {
+        return States[entry];
+    }
+
+    const TScheduleEntryState* Find(const TEntry& entry) const
+    {
+        auto it = States.find(entry);
+        return (it == States.end()) ? nullptr : &it->second;
+    }
+
+    void Release(const TEntry& entry)
+    {
+        auto it = States.find(entry);
+        if (it != States.end() && it->second.IsUnused()) {
+            States.erase(it);
+        }
+    }
+
+private:
+    std::unordered_map<TEntry, TScheduleEntryState> States;
+};
+
+//! States of non-negative integral and enum entries are indexed by the entry value
+template<class TEntry>
+class TScheduleEntryStates<TEntry, std::enable_if_t<std::is_integral_v<TEntry> || std::is_enum_v<TEntry>>>
+{
+public:
+    TScheduleEntryState& Get(const TEntry& entry)
+    {
+        auto index = static_cast<size_t>(entry);
+        if (index >= States.size()) {
+            States.resize(index + 1);
+        }
+        return States[index];
+    }
+
+    const TScheduleEntryState* Find(const TEntry& entry) const
+    {
+        auto index = static_cast<size_t>(entry);
+        return (index < States.size()) ? &States[index] : nullptr;
+    }
+
+    void Release(const TEntry&)
+    {}
+
+private:
+    std::vector<TScheduleEntryState> States;
+};
+
+//! States of shared_ptr entries derived from TScheduleEntryState are stored in the entries
+template<class T>
+class TScheduleEntryStates<std::shared_ptr<T>, std::enable_if_t<std::is_base_of_v<TScheduleEntryState, T>>>
+{
+public:
+    TScheduleEntryState& Get(const std::shared_ptr<T>& entry)
+    {
+        return *entry;
+    }
+
+    const TScheduleEntryState* Find(const std::shared_ptr<T>& entry) const
+    {
+        return entry.get();
+    }
+
+    void Release(const std::shared_ptr<T>&)
+    {}
+};
+
+/**
+ * @brief d-ary heap with positions of entries kept in their TScheduleEntryState.
+ *        Entries are unique, Contains is O(1), Remove and UpdateDeadline are O(log n).
+ *        Entries order is the same as in TPriorityQueueSchedule.
+ */
+template<class TEntry, typename ComparePredicate, size_t Arity = 4> class TIndexedPriorityQueueSchedule
+{
+public:
+    using TItem = TScheduleItem<TEntry, ComparePredicate>;
+
+    bool IsEmpty() const
+    {
+        return Entries.empty();
+    }
+
+    //! Adds entry to the queue. If the entry is already in the queue, its deadline is updated.
+    void AddEntry(TEntry entry, std::chrono::steady_clock::time_point deadline)
+    {
+        auto pos = GetPosition(entry);
+        if (pos != NPOS) {
+            SetDeadline(pos, deadline);
+            return;
+        }
+        States.Get(entry).HeapPosition = Entries.size();
+        Entries.emplace_back(TItem{entry, deadline});
+        SiftUp(Entries.size() - 1);
+    }
+
+    std::chrono::steady_clock::time_point GetDeadline() const
+    {
+        if (Entries.empty()) {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        return Entries.front().Deadline;
+    }
+
+    const TItem& GetTop() const
+    {
+        return Entries.front();
+    }
+
+    void Pop()
+    {
+        RemoveAt(0);
+    }
+
+    bool HasReadyItems(std::chrono::steady_clock::time_point time) const
+    {
+        return !Entries.empty() && (GetDeadline() <= time);
+    }
+
+    bool Contains(const TEntry& entry) const
+    {
+        return GetPosition(entry) != NPOS;
+    }
+
+    //! Returns false if the entry is not in the queue
+    bool Remove(const TEntry& entry)
+    {
+        auto pos = GetPosition(entry);
+        if (pos == NPOS) {
+            return false;
+        }
+        RemoveAt(pos);
+        return true;
+    }
+
+    //! Returns false if the entry is not in the queue
+    bool UpdateDeadline(const TEntry& entry, std::chrono::steady_clock::time_point deadline)
+    {
+        auto pos = GetPosition(entry);
+        if (pos == NPOS) {
+            return false;
+        }
+        SetDeadline(pos, deadline);
+        return true;
+    }
+
+private:
+    static constexpr size_t NPOS = TScheduleEntryState::NPOS;
+
+    std::vector<TItem> Entries;
+    TScheduleEntryStates<TEntry> States;
+
+    static bool IsBefore(const TItem& i1, const TItem& i2)
+    {
+        return i2 < i1;
+    }
+
+    //! Shared state of an entry from another heap is detected by comparing entries
+    size_t GetPosition(const TEntry& entry) const
+    {
+        auto state = States.Find(entry);
+        if (state && state->HeapPosition < Entries.size() && Entries[state->HeapPosition].Data == entry) {
+            return state->HeapPosition;
+        }
+        return NPOS;
+    }
+
+    void Place(size_t pos, TItem&& item)
+    {
+        Entries[pos] = std::move(item);
+        States.Get(Entries[pos].Data).HeapPosition = pos;
+    }
+
+    //! Returns new position of the item
+    size_t SiftUp(size_t pos)
+    {
+        TItem item(std::move(Entries[pos]));
+        while (pos != 0) {
+            auto parent = (pos - 1) / Arity;
+            if (!IsBefore(item, Entries[parent])) {
+                break;
+            }
+            Place(pos, std::move(Entries[parent]));
+            pos = parent;
+        }
+        Place(pos, std::move(item));
+        return pos;
+    }
+
+    void SiftDown(size_t pos)
+    {
+        TItem item(std::move(Entries[pos]));
+        while (true) {
+            auto firstChild = pos * Arity + 1;
+            if (firstChild >= Entries.size()) {
+                break;
+            }
+            auto lastChild = std::min(firstChild + Arity, Entries.size());
+            auto best = firstChild;
+            for (auto child = firstChild + 1; child < lastChild; ++child) {
+                if (IsBefore(Entries[child], Entries[best])) {
+                    best = child;
+                }
+            }
+            if (!IsBefore(Entries[best], item)) {
+                break;
+            }
+            Place(pos, std::move(Entries[best]));
+            pos = best;
+        }
+        Place(pos, std::move(item));
+    }
+
+    void SetDeadline(size_t pos, std::chrono::steady_clock::time_point deadline)
+    {
+        Entries[pos].Deadline = deadline;
+        Restore(pos);
+    }
+
+    void RemoveAt(size_t pos)
+    {
+        TEntry entry(std::move(Entries[pos].Data));
+        if (pos + 1 == Entries.size()) {
+            Entries.pop_back();
+        } else {
+            Entries[pos] = std::move(Entries.back());
+            Entries.pop_back();
+            Restore(pos);
+        }
+        States.Get(entry).HeapPosition = NPOS;
+        States.Release(entry);
+    }
+
+    void Restore(size_t pos)
+    {
+        if (SiftUp(pos) == pos) {
+            SiftDown(pos);
+        }
+    }
+};
+
+/**
+ * @brief Hierarchical timing wheel with the same interface as TIndexedPriorityQueueSchedule.
+ *        Entries are bucketed by 1ms ticks into WHEEL_LEVELS levels of 64 slots.
+ *        Entries of the earliest occupied tick are moved to a small heap (Due),
+ *        so the order of entries is exactly the same as in TPriorityQueueSchedule.
+ *        Insertion is O(1), extraction is amortized O(1) plus heap operations on entries of one tick.
+ */
+template<class TEntry, typename ComparePredicate> class TTimingWheelSchedule
+{
+public:
+    using TItem = TScheduleItem<TEntry, ComparePredicate>;
+
+    TTimingWheelSchedule()
+    {
+        // Every buffer is either in a slot or spare, so spare buffers never exceed number of slots
+        SpareBuffers.reserve(WHEEL_LEVELS << SLOT_BITS);
+    }
+
+    bool IsEmpty() const
+    {
+        return Size == 0;
+    }
+
+    //! Adds entry to the schedule. If the entry is already in the schedule, its deadline is updated.
+    void AddEntry(TEntry entry, std::chrono::steady_clock::time_point deadline)
+    {
+        Remove(entry);
+        if (Size == 0) {
+            CurrentTick = GetTick(deadline);
+        }
+        ++Size;
+        auto& state = States.Get(entry);
+        state.Wheel = this;
+        state.WheelDeadline = deadline;
+        Insert(TItem{entry, deadline});
+    }
+
+    std::chrono::steady_clock::time_point GetDeadline() const
+    {
+        return Due.GetDeadline();
+    }
+
+    const TItem& GetTop() const
+    {
+        return Due.GetTop();
+    }
+
+    void Pop()
+    {
+        TEntry entry(Due.GetTop().Data);
+        Due.Pop();
+        States.Get(entry).Wheel = nullptr;
+        States.Release(entry);
+        --Size;
+        Advance();
+    }
+
+    bool HasReadyItems(std::chrono::steady_clock::time_point time) const
+    {
+        return Due.HasReadyItems(time);
+    }
+
+    bool Contains(const TEntry& entry) const
+    {
+        auto state = States.Find(entry);
+        return state && state->Wheel == this;
+    }
+
+    //! Returns false if the entry is not in the schedule
+    bool Remove(const TEntry& entry)
+    {
+        if (!Contains(entry)) {
+            return false;
+        }
+        auto& state = States.Get(entry);
+        state.Wheel = nullptr;
+        --Size;
+        // Entry location is fully defined by its tick and CurrentTick, the same way as in Insert
+        auto tick = GetTick(state.WheelDeadline);
+        States.Release(entry);
+        if (tick <= CurrentTick) {
+            Due.Remove(entry);
+            Advance();
+            return true;
+        }
+        auto level = GetLevel(tick);
+        if (level >= WHEEL_LEVELS) {
+            Erase(Overflow, entry);
+            return true;
+        }
+        auto slot = GetSlot(tick, level);
+        Erase(Levels[level].Slots[slot], entry);
+        if (Levels[level].Slots[slot].empty()) {
+            FreeSlot(level, slot);
+        }
+        return true;
+    }
+
+    //! Returns false if the entry is not in the schedule
+    bool UpdateDeadline(const TEntry& entry, std::chrono::steady_clock::time_point deadline)
+    {
+        if (!Contains(entry)) {
+            return false;
+        }
+        AddEntry(entry, deadline);
+        return true;
+    }
+
+private:
+    static constexpr size_t WHEEL_LEVELS = 4;
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr uint64_t SLOT_MASK = (1 << SLOT_BITS) - 1;
+
+    struct TLevel
+    {
+        std::array<std::vector<TItem>, 1 << SLOT_BITS> Slots;
+        uint64_t Occupied = 0;
+    };
+
+    std::array<TLevel, WHEEL_LEVELS> Levels;
+    std::vector<TItem> Overflow;
+    std::vector<TItem> Cascade;
+
+    //! Buffers of empty slots. They are given to slots being filled, so new slots don't allocate memory
+    std::vector<std::vector<TItem>> SpareBuffers;
+
+    //! Entries with tick less or equal to CurrentTick. Not empty if the schedule is not empty
+    TIndexedPriorityQueueSchedule<TEntry, ComparePredicate> Due;
+    TScheduleEntryStates<TEntry> States;
+    uint64_t CurrentTick = 0;
+    size_t Size = 0;
+
+    static uint64_t GetTick(std::chrono::steady_clock::time_point time)
+    {
+        auto ms = std::chrono::floor<std::chrono::milliseconds>(time.time_since_epoch()).count();
+        return (ms > 0) ? static_cast<uint64_t>(ms) : 0;
+    }
+
+    //! The level is selected by the most significant SLOT_BITS group in which tick and CurrentTick differ
+    size_t GetLevel(uint64_t tick) const
+    {
+        return (63 - __builtin_clzll(tick ^ CurrentTick)) / SLOT_BITS;
+    }
+
+    static uint64_t GetSlot(uint64_t tick, size_t level)
+    {
+        return (tick >> (level * SLOT_BITS)) & SLOT_MASK;
+    }
+
+    static void Erase(std::vector<TItem>& items, const TEntry& entry)
+    {
+        auto it = std::find_if(items.begin(), items.end(), [&](const TItem& item) { return item.Data == entry; });
+        *it = std::move(items.back());
+        items.pop_back();
+    }
+
+    void Insert(TItem&& item)
+    {
+        auto tick = GetTick(item.Deadline);
+        if (tick <= CurrentTick) {
+            Due.AddEntry(item.Data, item.Deadline);
+            return;
+        }
+        auto level = GetLevel(tick);
+        if (level >= WHEEL_LEVELS) {
+            Overflow.emplace_back(std::move(item));
+            return;
+        }
+        auto slot = GetSlot(tick, level);
+        auto& items = Levels[level].Slots[slot];
+        if (items.empty() && !SpareBuffers.empty()) {
+            items.swap(SpareBuffers.back());
+            SpareBuffers.pop_back();
+        }
+        items.emplace_back(std::move(item));
+        Levels[level].Occupied |= (uint64_t(1) << slot);
+    }
+
+    void FreeSlot(size_t level, uint64_t slot)
+    {
+        Levels[level].Occupied &= ~(uint64_t(1) << slot);
+        auto& items = Levels[level].Slots[slot];
+        if (items.capacity() != 0) {
+            SpareBuffers.emplace_back(std::move(items));
+            items.clear();
+        }
+    }
+
+    void Advance()
+    {
+        while (Due.IsEmpty() && Size != 0) {
+            if (!CascadeNextSlot()) {
+                CascadeOverflow();
+            }
+        }
+    }
+
+    bool CascadeNextSlot()
+    {
+        for (size_t level = 0; level < WHEEL_LEVELS; ++level) {
+            // Occupied slots after current one. Shift of 64 is avoided as (2 << 63) == 0 for uint64_t
+            auto nextSlots = Levels[level].Occupied & ~((uint64_t(2) << GetSlot(CurrentTick, level)) - 1);
+            if (nextSlots == 0) {
+                continue;
+            }
+            uint64_t slot = __builtin_ctzll(nextSlots);
+            auto levelShift = (level + 1) * SLOT_BITS;
+            CurrentTick = ((CurrentTick >> levelShift) << levelShift) | (slot << (level * SLOT_BITS));
+            // Items of the slot are moved to lower levels or to Due, so the slot isn't changed during the loop
+            auto& items = Levels[level].Slots[slot];
+            for (auto& item: items) {
+                Insert(std::move(item));
+            }
+            items.clear();
+            FreeSlot(level, slot);
+            return true;
+        }
+        return false;
+    }
+
+    void CascadeOverflow()
+    {
+        auto it = std::min_element(Overflow.cbegin(), Overflow.cend(), [](const TItem& i1, const TItem& i2) {
+            return i1.Deadline < i2.Deadline;
+        });
+        CurrentTick = GetTick(it->Deadline);
+        Cascade.swap(Overflow);
+        for (auto& item: Cascade) {
+            Insert(std::move(item));
+        }
+        Cascade.clear();
+    }
+};
+
 enum class TPriority
 {
     High,
@@ -94,43 +604,61 @@ enum class TThrottlingState
     LowPriorityRateLimit
 };
 
+/**
+ * @brief Token bucket limiting rate of items.
+ *        Tokens are refilled evenly with rateLimit tokens per second up to burstSize tokens.
+ *        Every item takes one token.
+ */
 class TRateLimiter
 {
-    size_t RateLimit;
-    size_t Count = 0;
-    std::chrono::steady_clock::time_point StartTime;
+    //! Tokens per second, 0 - no limit
+    double Rate;
+    double BurstSize;
+    double Tokens;
+    std::chrono::steady_clock::time_point UpdateTime;
+
+    double GetTokens(std::chrono::steady_clock::time_point time) const
+    {
+        if (time <= UpdateTime) {
+            return Tokens;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(time - UpdateTime).count();
+        return std::min(BurstSize, Tokens + elapsed * Rate);
+    }
 
 public:
-    TRateLimiter(size_t rateLimit): RateLimit(rateLimit)
+    /**
+     * @param rateLimit - maximum number of items per second, 0 - no limit
+     * @param burstSize - maximum number of items at once, 0 - equal to rateLimit
+     */
+    TRateLimiter(size_t rateLimit, size_t burstSize = 0)
+        : Rate(static_cast<double>(rateLimit)),
+          BurstSize(static_cast<double>(burstSize ? burstSize : rateLimit)),
+          Tokens(BurstSize)
     {}
 
     void NewItem(std::chrono::steady_clock::time_point time)
     {
-        if (RateLimit == 0) {
+        if (Rate == 0) {
             return;
         }
-        if (time - StartTime <= std::chrono::seconds(1)) {
-            ++Count;
-            return;
-        }
-        Count = 1;
-        StartTime = std::chrono::time_point_cast<std::chrono::seconds>(time);
+        Tokens = std::max(GetTokens(time) - 1, 0.0);
+        UpdateTime = std::max(time, UpdateTime);
     }
 
     bool IsOverLimit(std::chrono::steady_clock::time_point time) const
     {
-        if (RateLimit == 0) {
-            return false;
-        }
-        if (time - StartTime <= std::chrono::seconds(1)) {
-            return Count > RateLimit;
-        }
-        return false;
+        return (Rate != 0) && (GetTokens(time) < 1);
     }
 
-    std::chrono::steady_clock::time_point GetStartTime() const
+    //! Returns time when next item is allowed
+    std::chrono::steady_clock::time_point GetDeadline(std::chrono::steady_clock::time_point time) const
     {
-        return StartTime;
+        if (!IsOverLimit(time)) {
+            return time;
+        }
+        return UpdateTime + std::chrono::ceil<std::chrono::microseconds>(
+                                std::chrono::duration<double>((1 - Tokens) / Rate));
     }
 };
 
@@ -187,23 +715,114 @@ public:
     }
 };
 
-template<class TEntry, class TComparePredicate = std::less<TEntry>> class TScheduler
+/**
+ * @brief Deficit round robin over classes of items.
+ *        Every class gets a share of time proportional to its weight.
+ *        Time is charged after an item is processed, so a deficit can become negative
+ *        and the class waits until other classes get their share.
+ */
+class TDeficitRoundRobin
 {
+    struct TClass
+    {
+        std::chrono::milliseconds Quantum;
+        std::chrono::milliseconds Deficit;
+    };
+
+    std::vector<TClass> Classes;
+    size_t Current;
+
 public:
-    using TQueue = TPriorityQueueSchedule<TEntry, TComparePredicate>;
+    TDeficitRoundRobin(const std::vector<size_t>& weights, std::chrono::milliseconds quantum): Current(0)
+    {
+        for (auto weight: weights) {
+            Classes.push_back({quantum * std::max(weight, size_t(1)), std::chrono::milliseconds::zero()});
+        }
+    }
+
+    size_t GetClassCount() const
+    {
+        return Classes.size();
+    }
+
+    /**
+     * @brief Selects class of next item
+     *
+     * @param hasItems - predicate returning true if a class has ready items
+     * @return index of selected class or GetClassCount() if there are no ready items
+     */
+    template<class THasItemsPredicate> size_t Select(THasItemsPredicate hasItems)
+    {
+        bool hasReadyClasses = false;
+        for (size_t i = 0; i < Classes.size(); ++i) {
+            if (hasItems(i)) {
+                hasReadyClasses = true;
+            } else {
+                // Idle classes don't save their share
+                Classes[i].Deficit = std::chrono::milliseconds::zero();
+            }
+        }
+        if (!hasReadyClasses) {
+            return Classes.size();
+        }
+        while (!hasItems(Current) || Classes[Current].Deficit <= std::chrono::milliseconds::zero()) {
+            Current = (Current + 1) % Classes.size();
+            if (hasItems(Current)) {
+                Classes[Current].Deficit += Classes[Current].Quantum;
+            }
+        }
+        return Current;
+    }
+
+    void Charge(size_t classIndex, std::chrono::milliseconds time)
+    {
+        if (classIndex < Classes.size()) {
+            Classes[classIndex].Deficit -= time;
+        }
+    }
+};
+
+template<class TEntry,
+         class TComparePredicate = std::less<TEntry>,
+         template<class, typename> class TQueueSchedule = TIndexedPriorityQueueSchedule>
+class TScheduler
+{
+public:
+    using TQueue = TQueueSchedule<TEntry, TComparePredicate>;
     using TItem = typename TQueue::TItem;
 
-    TScheduler(std::chrono::milliseconds maxLowPriorityLag, size_t lowPriorityRateLimit)
-        : TimeBalancer(maxLowPriorityLag, 2 * maxLowPriorityLag),
-          LowPriorityRateLimit(lowPriorityRateLimit)
+    /**
+     * @param maxLowPriorityLag - maximum time high priority entries can delay low priority ones
+     * @param lowPriorityRateLimit - maximum number of low priority entries per second, 0 - no limit
+     * @param lowPriorityBurstSize - maximum number of low priority entries at once, 0 - equal to rate limit
+     * @param lowPriorityClassWeights - weights of low priority classes' shares of bus time
+     */
+    TScheduler(std::chrono::milliseconds maxLowPriorityLag,
+               size_t lowPriorityRateLimit,
+               size_t lowPriorityBurstSize = 0,
+               const std::vector<size_t>& lowPriorityClassWeights = {1})
+        : LowPriorityQueues(std::max(lowPriorityClassWeights.size(), size_t(1))),
+          TimeBalancer(maxLowPriorityLag, 2 * maxLowPriorityLag),
+          LowPriorityRateLimit(lowPriorityRateLimit, lowPriorityBurstSize),
+          LowPriorityClasses(lowPriorityClassWeights.empty() ? std::vector<size_t>{1} : lowPriorityClassWeights,
+                             LOW_PRIORITY_CLASS_QUANTUM),
+          LastLowPriorityClass(0)
     {
         ResetLoadBalancing();
     }
 
-    void AddEntry(TEntry entry, std::chrono::steady_clock::time_point deadline, TPriority priority)
+    /**
+     * @brief Adds entry to the schedule
+     *
+     * @param lowPriorityClass - index of low priority class, it is ignored for high priority entries
+     */
+    void AddEntry(TEntry entry,
+                  std::chrono::steady_clock::time_point deadline,
+                  TPriority priority,
+                  size_t lowPriorityClass = 0)
     {
         if (priority == TPriority::Low) {
-            LowPriorityQueue.AddEntry(entry, deadline);
+            LowPriorityQueues[std::min(lowPriorityClass, LowPriorityQueues.size() - 1)].AddEntry(entry, deadline);
         } else {
             HighPriorityQueue.AddEntry(entry, deadline);
         }
@@ -211,9 +830,9 @@ public:
 
     std::chrono::steady_clock::time_point GetDeadline(std::chrono::steady_clock::time_point time) const
     {
-        auto lowPriorityDeadline = LowPriorityQueue.GetDeadline();
-        if (!LowPriorityQueue.IsEmpty() && LowPriorityRateLimit.IsOverLimit(time)) {
-            lowPriorityDeadline = LowPriorityRateLimit.GetStartTime() + std::chrono::seconds(1);
+        auto lowPriorityDeadline = GetLowPriorityDeadline();
+        if (!IsLowPriorityEmpty() && LowPriorityRateLimit.IsOverLimit(time)) {
+            lowPriorityDeadline = std::max(lowPriorityDeadline, LowPriorityRateLimit.GetDeadline(time));
         }
         return std::min(HighPriorityQueue.GetDeadline(), lowPriorityDeadline);
     }
@@ -239,7 +858,7 @@ public:
     TThrottlingState AccumulateNext(std::chrono::steady_clock::time_point currentTime, TAccumulator& accumulator)
     {
         if (HighPriorityQueue.HasReadyItems(currentTime) &&
-            (!ShouldSelectLowPriority(currentTime) || !LowPriorityQueue.HasReadyItems(currentTime)))
+            (!ShouldSelectLowPriority(currentTime) || !HasReadyLowPriorityItems(currentTime)))
         {
             bool firstItem = true;
             while (HighPriorityQueue.HasReadyItems(currentTime) &&
@@ -252,7 +871,11 @@ public:
                 firstItem = false;
             }
         } else {
-            if (LowPriorityQueue.HasReadyItems(currentTime)) {
+            auto lowPriorityClass = LowPriorityClasses.Select(
+                [&](size_t i) { return LowPriorityQueues[i].HasReadyItems(currentTime); });
+            if (lowPriorityClass < LowPriorityQueues.size()) {
+                LastLowPriorityClass = lowPriorityClass;
+                auto& lowPriorityQueue = LowPriorityQueues[lowPriorityClass];
                 const auto pollLimit = GetLowPriorityPollLimit(currentTime);
                 bool force = ShouldSelectLowPriority(currentTime);
                 bool firstItem = true;
@@ -260,13 +883,13 @@ public:
                 // if it is selected to balance load.
                 // Following low priority items should be selected only
                 // if they poll time is not more than low priority items lag.
-                while (LowPriorityQueue.HasReadyItems(currentTime) && !LowPriorityRateLimit.IsOverLimit(currentTime) &&
-                       accumulator(LowPriorityQueue.GetTop().Data,
+                while (lowPriorityQueue.HasReadyItems(currentTime) && !LowPriorityRateLimit.IsOverLimit(currentTime) &&
+                       accumulator(lowPriorityQueue.GetTop().Data,
                                    (force && firstItem) ? TItemAccumulationPolicy::Force
                                                         : TItemAccumulationPolicy::AccordingToPollLimitTime,
                                    pollLimit))
                 {
-                    LowPriorityQueue.Pop();
+                    lowPriorityQueue.Pop();
                     LowPriorityRateLimit.NewItem(currentTime);
                     firstItem = false;
                 }
@@ -283,6 +906,7 @@ public:
             TimeBalancer.IncrementTotalTime(delta);
         } else {
             TimeBalancer.DecrementTotalTime(delta);
+            LowPriorityClasses.Charge(LastLowPriorityClass, delta);
         }
     }
 
@@ -291,14 +915,35 @@ public:
         TimeBalancer.Reset();
     }
 
-    bool Contains(TEntry entry)
+    bool Contains(const TEntry& entry) const
+    {
+        return HighPriorityQueue.Contains(entry) ||
+               std::any_of(LowPriorityQueues.begin(), LowPriorityQueues.end(), [&](const TQueue& queue) {
+                   return queue.Contains(entry);
+               });
+    }
+
+    //! Returns false if the entry is not scheduled
+    bool Remove(const TEntry& entry)
     {
-        return LowPriorityQueue.Contains(entry) || HighPriorityQueue.Contains(entry);
+        return HighPriorityQueue.Remove(entry) ||
+               std::any_of(LowPriorityQueues.begin(), LowPriorityQueues.end(), [&](TQueue& queue) {
+                   return queue.Remove(entry);
+               });
+    }
+
+    //! Moves the entry to new deadline keeping its priority. Returns false if the entry is not scheduled
+    bool UpdateDeadline(const TEntry& entry, std::chrono::steady_clock::time_point deadline)
+    {
+        return HighPriorityQueue.UpdateDeadline(entry, deadline) ||
+               std::any_of(LowPriorityQueues.begin(), LowPriorityQueues.end(), [&](TQueue& queue) {
+                   return queue.UpdateDeadline(entry, deadline);
+               });
     }
 
     bool IsEmpty() const
     {
-        return LowPriorityQueue.IsEmpty() && HighPriorityQueue.IsEmpty();
+        return HighPriorityQueue.IsEmpty() && IsLowPriorityEmpty();
     }
 
     std::chrono::milliseconds GetTotalTime() const
@@ -307,10 +952,38 @@ public:
     }
 
 private:
-    TQueue LowPriorityQueue;
+    //! Time share of a low priority class with weight 1 in a round
+    static constexpr std::chrono::milliseconds LOW_PRIORITY_CLASS_QUANTUM{10};
+
+    std::vector<TQueue> LowPriorityQueues;
     TQueue HighPriorityQueue;
     TTotalTimeBalancer TimeBalancer;
     TRateLimiter LowPriorityRateLimit;
+    TDeficitRoundRobin LowPriorityClasses;
+    size_t LastLowPriorityClass;
+
+    bool IsLowPriorityEmpty() const
+    {
+        return std::all_of(LowPriorityQueues.begin(), LowPriorityQueues.end(), [](const TQueue& queue) {
+            return queue.IsEmpty();
+        });
+    }
+
+    bool HasReadyLowPriorityItems(std::chrono::steady_clock::time_point currentTime) const
+    {
+        return std::any_of(LowPriorityQueues.begin(), LowPriorityQueues.end(), [&](const TQueue& queue) {
+            return queue.HasReadyItems(currentTime);
+        });
+    }
+
+    std::chrono::steady_clock::time_point GetLowPriorityDeadline() const
+    {
+        auto res = std::chrono::steady_clock::time_point::max();
+        for (const auto& queue: LowPriorityQueues) {
+            res = std::min(res, queue.GetDeadline());
+        }
+        return res;
+    }
 
     std::chrono::milliseconds GetLowPriorityPollLimit(std::chrono::steady_clock::time_point currentTime) const
     {
@@ -0,0 +1,513 @@
+#include "poll_simulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <unordered_map>
+
+#include <wblib/utils.h>
+
+#include "bus_load.h"
+#include "crc16.h"
+#include "log.h"
+#include "serial_client.h"
+#include "serial_device.h"
+#include "serial_exc.h"
+
+using namespace std::chrono_literals;
+using namespace std::chrono;
+
+#define LOG(logger) logger.Log() << "[simulator] "
+
+namespace
+{
+    const size_t MBAP_SIZE = 7;
+    const uint8_t BROADCAST_SLAVE_ID = 0;
+    const uint8_t EVENTS_BROADCAST_SLAVE_ID = 0xFD;
+    const uint8_t ILLEGAL_FUNCTION = 1;
+
+    // A cycle which doesn't consume time must not hang simulation
+    const auto MIN_CYCLE_TIME = 100us;
+
+    const auto MISSED_PERIOD_FACTOR = 1.1;
+    const auto MIN_STARVATION_INTERVAL = 10s;
+
+    void PrintSimulationOptionsUsage(const std::string& appName)
+    {
+        std::cout << "Usage:" << std::endl
+                  << " " << appName << " -c config -S option=value[,option=value...]" << std::endl
+                  << "Runs polling of registers from config with simulated Modbus devices on a virtual clock" << std::endl
+                  << "and prints achieved read periods of registers. Real ports are not used." << std::endl
+                  << "Options:" << std::endl
+                  << "  duration  simulated time with ms, s, m or h suffix (default: 1h)" << std::endl
+                  << "  latency   device's response latency in ms (default: 5)" << std::endl
+                  << "  baud      baud rate of all serial ports (default: from config)" << std::endl;
+    }
+
+    milliseconds ParseDuration(const std::string& value)
+    {
+        size_t pos = 0;
+        auto number = std::stoull(value, &pos);
+        auto suffix = value.substr(pos);
+        if (suffix == "ms") {
+            return milliseconds(number);
+        }
+        if (suffix.empty() || suffix == "s") {
+            return seconds(number);
+        }
+        if (suffix == "m") {
+            return minutes(number);
+        }
+        if (suffix == "h") {
+            return hours(number);
+        }
+        throw std::runtime_error("invalid duration: " + value);
+    }
+
+    TPollSimulatorSettings ParseSimulationOptions(const char* options)
+    {
+        TPollSimulatorSettings settings;
+        for (const auto& option: WBMQTT::StringSplit(options, ",")) {
+            auto nameValue = WBMQTT::StringSplit(option, "=");
+            if (nameValue.size() != 2) {
+                throw std::runtime_error("invalid option: " + option);
+            }
+            if (nameValue[0] == "duration") {
+                settings.Duration = ParseDuration(nameValue[1]);
+            } else if (nameValue[0] == "latency") {
+                settings.ResponseLatency = milliseconds(std::stoul(nameValue[1]));
+            } else if (nameValue[0] == "baud") {
+                settings.BaudRate = std::stoi(nameValue[1]);
+            } else {
+                throw std::runtime_error("unknown option: " + nameValue[0]);
+            }
+        }
+        return settings;
+    }
+
+    uint16_t GetUint16(const uint8_t* buf)
+    {
+        return (buf[0] << 8) | buf[1];
+    }
+
+    std::vector<uint8_t> MakeResponsePDU(const uint8_t* pdu, size_t size)
+    {
+        const auto function = pdu[0];
+        switch (function) {
+            case 1:
+            case 2: {
+                if (size < 5) {
+                    break;
+                }
+                uint8_t byteCount = (GetUint16(pdu + 3) + 7) / 8;
+                std::vector<uint8_t> res(2 + byteCount, 0);
+                res[0] = function;
+                res[1] = byteCount;
+                return res;
+            }
+            case 3:
+            case 4: {
+                if (size < 5) {
+                    break;
+                }
+                uint8_t byteCount = GetUint16(pdu + 3) * 2;
+                std::vector<uint8_t> res(2 + byteCount, 0);
+                res[0] = function;
+                res[1] = byteCount;
+                return res;
+            }
+            case 5:
+            case 6: {
+                return std::vector<uint8_t>(pdu, pdu + size);
+            }
+            case 15:
+            case 16: {
+                if (size < 5) {
+                    break;
+                }
+                return std::vector<uint8_t>(pdu, pdu + 5);
+            }
+        }
+        return {static_cast<uint8_t>(function | 0x80), ILLEGAL_FUNCTION};
+    }
+
+    double ToMs(microseconds time)
+    {
+        return time.count() / 1000.0;
+    }
+
+    std::optional<milliseconds> GetTargetPeriod(const PRegister& reg)
+    {
+        if (reg->ReadPeriod) {
+            return reg->ReadPeriod;
+        }
+        return reg->ReadRateLimit;
+    }
+}
+
+TVirtualClock::TVirtualClock(): Time(steady_clock::now())
+{}
+
+steady_clock::time_point TVirtualClock::Now() const
+{
+    return Time;
+}
+
+void TVirtualClock::Advance(microseconds delta)
+{
+    Time += delta;
+}
+
+void TVirtualClock::AdvanceTo(steady_clock::time_point time)
+{
+    Time = std::max(Time, time);
+}
+
+TSimulatedModbusPort::TSimulatedModbusPort(const std::string& description,
+                                           std::optional<TSerialPortConnectionSettings> serialSettings,
+                                           bool modbusTcp,
+                                           microseconds responseLatency,
+                                           TVirtualClock& clock)
+    : Description(description),
+      SerialSettings(serialSettings),
+      ModbusTcp(modbusTcp),
+      ResponseLatency(responseLatency),
+      Clock(clock),
+      LastInteraction(clock.Now())
+{}
+
+void TSimulatedModbusPort::Open()
+{}
+
+void TSimulatedModbusPort::Close()
+{}
+
+bool TSimulatedModbusPort::IsOpen() const
+{
+    return true;
+}
+
+void TSimulatedModbusPort::CheckPortOpen() const
+{}
+
+void TSimulatedModbusPort::Spend(microseconds time)
+{
+    Clock.Advance(time);
+    BusyTime += time;
+}
+
+void TSimulatedModbusPort::WriteBytes(const uint8_t* buf, int count)
+{
+    Spend(GetSendTimeBytes(count));
+    LastInteraction = Clock.Now();
+
+    TPendingResponse response;
+    if (ModbusTcp) {
+        if (count <= static_cast<int>(MBAP_SIZE)) {
+            return;
+        }
+        auto pdu = MakeResponsePDU(buf + MBAP_SIZE, count - MBAP_SIZE);
+        response.Data.assign(buf, buf + MBAP_SIZE);
+        response.Data[2] = 0;
+        response.Data[3] = 0;
+        response.Data[4] = ((pdu.size() + 1) >> 8) & 0xFF;
+        response.Data[5] = (pdu.size() + 1) & 0xFF;
+        response.Data.insert(response.Data.end(), pdu.begin(), pdu.end());
+        response.ReadyTime = Clock.Now() + ResponseLatency;
+        PendingResponses.push_back(std::move(response));
+        return;
+    }
+
+    // A new request on serial bus discards unread responses
+    PendingResponses.clear();
+    Response.clear();
+    ResponsePos = 0;
+
+    // slave id + function + CRC
+    if (count < 4 || buf[0] == BROADCAST_SLAVE_ID || buf[0] == EVENTS_BROADCAST_SLAVE_ID) {
+        return;
+    }
+    auto pdu = MakeResponsePDU(buf + 1, count - 3);
+    response.Data.push_back(buf[0]);
+    response.Data.insert(response.Data.end(), pdu.begin(), pdu.end());
+    auto crc = CRC16::CalculateCRC16(response.Data.data(), response.Data.size());
+    response.Data.push_back(crc >> 8);
+    response.Data.push_back(crc & 0xFF);
+    response.ReadyTime = Clock.Now() + ResponseLatency + GetSendTimeBytes(response.Data.size());
+    PendingResponses.push_back(std::move(response));
+}
+
+uint8_t TSimulatedModbusPort::ReadByte(const microseconds& timeout)
+{
+    uint8_t b;
+    ReadFrame(&b, 1, timeout, timeout);
+    return b;
+}
+
+TReadFrameResult TSimulatedModbusPort::ReadFrame(uint8_t* buf,
+                                                 size_t count,
+                                                 const microseconds& responseTimeout,
+                                                 const microseconds& frameTimeout,
+                                                 TFrameCompletePred frameComplete)
+{
+    TReadFrameResult res;
+    if (ResponsePos >= Response.size()) {
+        if (PendingResponses.empty()) {
+            Spend(responseTimeout);
+            LastInteraction = Clock.Now();
+            throw TResponseTimeoutException();
+        }
+        Response = std::move(PendingResponses.front().Data);
+        ResponsePos = 0;
+        auto waitTime = ceil<microseconds>(PendingResponses.front().ReadyTime - Clock.Now());
+        PendingResponses.pop_front();
+        if (waitTime > microseconds::zero()) {
+            // Serial response's waiting time includes its transmission
+            res.ResponseTime = std::min(waitTime, ResponseLatency);
+            Spend(waitTime);
+        }
+    }
+    res.Count = std::min(count, Response.size() - ResponsePos);
+    memcpy(buf, Response.data() + ResponsePos, res.Count);
+    ResponsePos += res.Count;
+    LastInteraction = Clock.Now();
+    return res;
+}
+
+void TSimulatedModbusPort::SkipNoise()
+{
+    PendingResponses.clear();
+    Response.clear();
+    ResponsePos = 0;
+}
+
+void TSimulatedModbusPort::SleepSinceLastInteraction(const microseconds& us)
+{
+    auto delta = duration_cast<microseconds>(LastInteraction + us - Clock.Now());
+    if (delta > microseconds::zero()) {
+        Spend(delta);
+    }
+}
+
+microseconds TSimulatedModbusPort::GetSendTimeBytes(double bytesNumber) const
+{
+    if (!SerialSettings) {
+        return microseconds::zero();
+    }
+    size_t bitsPerByte = 1 + SerialSettings->DataBits + SerialSettings->StopBits;
+    if (SerialSettings->Parity != 'N') {
+        ++bitsPerByte;
+    }
+    return GetSendTimeBits(std::ceil(bitsPerByte * bytesNumber));
+}
+
+microseconds TSimulatedModbusPort::GetSendTimeBits(size_t bitsNumber) const
+{
+    if (!SerialSettings) {
+        return microseconds::zero();
+    }
+    auto us = std::ceil(bitsNumber * 1000000.0 / double(SerialSettings->BaudRate));
+    return microseconds(static_cast<microseconds::rep>(us));
+}
+
+std::string TSimulatedModbusPort::GetDescription(bool verbose) const
+{
+    return Description;
+}
+
+microseconds TSimulatedModbusPort::GetBusyTime() const
+{
+    return BusyTime;
+}
+
+TPollSimulator::TPollSimulator(const TPollSimulatorSettings& settings): Settings(settings)
+{}
+
+TPortFactoryFn TPollSimulator::GetPortFactory()
+{
+    return [this](const Json::Value& portData, PRPCConfig rpcConfig) -> std::pair<PPort, bool> {
+        auto portType = portData.get("port_type", "serial").asString();
+        if (portType == "serial") {
+            TSerialPortConnectionSettings settings;
+            if (portData.isMember("baud_rate")) {
+                settings.BaudRate = portData["baud_rate"].asInt();
+            }
+            if (portData.isMember("parity")) {
+                settings.Parity = portData["parity"].asCString()[0];
+            }
+            if (portData.isMember("data_bits")) {
+                settings.DataBits = portData["data_bits"].asInt();
+            }
+            if (portData.isMember("stop_bits")) {
+                settings.StopBits = portData["stop_bits"].asInt();
+            }
+            if (Settings.BaudRate) {
+                settings.BaudRate = *Settings.BaudRate;
+            }
+            std::stringstream description;
+            description << portData["path"].asString() << " " << settings.BaudRate << " " << settings.DataBits
+                        << settings.Parity << settings.StopBits;
+            return {std::make_shared<TSimulatedModbusPort>(description.str(),
+                                                           settings,
+                                                           false,
+                                                           Settings.ResponseLatency,
+                                                           Clock),
+                    false};
+        }
+        if (portType == "tcp" || portType == "modbus tcp") {
+            auto description = portData["address"].asString() + ":" + std::to_string(portData["port"].asInt());
+            bool modbusTcp = (portType == "modbus tcp");
+            return {std::make_shared<TSimulatedModbusPort>(description,
+                                                           std::nullopt,
+                                                           modbusTcp,
+                                                           Settings.ResponseLatency,
+                                                           Clock),
+                    modbusTcp};
+        }
+        throw TConfigParserException("invalid port_type: '" + portType + "'");
+    };
+}
+
+void TPollSimulator::Run(PHandlerConfig config, std::ostream& out)
+{
+    for (const auto& portConfig: config->PortConfigs) {
+        RunPort(config, portConfig, out);
+    }
+}
+
+void TPollSimulator::RunPort(PHandlerConfig config, PPortConfig portConfig, std::ostream& out)
+{
+    auto port = std::dynamic_pointer_cast<TSimulatedModbusPort>(portConfig->Port);
+    if (!port) {
+        throw std::runtime_error("port is not simulated: " + portConfig->Port->GetDescription());
+    }
+
+    std::list<PRegister> regList;
+    for (const auto& device: portConfig->Devices) {
+        for (const auto& channelConfig: device->DeviceConfig()->DeviceChannelConfigs) {
+            for (const auto& regConfig: channelConfig->RegisterConfigs) {
+                regList.push_back(TRegister::Intern(device, regConfig));
+            }
+        }
+    }
+
+    auto busLoad = CalculateBusLoad(regList, portConfig->ClientSettings);
+    if (portConfig->ClientSettings.StretchLowPriorityRateLimits &&
+        StretchLowPriorityRateLimits(regList, busLoad) != 1)
+    {
+        busLoad = CalculateBusLoad(regList, portConfig->ClientSettings);
+    }
+
+    out << "Port " << port->GetDescription() << ", " << duration_cast<seconds>(Settings.Duration).count()
+        << " s simulated" << std::endl
+        << std::fixed << std::setprecision(1) << "  Estimated load: high priority "
+        << busLoad.Total.HighPriority * 100 << "%, low priority " << busLoad.Total.LowPriority * 100
+        << "%, low priority cycle " << ToMs(busLoad.Total.LowPriorityCycleTime) << " ms" << std::endl;
+
+    std::unordered_map<PRegister, TRegisterStat> stats;
+    auto callback = [&](PRegister reg) {
+        auto& stat = stats[reg];
+        if (reg->GetErrorState().test(TRegister::TError::ReadError)) {
+            ++stat.Errors;
+            return;
+        }
+        auto now = Clock.Now();
+        if (stat.Reads != 0) {
+            auto period = duration_cast<microseconds>(now - stat.LastRead);
+            stat.PeriodSum += period.count();
+            stat.PeriodSquareSum += double(period.count()) * period.count();
+            stat.MaxPeriod = std::max(stat.MaxPeriod, period);
+        }
+        stat.LastRead = now;
+        ++stat.Reads;
+    };
+
+    const auto startTime = Clock.Now();
+    const auto endTime = startTime + Settings.Duration;
+    const auto busyTimeAtStart = port->GetBusyTime();
+    TSerialClientRegisterAndEventsReader reader(regList,
+                                                GetReadEventsPeriod(*port),
+                                                [this]() { return Clock.Now(); },
+                                                GetLowPriorityRegistersRateLimit(*config, *portConfig),
+                                                portConfig->ClientSettings);
+    TSerialClientDeviceAccessHandler lastAccessedDevice(reader.GetEventsReader());
+    while (Clock.Now() < endTime) {
+        Clock.AdvanceTo(std::min(reader.GetDeadline(Clock.Now()), endTime));
+        auto cycleStart = Clock.Now();
+        reader.OpenPortCycle(*port, callback, lastAccessedDevice);
+        if (Clock.Now() == cycleStart) {
+            Clock.Advance(MIN_CYCLE_TIME);
+        }
+    }
+
+    auto busyTime = port->GetBusyTime() - busyTimeAtStart;
+    out << "  Bus utilisation: " << 100.0 * busyTime.count() / duration_cast<microseconds>(endTime - startTime).count()
+        << "%" << std::endl;
+    out << "  " << std::left << std::setw(40) << "Register" << std::right << std::setw(10) << "Target ms"
+        << std::setw(10) << "Reads" << std::setw(10) << "Avg ms" << std::setw(11) << "Jitter ms" << std::setw(11)
+        << "Max ms" << std::setw(8) << "Errors" << std::endl;
+    for (const auto& reg: regList) {
+        auto& stat = stats[reg];
+        auto target = GetTargetPeriod(reg);
+        if (stat.Reads != 0) {
+            stat.MaxPeriod = std::max(stat.MaxPeriod, duration_cast<microseconds>(endTime - stat.LastRead));
+        }
+        out << "  " << std::left << std::setw(40) << reg->ToString() << std::right << std::setw(10);
+        if (target) {
+            out << target->count();
+        } else {
+            out << "-";
+        }
+        out << std::setw(10) << stat.Reads;
+        double avg = 0;
+        double jitter = 0;
+        if (stat.Reads > 1) {
+            auto n = stat.Reads - 1;
+            avg = stat.PeriodSum / n;
+            jitter = std::sqrt(std::max(0.0, stat.PeriodSquareSum / n - avg * avg));
+        }
+        out << std::setw(10) << avg / 1000 << std::setw(11) << jitter / 1000 << std::setw(11)
+            << ToMs(stat.MaxPeriod) << std::setw(8) << stat.Errors;
+
+        auto starvationInterval = std::max(duration_cast<microseconds>(MIN_STARVATION_INTERVAL),
+                                           duration_cast<microseconds>(target.value_or(0ms) * 2));
+        if (stat.Reads == 0 || stat.MaxPeriod > starvationInterval) {
+            out << "  starved";
+        } else if (target && avg > MISSED_PERIOD_FACTOR * duration_cast<microseconds>(*target).count()) {
+            out << "  missed";
+        }
+        out << std::endl;
+    }
+    out << std::endl;
+}
+
+bool SimulatePolling(const std::string& appName,
+                     const char* options,
+                     std::function<PHandlerConfig(TPortFactoryFn)> loadConfig)
+{
+    if (strncmp(options, "help", 4) == 0) {
+        PrintSimulationOptionsUsage(appName);
+        return true;
+    }
+
+    TPollSimulatorSettings settings;
+    try {
+        settings = ParseSimulationOptions(options);
+    } catch (const std::exception& e) {
+        LOG(Error) << e.what();
+        PrintSimulationOptionsUsage(appName);
+        return false;
+    }
+
+    try {
+        TPollSimulator simulator(settings);
+        simulator.Run(loadConfig(simulator.GetPortFactory()), std::cout);
+    } catch (const std::exception& e) {
+        LOG(Error) << e.what();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "port.h"
+#include "serial_config.h"
+#include "serial_port_settings.h"
+
+//! Time source for simulation. Time is changed only by simulated ports and idle waiting
+class TVirtualClock
+{
+    std::chrono::steady_clock::time_point Time;
+
+public:
+    TVirtualClock();
+
+    std::chrono::steady_clock::time_point Now() const;
+    void Advance(std::chrono::microseconds delta);
+    void AdvanceTo(std::chrono::steady_clock::time_point time);
+};
+
+/**
+ * @brief Port with Modbus RTU or Modbus TCP slaves answering every read and write request.
+ *        Data exchange takes time of the virtual clock according to port's speed and response latency.
+ *        Modbus TCP slaves process several requests in flight simultaneously.
+ */
+class TSimulatedModbusPort: public TPort
+{
+public:
+    TSimulatedModbusPort(const std::string& description,
+                         std::optional<TSerialPortConnectionSettings> serialSettings,
+                         bool modbusTcp,
+                         std::chrono::microseconds responseLatency,
+                         TVirtualClock& clock);
+
+    void Open() override;
+    void Close() override;
+    bool IsOpen() const override;
+    void CheckPortOpen() const override;
+
+    void WriteBytes(const uint8_t* buf, int count) override;
+    uint8_t ReadByte(const std::chrono::microseconds& timeout) override;
+    TReadFrameResult ReadFrame(uint8_t* buf,
+                               size_t count,
+                               const std::chrono::microseconds& responseTimeout,
+                               const std::chrono::microseconds& frameTimeout,
+                               TFrameCompletePred frameComplete = 0) override;
+    void SkipNoise() override;
+    void SleepSinceLastInteraction(const std::chrono::microseconds& us) override;
+
+    std::chrono::microseconds GetSendTimeBytes(double bytesNumber) const override;
+    std::chrono::microseconds GetSendTimeBits(size_t bitsNumber) const override;
+
+    std::string GetDescription(bool verbose = true) const override;
+
+    //! Time when the bus was occupied by requests, responses, waiting for responses and delays
+    std::chrono::microseconds GetBusyTime() const;
+
+private:
+    std::string Description;
+    std::optional<TSerialPortConnectionSettings> SerialSettings;
+    bool ModbusTcp;
+    std::chrono::microseconds ResponseLatency;
+    TVirtualClock& Clock;
+    struct TPendingResponse
+    {
+        std::chrono::steady_clock::time_point ReadyTime;
+        std::vector<uint8_t> Data;
+    };
+
+    std::deque<TPendingResponse> PendingResponses;
+    std::vector<uint8_t> Response;
+    size_t ResponsePos = 0;
+    std::chrono::steady_clock::time_point LastInteraction;
+    std::chrono::microseconds BusyTime = std::chrono::microseconds::zero();
+
+    void Spend(std::chrono::microseconds time);
+};
+
+struct TPollSimulatorSettings
+{
+    std::chrono::milliseconds Duration = std::chrono::hours(1);
+    std::chrono::microseconds ResponseLatency = std::chrono::milliseconds(5);
+
+    //! Overrides baud rate of serial ports if set
+    std::optional<int> BaudRate;
+};
+
+/**
+ * @brief Runs real register scheduler with simulated devices on a virtual clock as fast as possible
+ *        and prints achieved read periods of registers and bus utilisation of ports.
+ */
+class TPollSimulator
+{
+public:
+    TPollSimulator(const TPollSimulatorSettings& settings);
+
+    //! Port factory for LoadConfig creating simulated ports
+    TPortFactoryFn GetPortFactory();
+
+    void Run(PHandlerConfig config, std::ostream& out);
+
+private:
+    struct TRegisterStat
+    {
+        size_t Reads = 0;
+        size_t Errors = 0;
+        std::chrono::steady_clock::time_point LastRead;
+        double PeriodSum = 0;
+        double PeriodSquareSum = 0;
+        std::chrono::microseconds MaxPeriod = std::chrono::microseconds::zero();
+    };
+
+    TPollSimulatorSettings Settings;
+    TVirtualClock Clock;
+
+    void RunPort(PHandlerConfig config, PPortConfig portConfig, std::ostream& out);
+};
+
+/**
+ * @brief Parse simulation command line options and run simulation
+ *
+ * @param appName - application name
+ * @param options - comma separated command line options
+ * @param loadConfig - function loading config with given port factory
+ * @return false if options are invalid or simulation has failed
+ */
+bool SimulatePolling(const std::string& appName,
+                     const char* options,
+                     std::function<PHandlerConfig(TPortFactoryFn)> loadConfig);
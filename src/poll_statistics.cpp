@@ -0,0 +1,118 @@
+#include "poll_statistics.h"
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+namespace
+{
+    double ToMs(microseconds time)
+    {
+        return duration_cast<duration<double, std::milli>>(time).count();
+    }
+}
+
+void TPollStatistics::TClassLatency::Add(const TClassLatency& other)
+{
+    Reads += other.Reads;
+    Total += other.Total;
+    Max = std::max(Max, other.Max);
+}
+
+void TPollStatistics::AddReadLatency(TRegisterConfig::EPollClass pollClass, microseconds latency)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto& item = Classes.at(static_cast<size_t>(pollClass));
+    ++item.Reads;
+    item.Total += latency;
+    item.Max = std::max(item.Max, latency);
+}
+
+void TPollStatistics::AddDisconnectedDeviceProbe(microseconds savedTime)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    ++DisconnectedDeviceProbes;
+    SavedBusTime += savedTime;
+}
+
+void TPollStatistics::AddWriteLatency(microseconds latency)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    ++Writes.Reads;
+    Writes.Total += latency;
+    Writes.Max = std::max(Writes.Max, latency);
+    auto bucket = std::lower_bound(WRITE_LATENCY_BUCKETS_MS.begin(),
+                                   WRITE_LATENCY_BUCKETS_MS.end(),
+                                   ceil<milliseconds>(latency).count());
+    ++WriteLatencyHistogram[bucket - WRITE_LATENCY_BUCKETS_MS.begin()];
+}
+
+void TPollStatistics::AddEventsRead(milliseconds period, bool hasEvents, microseconds latency)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    ++EventsReads;
+    EventsPeriod = period;
+    if (hasEvents) {
+        ++Events.Reads;
+        Events.Total += latency;
+        Events.Max = std::max(Events.Max, latency);
+    }
+}
+
+void TPollStatistics::Add(const TPollStatistics& other)
+{
+    std::scoped_lock lock(Mutex, other.Mutex);
+    for (size_t i = 0; i < Classes.size(); ++i) {
+        Classes[i].Add(other.Classes[i]);
+    }
+    Writes.Add(other.Writes);
+    for (size_t i = 0; i < WriteLatencyHistogram.size(); ++i) {
+        WriteLatencyHistogram[i] += other.WriteLatencyHistogram[i];
+    }
+    EventsReads += other.EventsReads;
+    Events.Add(other.Events);
+    EventsPeriod = std::max(EventsPeriod, other.EventsPeriod);
+    DisconnectedDeviceProbes += other.DisconnectedDeviceProbes;
+    SavedBusTime += other.SavedBusTime;
+}
+
+Json::Value TPollStatistics::ToJson() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Json::Value res;
+    Json::Value& latency = res["poll_latency"];
+    latency = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < Classes.size(); ++i) {
+        const auto& item = Classes[i];
+        Json::Value cls;
+        cls["class"] = GetPollClassName(static_cast<TRegisterConfig::EPollClass>(i));
+        cls["reads"] = Json::UInt64(item.Reads);
+        cls["avg_latency_ms"] = item.Reads ? ToMs(item.Total) / item.Reads : 0.0;
+        cls["max_latency_ms"] = ToMs(item.Max);
+        latency.append(cls);
+    }
+    Json::Value& writes = res["write_latency"];
+    writes["writes"] = Json::UInt64(Writes.Reads);
+    writes["avg_latency_ms"] = Writes.Reads ? ToMs(Writes.Total) / Writes.Reads : 0.0;
+    writes["max_latency_ms"] = ToMs(Writes.Max);
+    Json::Value& histogram = writes["histogram"];
+    histogram = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < WriteLatencyHistogram.size(); ++i) {
+        Json::Value bucket;
+        // The last bucket has no upper bound
+        bucket["le_ms"] = (i < WRITE_LATENCY_BUCKETS_MS.size()) ? Json::Value(WRITE_LATENCY_BUCKETS_MS[i])
+                                                                 : Json::Value(Json::nullValue);
+        bucket["writes"] = Json::UInt64(WriteLatencyHistogram[i]);
+        histogram.append(bucket);
+    }
+    Json::Value& events = res["events"];
+    events["reads"] = Json::UInt64(EventsReads);
+    events["reads_with_events"] = Json::UInt64(Events.Reads);
+    events["period_ms"] = Json::Int64(EventsPeriod.count());
+    events["avg_latency_ms"] = Events.Reads ? ToMs(Events.Total) / Events.Reads : 0.0;
+    events["max_latency_ms"] = ToMs(Events.Max);
+    Json::Value& probes = res["disconnected_devices"];
+    probes["probes"] = Json::UInt64(DisconnectedDeviceProbes);
+    probes["saved_bus_time_ms"] = ToMs(SavedBusTime);
+    return res;
+}
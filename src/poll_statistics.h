@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include <wblib/json/json.h>
+
+#include "register.h"
+
+/**
+ * @brief Port polling statistics. It is updated by port's thread and can be read from other threads.
+ *        Read latency is time from the moment registers are scheduled to be read to the actual read.
+ *        Write latency is time from the moment a value is received from MQTT to its successful write.
+ */
+class TPollStatistics
+{
+public:
+    void AddReadLatency(TRegisterConfig::EPollClass pollClass, std::chrono::microseconds latency);
+
+    /**
+     * @brief Register a probe of a disconnected device
+     *
+     * @param savedTime - estimated bus time which would be spent on reading all device's registers instead
+     */
+    void AddDisconnectedDeviceProbe(std::chrono::microseconds savedTime);
+
+    void AddWriteLatency(std::chrono::microseconds latency);
+
+    /**
+     * @brief Register events reading
+     *
+     * @param period - current events reading period
+     * @param hasEvents - events are received
+     * @param latency - time since previous events reading, it is the longest possible delay of received events
+     */
+    void AddEventsRead(std::chrono::milliseconds period, bool hasEvents, std::chrono::microseconds latency);
+
+    //! Adds statistics of other connection of the same port. Events period is the longest of connections
+    void Add(const TPollStatistics& other);
+
+    Json::Value ToJson() const;
+
+private:
+    struct TClassLatency
+    {
+        size_t Reads = 0;
+        std::chrono::microseconds Total = std::chrono::microseconds::zero();
+        std::chrono::microseconds Max = std::chrono::microseconds::zero();
+
+        void Add(const TClassLatency& other);
+    };
+
+    mutable std::mutex Mutex;
+    std::array<TClassLatency, POLL_CLASS_COUNT> Classes;
+    //! Upper bounds of write latency histogram buckets, the last bucket counts longer writes
+    static constexpr std::array<int, 9> WRITE_LATENCY_BUCKETS_MS{10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+
+    TClassLatency Writes;
+    std::array<size_t, WRITE_LATENCY_BUCKETS_MS.size() + 1> WriteLatencyHistogram{};
+    size_t EventsReads = 0;
+    TClassLatency Events;
+    std::chrono::milliseconds EventsPeriod = std::chrono::milliseconds::zero();
+    size_t DisconnectedDeviceProbes = 0;
+    std::chrono::microseconds SavedBusTime = std::chrono::microseconds::zero();
+};
+
+typedef std::shared_ptr<TPollStatistics> PPollStatistics;
@@ -19,6 +19,11 @@ void TPort::WriteBytes(const std::string& buf)
     WriteBytes(reinterpret_cast<const uint8_t*>(buf.c_str()), buf.size());
 }
 
+bool TPort::SleepSinceLastInteractionOrWakeup(const std::chrono::microseconds& us, int wakeupFd)
+{
+    return true;
+}
+
 std::chrono::microseconds TPort::GetSendTimeBytes(double bytesNumber) const
 {
     return std::chrono::microseconds::zero();
@@ -46,11 +51,15 @@ void TPortOpenCloseLogic::OpenIfAllowed(PPort port)
         return;
     }
 
-    auto currentTime = NowFn();
-    if (NextOpenTryTime > currentTime) {
+    if (NextOpenTryTime > NowFn()) {
         return;
     }
+    Open(port);
+}
 
+void TPortOpenCloseLogic::Open(PPort port)
+{
+    auto currentTime = NowFn();
     try {
         port->Open();
     } catch (...) {
@@ -62,6 +62,14 @@ public:
 
     virtual void SleepSinceLastInteraction(const std::chrono::microseconds& us) = 0;
 
+    /**
+     * @brief Sleep like SleepSinceLastInteraction, but wake up earlier if wakeupFd becomes readable.
+     *        Ports without descriptors don't sleep here, SleepSinceLastInteraction before a request keeps the interval
+     *
+     * @return false if the sleep is cut short
+     */
+    virtual bool SleepSinceLastInteractionOrWakeup(const std::chrono::microseconds& us, int wakeupFd);
+
     /**
      * @brief Calculate sending time for bytesNumber bytes
      *
@@ -106,6 +114,9 @@ public:
     TPortOpenCloseLogic(const TPortOpenCloseLogic::TSettings& settings, util::TGetNowFn nowFn);
 
     void OpenIfAllowed(PPort port);
+
+    //! Open the port without waiting for ReopenTimeout since the last failed attempt
+    void Open(PPort port);
     void CloseIfNeeded(PPort port, bool allPreviousDataExchangeWasFailed);
 
 private:
@@ -0,0 +1,34 @@
+#include "read_events_period.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std::chrono;
+
+namespace
+{
+    // Events usually come in bursts, so the period is decreased fast and increased slowly
+    const double HIT_WEIGHT = 0.5;
+    const double MISS_WEIGHT = 0.1;
+}
+
+TReadEventsPeriod::TReadEventsPeriod(milliseconds minPeriod, milliseconds maxPeriod)
+    : MinPeriod(minPeriod),
+      MaxPeriod(std::max(minPeriod, maxPeriod)),
+      HitRate(1)
+{}
+
+void TReadEventsPeriod::Update(bool hasEvents)
+{
+    if (hasEvents) {
+        HitRate += (1 - HitRate) * HIT_WEIGHT;
+    } else {
+        HitRate -= HitRate * MISS_WEIGHT;
+    }
+}
+
+milliseconds TReadEventsPeriod::Get() const
+{
+    auto range = (MaxPeriod - MinPeriod).count();
+    return MinPeriod + milliseconds(static_cast<milliseconds::rep>(std::lround(range * (1 - HitRate))));
+}
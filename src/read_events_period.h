@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+
+/**
+ * @brief Period of events reading adapted to the rate of events.
+ *        The period is decreased to minimum while devices report events and slowly grows to maximum on a quiet bus.
+ */
+class TReadEventsPeriod
+{
+public:
+    /**
+     * @param minPeriod - period while every events reading returns events
+     * @param maxPeriod - period while there are no events, if it is less than minPeriod the period is fixed
+     */
+    TReadEventsPeriod(std::chrono::milliseconds minPeriod, std::chrono::milliseconds maxPeriod);
+
+    //! Updates hit rate after events reading
+    void Update(bool hasEvents);
+
+    std::chrono::milliseconds Get() const;
+
+private:
+    std::chrono::milliseconds MinPeriod;
+    std::chrono::milliseconds MaxPeriod;
+
+    //! Exponentially weighted share of events readings returned events
+    double HitRate;
+};
@@ -0,0 +1,272 @@
+#include "read_plan.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include "log.h"
+#include "serial_device.h"
+
+#define LOG(logger) logger.Log() << "[read plan] "
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+namespace
+{
+    // Planned ranges should fit serial client's maximum poll time
+    const auto MAX_ENTRY_POLL_TIME = 100ms;
+
+    //! Registers which values may be reported by events have their own entries,
+    //! so they are polled with events safety period or as usual without rebuilding of the plan
+    bool MayBeReportedByEvents(const TRegister& reg)
+    {
+        return reg.SporadicMode != TRegisterConfig::TSporadicMode::DISABLED || reg.IsExcludedFromPolling();
+    }
+}
+
+bool TRegisterComparePredicate::operator()(const PRegister& r1, const PRegister& r2) const
+{
+    if (r1->Device() != r2->Device()) {
+        return r1->Device()->DeviceConfig()->SlaveId > r2->Device()->DeviceConfig()->SlaveId;
+    }
+    if (r1->Type != r2->Type) {
+        return r1->Type > r2->Type;
+    }
+    auto cmp = r1->GetAddress().Compare(r2->GetAddress());
+    if (cmp < 0) {
+        return false;
+    }
+    if (cmp > 0) {
+        return true;
+    }
+    // addresses are equal, compare offsets
+    return r1->GetDataOffset() > r2->GetDataOffset();
+}
+
+bool TReadPlanEntryComparePredicate::operator()(const PReadPlanEntry& e1, const PReadPlanEntry& e2) const
+{
+    return TRegisterComparePredicate()(e1->Registers.front(), e2->Registers.front());
+}
+
+std::ostream& operator<<(std::ostream& os, const TReadPlanEntry& entry)
+{
+    os << entry.Registers.front()->ToString();
+    if (entry.Registers.size() > 1) {
+        os << " - " << entry.Registers.back()->ToString() << " (" << entry.Registers.size() << " registers)";
+    }
+    return os;
+}
+
+bool TReadPlan::TDeviceLimits::operator==(const TDeviceLimits& other) const
+{
+    return SupportsHoles == other.SupportsHoles && MaxRegHole == other.MaxRegHole && MaxBitHole == other.MaxBitHole &&
+           MaxReadRegisters == other.MaxReadRegisters;
+}
+
+TReadPlan::TReadPlan(bool mergeRegisters, milliseconds maxEntryPollTime)
+    : MergeRegisters(mergeRegisters),
+      MaxEntryPollTime(maxEntryPollTime)
+{}
+
+TReadPlan::TReadPlan(const TSerialClientSettings& settings)
+    : TReadPlan(settings.UseReadPlan,
+                (settings.WriteLatencyTarget != milliseconds::zero())
+                    ? std::min(MAX_ENTRY_POLL_TIME, settings.WriteLatencyTarget)
+                    : MAX_ENTRY_POLL_TIME)
+{}
+
+void TReadPlan::Build(const std::list<PRegister>& regList)
+{
+    Devices.clear();
+    DevicePlans.clear();
+    for (const auto& reg: regList) {
+        if (reg->AccessType == TRegisterConfig::EAccessType::WRITE_ONLY) {
+            continue;
+        }
+        auto device = reg->Device();
+        auto res = DevicePlans.emplace(device, TDevicePlan());
+        if (res.second) {
+            Devices.push_back(device);
+        }
+        res.first->second.Registers.push_back(reg);
+    }
+    for (const auto& device: Devices) {
+        BuildDevicePlan(device, DevicePlans[device]);
+    }
+}
+
+void TReadPlan::Rebuild(PSerialDevice device)
+{
+    auto it = DevicePlans.find(device);
+    if (it != DevicePlans.end()) {
+        BuildDevicePlan(device, it->second);
+    }
+}
+
+bool TReadPlan::NeedsRebuild(const TReadPlanEntry& entry) const
+{
+    if (!MergeRegisters) {
+        return false;
+    }
+    if (entry.Outdated) {
+        return true;
+    }
+    auto it = DevicePlans.find(entry.Device);
+    if (it == DevicePlans.end() || !(it->second.Limits == GetDeviceLimits(*entry.Device))) {
+        return true;
+    }
+    for (size_t i = 0; i < entry.Registers.size(); ++i) {
+        const auto& reg = entry.Registers[i];
+        if (reg->GetAvailable() == entry.Availability[i]) {
+            continue;
+        }
+        // Own entries of registers with events are changed only if registers become unavailable
+        if (entry.Registers.size() == 1 && MayBeReportedByEvents(*reg) &&
+            reg->GetAvailable() != TRegisterAvailability::UNAVAILABLE)
+        {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+const std::vector<PSerialDevice>& TReadPlan::GetDevices() const
+{
+    return Devices;
+}
+
+const std::vector<PReadPlanEntry>& TReadPlan::GetEntries(PSerialDevice device) const
+{
+    static const std::vector<PReadPlanEntry> empty;
+    auto it = DevicePlans.find(device);
+    return (it != DevicePlans.end()) ? it->second.Entries : empty;
+}
+
+bool TReadPlan::IsMerging() const
+{
+    return MergeRegisters;
+}
+
+TReadPlan::TDeviceLimits TReadPlan::GetDeviceLimits(const TSerialDevice& device)
+{
+    const auto& config = *device.DeviceConfig();
+    return TDeviceLimits{device.GetSupportsHoles(), config.MaxRegHole, config.MaxBitHole, config.MaxReadRegisters};
+}
+
+void TReadPlan::BuildDevicePlan(PSerialDevice device, TDevicePlan& plan)
+{
+    plan.Limits = GetDeviceLimits(*device);
+    plan.Entries.clear();
+
+    auto addRegisterEntry = [&](const PRegister& reg) {
+        auto entry = std::make_shared<TReadPlanEntry>();
+        entry->Device = device;
+        entry->Registers.push_back(reg);
+        entry->Priority = reg->IsHighPriority() ? TPriority::High : TPriority::Low;
+        entry->PollClass = reg->PollClass;
+        auto range = device->CreateRegisterRange();
+        range->Add(reg, milliseconds::max());
+        entry->PollTime = range->GetPollTime();
+        plan.Entries.push_back(entry);
+    };
+
+    if (!MergeRegisters) {
+        for (const auto& reg: plan.Registers) {
+            addRegisterEntry(reg);
+        }
+        return;
+    }
+
+    // Registers with same priority, period and poll class, key is priority, period or -1 if period is not set
+    // and poll class
+    std::map<std::tuple<TPriority, int64_t, TRegisterConfig::EPollClass>, std::vector<PRegister>> groups;
+    std::vector<PRegister> eventRegisters;
+    for (const auto& reg: plan.Registers) {
+        if (reg->GetAvailable() == TRegisterAvailability::UNAVAILABLE) {
+            continue;
+        }
+        if (MayBeReportedByEvents(*reg)) {
+            eventRegisters.push_back(reg);
+            continue;
+        }
+        if (reg->IsHighPriority()) {
+            groups[{TPriority::High, reg->ReadPeriod->count(), reg->PollClass}].push_back(reg);
+        } else {
+            groups[{TPriority::Low, reg->ReadRateLimit ? reg->ReadRateLimit->count() : -1, reg->PollClass}].push_back(
+                reg);
+        }
+    }
+
+    for (auto& group: groups) {
+        auto& regs = group.second;
+        std::sort(regs.begin(), regs.end(), [](const PRegister& r1, const PRegister& r2) {
+            return TRegisterComparePredicate()(r2, r1);
+        });
+        PRegisterRange range;
+        PReadPlanEntry entry;
+        for (const auto& reg: regs) {
+            if (entry && range->Add(reg, MaxEntryPollTime)) {
+                entry->Registers.push_back(reg);
+                entry->PollTime = range->GetPollTime();
+                continue;
+            }
+            if (entry) {
+                plan.Entries.push_back(entry);
+            }
+            range = device->CreateRegisterRange();
+            if (!range->Add(reg, MaxEntryPollTime)) {
+                range->Add(reg, milliseconds::max());
+            }
+            entry = std::make_shared<TReadPlanEntry>();
+            entry->Device = device;
+            entry->Registers.push_back(reg);
+            entry->Priority = std::get<0>(group.first);
+            entry->PollClass = std::get<2>(group.first);
+            entry->PollTime = range->GetPollTime();
+        }
+        if (entry) {
+            plan.Entries.push_back(entry);
+        }
+    }
+
+    for (const auto& reg: eventRegisters) {
+        addRegisterEntry(reg);
+    }
+
+    for (auto& entry: plan.Entries) {
+        for (const auto& reg: entry->Registers) {
+            entry->Availability.push_back(reg->GetAvailable());
+        }
+        if (Debug.IsEnabled()) {
+            LOG(Debug) << device->ToString() << ": " << *entry;
+        }
+    }
+}
+
+void SpreadReadPeriodPhases(const TReadPlan& plan, steady_clock::time_point startTime)
+{
+    // Entries of a device with the same read period form a phase group
+    std::map<milliseconds, std::vector<std::vector<PReadPlanEntry>>> groups;
+    for (const auto& device: plan.GetDevices()) {
+        std::map<milliseconds, std::vector<PReadPlanEntry>> deviceGroups;
+        for (const auto& entry: plan.GetEntries(device)) {
+            if (entry->Priority == TPriority::High) {
+                deviceGroups[*entry->Registers.front()->ReadPeriod].push_back(entry);
+            }
+        }
+        for (auto& group: deviceGroups) {
+            groups[group.first].push_back(std::move(group.second));
+        }
+    }
+    for (const auto& periodGroups: groups) {
+        const auto period = duration_cast<microseconds>(periodGroups.first);
+        const auto count = periodGroups.second.size();
+        for (size_t i = 0; i < count; ++i) {
+            for (const auto& entry: periodGroups.second[i]) {
+                entry->Deadline = startTime + period * i / count;
+            }
+        }
+    }
+}
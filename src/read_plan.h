@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "poll_plan.h"
+#include "register.h"
+#include "serial_client_settings.h"
+
+class TSerialDevice;
+typedef std::shared_ptr<TSerialDevice> PSerialDevice;
+
+struct TRegisterComparePredicate
+{
+    bool operator()(const PRegister& r1, const PRegister& r2) const;
+};
+
+/**
+ * @brief Registers of a device, which are read by one request.
+ *        All registers of an entry have the same priority, poll class and read period.
+ *        The entry keeps its position in the scheduler.
+ */
+struct TReadPlanEntry: public TScheduleEntryState
+{
+    PSerialDevice Device;
+    std::vector<PRegister> Registers;
+    TPriority Priority;
+    TRegisterConfig::EPollClass PollClass = TRegisterConfig::EPollClass::NORMAL;
+
+    //! Deadline the entry is scheduled for
+    std::chrono::steady_clock::time_point Deadline;
+
+    //! Registers availability at the moment the entry was built
+    std::vector<TRegisterAvailability> Availability;
+
+    //! The entry can't be read in planned poll time and must be split
+    bool Outdated = false;
+
+    //! The device rejected read of the entry with a write, so it isn't read with writes anymore
+    bool WriteAndReadRejected = false;
+
+    //! Index of the first register to read, if the entry is read by parts while writes are waiting
+    size_t FirstUnreadRegister = 0;
+
+    //! Estimated time of reading the entry, zero if unknown
+    std::chrono::microseconds PollTime = std::chrono::microseconds::zero();
+};
+
+typedef std::shared_ptr<TReadPlanEntry> PReadPlanEntry;
+
+struct TReadPlanEntryComparePredicate
+{
+    bool operator()(const PReadPlanEntry& e1, const PReadPlanEntry& e2) const;
+};
+
+std::ostream& operator<<(std::ostream& os, const TReadPlanEntry& entry);
+
+/**
+ * @brief Precomputed grouping of registers into read requests.
+ *        Without merging every register has its own entry, so registers are grouped during polling.
+ *        With merging registers of a device are grouped into maximal ranges at startup.
+ *        Device's entries must be rebuilt if registers availability, holes support or read limits are changed.
+ */
+class TReadPlan
+{
+public:
+    TReadPlan(bool mergeRegisters, std::chrono::milliseconds maxEntryPollTime);
+
+    //! Plan of a port's serial client, merging and maximum entry poll time are taken from the settings
+    explicit TReadPlan(const TSerialClientSettings& settings);
+
+    void Build(const std::list<PRegister>& regList);
+    void Rebuild(PSerialDevice device);
+
+    bool NeedsRebuild(const TReadPlanEntry& entry) const;
+
+    const std::vector<PSerialDevice>& GetDevices() const;
+    const std::vector<PReadPlanEntry>& GetEntries(PSerialDevice device) const;
+
+    bool IsMerging() const;
+
+private:
+    struct TDeviceLimits
+    {
+        bool SupportsHoles;
+        int MaxRegHole;
+        int MaxBitHole;
+        int MaxReadRegisters;
+
+        bool operator==(const TDeviceLimits& other) const;
+    };
+
+    struct TDevicePlan
+    {
+        std::vector<PRegister> Registers;
+        std::vector<PReadPlanEntry> Entries;
+        TDeviceLimits Limits;
+    };
+
+    bool MergeRegisters;
+    std::chrono::milliseconds MaxEntryPollTime;
+    std::vector<PSerialDevice> Devices;
+    std::unordered_map<PSerialDevice, TDevicePlan> DevicePlans;
+
+    static TDeviceLimits GetDeviceLimits(const TSerialDevice& device);
+
+    void BuildDevicePlan(PSerialDevice device, TDevicePlan& plan);
+};
+
+/**
+ * @brief Spread initial deadlines of high priority entries with the same read period over the period,
+ *        so they are not read by bursts. Entries of a device with the same period keep the same phase
+ *        and can be still read by one request.
+ */
+void SpreadReadPeriodPhases(const TReadPlan& plan, std::chrono::steady_clock::time_point startTime);
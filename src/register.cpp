@@ -40,16 +40,21 @@ size_t RegisterFormatByteWidth(RegisterFormat format)
     return 2;
 }
 
-const std::list<PRegister>& TRegisterRange::RegisterList() const
+const std::vector<PRegister>& TRegisterRange::RegisterList() const
 {
     return RegList;
 }
 
-std::list<PRegister>& TRegisterRange::RegisterList()
+std::vector<PRegister>& TRegisterRange::RegisterList()
 {
     return RegList;
 }
 
+std::chrono::microseconds TRegisterRange::GetPollTime() const
+{
+    return std::chrono::microseconds::zero();
+}
+
 bool TRegisterRange::HasOtherDeviceAndType(PRegister reg) const
 {
     if (RegisterList().empty()) {
@@ -86,6 +91,18 @@ bool TRegisterConfig::IsHighPriority() const
     return bool(ReadPeriod);
 }
 
+const char* GetPollClassName(TRegisterConfig::EPollClass pollClass)
+{
+    switch (pollClass) {
+        case TRegisterConfig::EPollClass::CRITICAL:
+            return "critical";
+        case TRegisterConfig::EPollClass::BACKGROUND:
+            return "background";
+        default:
+            return "normal";
+    }
+}
+
 const IRegisterAddress& TRegisterConfig::GetAddress() const
 {
     if (AccessType == EAccessType::WRITE_ONLY) {
@@ -215,6 +215,15 @@ public:
     };
     EAccessType AccessType{EAccessType::READ_WRITE};
 
+    //! Class of register's share of bus time, which is left after reading registers with ReadPeriod
+    enum class EPollClass
+    {
+        CRITICAL,
+        NORMAL,
+        BACKGROUND
+    };
+    EPollClass PollClass{EPollClass::NORMAL};
+
     std::string TypeName;
 
     // Minimal interval between register reads, if ReadPeriod is not set
@@ -284,6 +293,11 @@ public:
     const IRegisterAddress& GetWriteAddress() const;
 };
 
+const size_t POLL_CLASS_COUNT = 3;
+
+//! Name of poll class used in config and statistics
+const char* GetPollClassName(TRegisterConfig::EPollClass pollClass);
+
 struct TRegister;
 typedef std::shared_ptr<TRegister> PRegister;
 
@@ -502,16 +516,19 @@ class TRegisterRange
 public:
     virtual ~TRegisterRange() = default;
 
-    const std::list<PRegister>& RegisterList() const;
-    std::list<PRegister>& RegisterList();
+    const std::vector<PRegister>& RegisterList() const;
+    std::vector<PRegister>& RegisterList();
 
     virtual bool Add(PRegister reg, std::chrono::milliseconds pollLimit) = 0;
 
+    //! Estimated time of reading the range, zero if the device doesn't estimate it
+    virtual std::chrono::microseconds GetPollTime() const;
+
 protected:
     bool HasOtherDeviceAndType(PRegister reg) const;
 
 private:
-    std::list<PRegister> RegList;
+    std::vector<PRegister> RegList;
 };
 
 typedef std::shared_ptr<TRegisterRange> PRegisterRange;
@@ -1,6 +1,8 @@
 #include "register_handler.h"
 #include "log.h"
 
+#include <algorithm>
+
 #define LOG(logger) ::logger.Log() << "[register handler] "
 
 using namespace std::chrono;
@@ -28,18 +30,12 @@ void TRegisterHandler::Flush()
             tempValue = ValueToSet;
         }
         Device()->WriteRegister(Reg, tempValue);
-        {
-            std::lock_guard<std::mutex> lock(SetValueMutex);
-            Dirty = (tempValue != ValueToSet);
-            WriteFail = false;
-        }
-        Reg->SetValue(tempValue, false);
-        Reg->ClearError(TRegister::TError::WriteError);
+        SetFlushed(tempValue);
     } catch (const TSerialDevicePermanentRegisterException& e) {
         LOG(Warn) << "failed to write: " << Reg->ToString() << ": " << e.what();
         {
             std::lock_guard<std::mutex> lock(SetValueMutex);
-            Dirty = (tempValue != ValueToSet);
+            SetWritten(tempValue);
             WriteFail = false;
         }
         Reg->SetError(TRegister::TError::WriteError);
@@ -53,7 +49,7 @@ void TRegisterHandler::Flush()
             }
             WriteFail = true;
             if (duration_cast<seconds>(steady_clock::now() - WriteFirstTryTime) > MAX_WRITE_FAIL_TIME) {
-                Dirty = (tempValue != ValueToSet);
+                SetWritten(tempValue);
                 WriteFail = false;
             }
         }
@@ -61,14 +57,50 @@ void TRegisterHandler::Flush()
     }
 }
 
-void TRegisterHandler::SetTextValue(const std::string& v)
+TRegisterValue TRegisterHandler::GetValueToSet()
+{
+    std::lock_guard<std::mutex> lock(SetValueMutex);
+    return ValueToSet;
+}
+
+void TRegisterHandler::SetFlushed(const TRegisterValue& value)
+{
+    {
+        std::lock_guard<std::mutex> lock(SetValueMutex);
+        SetWritten(value);
+        WriteFail = false;
+    }
+    Reg->SetValue(value, false);
+    Reg->ClearError(TRegister::TError::WriteError);
+}
+
+void TRegisterHandler::SetTextValue(const std::string& v, steady_clock::time_point setTime)
 {
     // don't hold the lock while notifying the client below
     std::lock_guard<std::mutex> lock(SetValueMutex);
+    if (!Dirty) {
+        ValueSetTime = setTime;
+    }
+    LastValueSetTime = setTime;
     Dirty = true;
     ValueToSet = ConvertToRawValue(*Reg, v);
 }
 
+void TRegisterHandler::SetWritten(const TRegisterValue& value)
+{
+    Dirty = (value != ValueToSet);
+    // The value has been changed during writing, its latency is counted from its own set time
+    if (Dirty) {
+        ValueSetTime = LastValueSetTime;
+    }
+}
+
+steady_clock::time_point TRegisterHandler::GetValueSetTime()
+{
+    std::lock_guard<std::mutex> lock(SetValueMutex);
+    return ValueSetTime;
+}
+
 PRegister TRegisterHandler::Register() const
 {
     return Reg;
@@ -78,3 +110,34 @@ PSerialDevice TRegisterHandler::Device() const
 {
     return Dev.lock();
 }
+
+bool TRegisterHandlerQueue::Push(TRegisterHandler& handler)
+{
+    if (handler.Queued.exchange(true)) {
+        return false;
+    }
+    auto head = Head.load(std::memory_order_relaxed);
+    do {
+        handler.NextQueued = head;
+    } while (!Head.compare_exchange_weak(head, &handler, std::memory_order_release, std::memory_order_relaxed));
+    return true;
+}
+
+void TRegisterHandlerQueue::PopAll(std::vector<TRegisterHandler*>& handlers)
+{
+    // The whole list is taken at once, so pushing threads never see removed nodes
+    auto handler = Head.exchange(nullptr, std::memory_order_acquire);
+    auto first = handlers.size();
+    while (handler) {
+        auto next = handler->NextQueued;
+        handlers.push_back(handler);
+        handler->Queued.store(false);
+        handler = next;
+    }
+    std::reverse(handlers.begin() + first, handlers.end());
+}
+
+bool TRegisterHandlerQueue::IsEmpty() const
+{
+    return Head.load(std::memory_order_relaxed) == nullptr;
+}
@@ -2,10 +2,12 @@
 #include "bcd_utils.h"
 #include "register.h"
 #include "serial_device.h"
+#include <atomic>
 #include <cmath>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 #include <wblib/utils.h>
 
 using WBMQTT::StringFormat;
@@ -24,10 +26,29 @@ public:
      */
     void Flush();
 
-    void SetTextValue(const std::string& v);
+    //! Value waiting to be written
+    TRegisterValue GetValueToSet();
+
+    //! Marks the value as written, if it is written by other means than Flush
+    void SetFlushed(const TRegisterValue& value);
+
+    /**
+     * @brief Set value to be written
+     *
+     * @param v - value
+     * @param setTime - time of receiving the value, used for write latency calculation
+     */
+    void SetTextValue(const std::string& v, std::chrono::steady_clock::time_point setTime);
+
+    //! Time of receiving the oldest not yet written value
+    std::chrono::steady_clock::time_point GetValueSetTime();
+
     PSerialDevice Device() const;
 
 private:
+    //! Updates Dirty flag after writing of the value. Must be called with locked SetValueMutex
+    void SetWritten(const TRegisterValue& value);
+
     std::weak_ptr<TSerialDevice> Dev;
     TRegisterValue ValueToSet{0};
     PRegister Reg;
@@ -35,6 +56,33 @@ private:
     std::mutex SetValueMutex;
     bool WriteFail;
     std::chrono::steady_clock::time_point WriteFirstTryTime;
+    std::chrono::steady_clock::time_point ValueSetTime;
+    std::chrono::steady_clock::time_point LastValueSetTime;
+
+    std::atomic_bool Queued{false};
+    TRegisterHandler* NextQueued = nullptr;
+
+    friend class TRegisterHandlerQueue;
 };
 
 typedef std::shared_ptr<TRegisterHandler> PRegisterHandler;
+
+/**
+ * @brief Lock-free queue of register handlers with values waiting to be written.
+ *        Handlers can be pushed from any thread, but only one thread can pop them.
+ *        A handler is stored in the queue only once until it is popped.
+ */
+class TRegisterHandlerQueue
+{
+public:
+    //! Returns false if the handler is already in the queue
+    bool Push(TRegisterHandler& handler);
+
+    //! Moves all handlers in order of pushing to the end of the vector
+    void PopAll(std::vector<TRegisterHandler*>& handlers);
+
+    bool IsEmpty() const;
+
+private:
+    std::atomic<TRegisterHandler*> Head{nullptr};
+};
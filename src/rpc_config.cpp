@@ -36,6 +36,16 @@ void TRPCConfig::AddTCPPort(PPort port, const TTcpPortSettings& settings)
     }
 }
 
+void TRPCConfig::AddConnection(PPort port, PPort connection)
+{
+    auto existedPort =
+        std::find_if(Ports.begin(), Ports.end(), [&port](PRPCPort RPCPort) { return port == RPCPort->GetPort(); });
+
+    if (existedPort != Ports.end()) {
+        (*existedPort)->AddConnection(connection);
+    }
+}
+
 std::vector<PRPCPort> TRPCConfig::GetPorts()
 {
     return Ports;
@@ -8,6 +8,9 @@ class TRPCConfig
 public:
     void AddSerialPort(PPort port, const TSerialPortSettings& settings);
     void AddTCPPort(PPort port, const TTcpPortSettings& settings);
+
+    //! Adds other connection of the port's connection pool, so it is available through the port's RPC port
+    void AddConnection(PPort port, PPort connection);
     std::vector<PRPCPort> GetPorts();
     Json::Value GetPortConfigs() const;
 
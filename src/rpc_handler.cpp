@@ -139,13 +139,43 @@ namespace
 
 void TRPCPortDriver::SendRequest(PRPCRequest request) const
 {
-    if (SerialClient) {
-        SerialClient->RPCTransceive(request);
+    // Requests don't address devices, so they are sent through the port's own connection
+    if (!SerialClients.empty()) {
+        SerialClients.front()->RPCTransceive(request);
     } else {
         throw TRPCException("SerialClient wasn't found for requested port", TRPCResultCode::RPC_WRONG_PORT);
     }
 }
 
+Json::Value TRPCPortDriver::GetBusLoad() const
+{
+    if (SerialClients.size() == 1) {
+        return SerialClients.front()->GetBusLoad().ToJson();
+    }
+    // Connections are polled simultaneously, so the port is feasible if every connection is feasible
+    TBusLoadReport report;
+    bool feasible = true;
+    for (const auto& client: SerialClients) {
+        const auto& busLoad = client->GetBusLoad();
+        report.Devices.insert(report.Devices.end(), busLoad.Devices.begin(), busLoad.Devices.end());
+        report.Total.Add(busLoad.Total);
+        feasible = feasible && busLoad.IsFeasible();
+    }
+    auto res = report.ToJson();
+    res["feasible"] = feasible;
+    res["connections"] = Json::UInt64(SerialClients.size());
+    return res;
+}
+
+Json::Value TRPCPortDriver::GetPollStatistics() const
+{
+    TPollStatistics statistics;
+    for (const auto& client: SerialClients) {
+        statistics.Add(*client->GetPollStatistics());
+    }
+    return statistics.ToJson();
+}
+
 TRPCHandler::TRPCHandler(const std::string& requestSchemaFilePath,
                          PRPCConfig rpcConfig,
                          WBMQTT::PMqttRpcServer rpcServer,
@@ -173,11 +203,16 @@ TRPCHandler::TRPCHandler(const std::string& requestSchemaFilePath,
 
         auto findedPortDriver =
             std::find_if(PortDrivers.begin(), PortDrivers.end(), [&port](PRPCPortDriver rpcPortDriver) {
-                return port == rpcPortDriver->RPCPort->GetPort();
+                return rpcPortDriver->RPCPort->HasPort(port);
             });
 
         if (findedPortDriver != PortDrivers.end()) {
-            findedPortDriver->get()->SerialClient = serialPortDriver->GetSerialClient();
+            auto& serialClients = findedPortDriver->get()->SerialClients;
+            if (port == findedPortDriver->get()->RPCPort->GetPort()) {
+                serialClients.insert(serialClients.begin(), serialPortDriver->GetSerialClient());
+            } else {
+                serialClients.push_back(serialPortDriver->GetSerialClient());
+            }
         } else {
             LOG(Warn) << "Can't find RPCPortDriver for " << port->GetDescription() << " port";
         }
@@ -188,6 +223,8 @@ TRPCHandler::TRPCHandler(const std::string& requestSchemaFilePath,
         "Load",
         std::bind(&TRPCHandler::PortLoad, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     rpcServer->RegisterMethod("ports", "Load", std::bind(&TRPCHandler::LoadPorts, this, std::placeholders::_1));
+    rpcServer->RegisterMethod("port", "BusLoad", std::bind(&TRPCHandler::PortBusLoad, this, std::placeholders::_1));
+    rpcServer->RegisterMethod("port", "Stats", std::bind(&TRPCHandler::PortStats, this, std::placeholders::_1));
 }
 
 PRPCPortDriver TRPCHandler::FindPortDriver(const Json::Value& request) const
@@ -218,7 +255,7 @@ void TRPCHandler::PortLoad(const Json::Value& request,
         PRPCRequest rpcRequest = ParseRequest(request, RequestSchema);
         PRPCPortDriver rpcPortDriver = FindPortDriver(request);
 
-        if (rpcPortDriver != nullptr && rpcPortDriver->SerialClient) {
+        if (rpcPortDriver != nullptr && !rpcPortDriver->SerialClients.empty()) {
             rpcRequest->OnResult = [onResult, rpcRequest](const std::vector<uint8_t>& response) {
                 Json::Value replyJSON;
                 replyJSON["response"] = PortLoadResponseFormat(response, rpcRequest->Format);
@@ -256,6 +293,24 @@ Json::Value TRPCHandler::LoadPorts(const Json::Value& request)
     return RPCConfig->GetPortConfigs();
 }
 
+Json::Value TRPCHandler::PortBusLoad(const Json::Value& request)
+{
+    auto rpcPortDriver = FindPortDriver(request);
+    if (!rpcPortDriver || rpcPortDriver->SerialClients.empty()) {
+        throw TRPCException("SerialClient wasn't found for requested port", TRPCResultCode::RPC_WRONG_PORT);
+    }
+    return rpcPortDriver->GetBusLoad();
+}
+
+Json::Value TRPCHandler::PortStats(const Json::Value& request)
+{
+    auto rpcPortDriver = FindPortDriver(request);
+    if (!rpcPortDriver || rpcPortDriver->SerialClients.empty()) {
+        throw TRPCException("SerialClient wasn't found for requested port", TRPCResultCode::RPC_WRONG_PORT);
+    }
+    return rpcPortDriver->GetPollStatistics();
+}
+
 TRPCException::TRPCException(const std::string& message, TRPCResultCode resultCode)
     : std::runtime_error(message),
       ResultCode(resultCode)
@@ -25,9 +25,14 @@ enum class TRPCResultCode
 class TRPCPortDriver
 {
 public:
-    PSerialClient SerialClient;
+    //! Serial clients of port's connections, the first one polls the port's own connection
+    std::vector<PSerialClient> SerialClients;
     PRPCPort RPCPort;
     void SendRequest(PRPCRequest request) const;
+
+    //! Bus load and statistics of all port's connections
+    Json::Value GetBusLoad() const;
+    Json::Value GetPollStatistics() const;
 };
 
 typedef std::shared_ptr<TRPCPortDriver> PRPCPortDriver;
@@ -52,6 +57,8 @@ private:
                   WBMQTT::TMqttRpcServer::TResultCallback onResult,
                   WBMQTT::TMqttRpcServer::TErrorCallback onError);
     Json::Value LoadPorts(const Json::Value& request);
+    Json::Value PortBusLoad(const Json::Value& request);
+    Json::Value PortStats(const Json::Value& request);
 };
 
 typedef std::shared_ptr<TRPCHandler> PRPCHandler;
@@ -1,4 +1,5 @@
 #include "rpc_port.h"
+#include <algorithm>
 
 TRPCPort::TRPCPort(PPort Port): Port(Port){};
 
@@ -7,6 +8,16 @@ PPort TRPCPort::GetPort()
     return this->Port;
 }
 
+void TRPCPort::AddConnection(PPort connection)
+{
+    Connections.push_back(connection);
+}
+
+bool TRPCPort::HasPort(PPort port) const
+{
+    return port == Port || std::find(Connections.begin(), Connections.end(), port) != Connections.end();
+}
+
 TRPCSerialPort::TRPCSerialPort(PPort Port, const std::string& Path): TRPCPort(Port), Path(Path){};
 
 bool TRPCSerialPort::Match(const Json::Value& Request) const
@@ -1,6 +1,7 @@
 #pragma once
 #include "port.h"
 #include "wblib/json_utils.h"
+#include <vector>
 
 class TRPCPort
 {
@@ -10,8 +11,15 @@ public:
     PPort GetPort();
     virtual bool Match(const Json::Value& Request) const = 0;
 
+    //! Adds other connection of the port's connection pool
+    void AddConnection(PPort connection);
+
+    //! The port is the RPC port's own port or one of its connections
+    bool HasPort(PPort port) const;
+
 protected:
     PPort Port;
+    std::vector<PPort> Connections;
 };
 
 typedef std::shared_ptr<TRPCPort> PRPCPort;
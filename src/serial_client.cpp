@@ -1,5 +1,6 @@
 #include "serial_client.h"
 #include <chrono>
+#include <iomanip>
 #include <iostream>
 #include <unistd.h>
 
@@ -20,31 +21,48 @@ namespace
     const auto MIN_READ_EVENTS_TIME = 25ms;
     const size_t MAX_EVENT_READ_ERRORS = 10;
 
-    std::chrono::milliseconds GetReadEventsPeriod(const TPort& port)
+    //! Events of registers with read period must be read not less often than the period
+    milliseconds GetMaxReadEventsPeriod(const std::list<PRegister>& regList, milliseconds maxPeriod)
     {
-        auto sendByteTime = port.GetSendTimeBytes(1);
-        // >= 115200
-        if (sendByteTime < 100us) {
-            return 50ms;
+        if (maxPeriod == milliseconds::zero()) {
+            return maxPeriod;
         }
-        // >= 38400
-        if (sendByteTime < 300us) {
-            return 100ms;
+        for (const auto& reg: regList) {
+            if (reg->SporadicMode != TRegisterConfig::TSporadicMode::DISABLED && reg->ReadPeriod) {
+                maxPeriod = std::min(maxPeriod, *reg->ReadPeriod);
+            }
         }
-        // < 38400
-        return 200ms;
+        return maxPeriod;
     }
-};
+}
+
+std::chrono::milliseconds GetReadEventsPeriod(const TPort& port)
+{
+    auto sendByteTime = port.GetSendTimeBytes(1);
+    // >= 115200
+    if (sendByteTime < 100us) {
+        return 50ms;
+    }
+    // >= 38400
+    if (sendByteTime < 300us) {
+        return 100ms;
+    }
+    // < 38400
+    return 200ms;
+}
 
 TSerialClient::TSerialClient(PPort port,
                              const TPortOpenCloseLogic::TSettings& openCloseSettings,
                              util::TGetNowFn nowFn,
-                             size_t lowPriorityRateLimit)
+                             size_t lowPriorityRateLimit,
+                             const TSerialClientSettings& settings)
     : Port(port),
       OpenCloseLogic(openCloseSettings, nowFn),
       ConnectLogger(PORT_OPEN_ERROR_NOTIFICATION_INTERVAL, "[serial client] "),
       NowFn(nowFn),
-      LowPriorityRateLimit(lowPriorityRateLimit)
+      LowPriorityRateLimit(lowPriorityRateLimit),
+      Settings(settings),
+      PollStatistics(std::make_shared<TPollStatistics>())
 {
     FlushNeeded = std::make_shared<TBinarySemaphore>();
     RPCRequestHandler = std::make_shared<TRPCRequestHandler>();
@@ -70,14 +88,43 @@ void TSerialClient::AddRegister(PRegister reg)
     LOG(Debug) << "AddRegister: " << reg;
 }
 
+void TSerialClient::CheckBusLoad()
+{
+    // Devices' register range pools are used by port's thread after activation
+    if (RegReader)
+        throw TSerialDeviceException("can't check bus load of the active client");
+    BusLoad = CalculateBusLoad(RegList, Settings);
+    LogBusLoad(Port->GetDescription(), BusLoad);
+    if (Settings.StretchLowPriorityRateLimits) {
+        auto factor = StretchLowPriorityRateLimits(RegList, BusLoad);
+        if (factor != 1) {
+            LOG(Warn) << Port->GetDescription() << " read_rate_limit_ms of low priority registers are increased "
+                      << std::setprecision(2) << factor << " times to fit bus capacity";
+            BusLoad = CalculateBusLoad(RegList, Settings);
+        }
+    }
+}
+
+const TBusLoadReport& TSerialClient::GetBusLoad() const
+{
+    return BusLoad;
+}
+
+PPollStatistics TSerialClient::GetPollStatistics() const
+{
+    return PollStatistics;
+}
+
 void TSerialClient::Activate()
 {
     if (!RegReader) {
         RegReader = std::make_unique<TSerialClientRegisterAndEventsReader>(RegList,
                                                                            GetReadEventsPeriod(*Port),
                                                                            NowFn,
-                                                                           LowPriorityRateLimit);
+                                                                           LowPriorityRateLimit,
+                                                                           Settings);
         LastAccessedDevice = std::make_unique<TSerialClientDeviceAccessHandler>(RegReader->GetEventsReader());
+        RegReader->SetPollStatistics(PollStatistics);
     }
 }
 
@@ -86,26 +133,109 @@ void TSerialClient::Connect()
     OpenCloseLogic.OpenIfAllowed(Port);
 }
 
-void TSerialClient::DoFlush()
+void TSerialClient::ProcessPendingWrites(std::function<void(const std::vector<TRegisterHandler*>& handlers)> fn)
 {
-    for (const auto& reg: RegList) {
-        auto handler = Handlers[reg];
+    PendingWritesBuffer.clear();
+    PendingWrites.PopAll(PendingWritesBuffer);
+
+    // Values of a device are processed together, so the device can combine writes
+    std::vector<std::vector<TRegisterHandler*>> deviceHandlers;
+    std::unordered_map<PSerialDevice, size_t> deviceIndexes;
+    for (auto handler: PendingWritesBuffer) {
         if (!handler->NeedToFlush())
             continue;
-        if (LastAccessedDevice->PrepareToAccess(handler->Device())) {
-            handler->Flush();
-        } else {
-            reg->SetError(TRegister::TError::WriteError);
+        auto it = deviceIndexes.emplace(handler->Device(), deviceHandlers.size()).first;
+        if (it->second == deviceHandlers.size()) {
+            deviceHandlers.emplace_back();
+        }
+        deviceHandlers[it->second].push_back(handler);
+    }
+
+    for (const auto& handlers: deviceHandlers) {
+        fn(handlers);
+        // Not written values are retried in the next cycle
+        for (auto handler: handlers) {
+            if (handler->NeedToFlush()) {
+                PendingWrites.Push(*handler);
+            }
+        }
+    }
+}
+
+void TSerialClient::DoFlush()
+{
+    ProcessPendingWrites([this](const std::vector<TRegisterHandler*>& handlers) {
+        std::vector<TPendingWrite> writes;
+        for (auto handler: handlers) {
+            writes.push_back({handler, {handler->Register(), handler->GetValueToSet()}, handler->GetValueSetTime()});
         }
-        if (reg->GetErrorState().test(TRegister::TError::WriteError)) {
-            if (ErrorCallback) {
-                ErrorCallback(reg);
+        if (!LastAccessedDevice->PrepareToAccess(handlers.front()->Device())) {
+            for (auto& write: writes) {
+                write.Handler->Register()->SetError(TRegister::TError::WriteError);
+                ReportWrite(write);
             }
+            return;
+        }
+        if (writes.size() > 1) {
+            WriteCombined(writes);
         } else {
-            if (ReadCallback) {
-                ReadCallback(reg);
+            WriteWithRead(writes.front());
+        }
+        // Values, which are not written by the device's requests, are written one by one.
+        // Disconnected device is prepared again before every write, except the first one
+        bool prepared = true;
+        for (auto& write: writes) {
+            if (write.Write.Done) {
+                write.Handler->SetFlushed(write.Write.Value);
+            } else {
+                WriteSeparately(write, prepared);
+                prepared = false;
             }
+            ReportWrite(write);
         }
+    });
+}
+
+void TSerialClient::WriteCombined(std::vector<TPendingWrite>& writes)
+{
+    // Values of the device are written by fewer requests if the device supports it
+    std::vector<TRegisterWrite> deviceWrites;
+    for (const auto& write: writes) {
+        deviceWrites.push_back(write.Write);
+    }
+    writes.front().Handler->Device()->WriteRegisters(deviceWrites);
+    for (size_t i = 0; i < writes.size(); ++i) {
+        writes[i].Write.Done = deviceWrites[i].Done;
+    }
+}
+
+void TSerialClient::WriteWithRead(TPendingWrite& write)
+{
+    // Single value can be written by one request with the next read of the device
+    RegReader->WriteRegisterAndRead(write.Write, [this](PRegister reg) { ProcessPolledRegister(reg); });
+}
+
+void TSerialClient::WriteSeparately(TPendingWrite& write, bool prepared)
+{
+    if (prepared || LastAccessedDevice->PrepareToAccess(write.Handler->Device())) {
+        write.Handler->Flush();
+    } else {
+        write.Handler->Register()->SetError(TRegister::TError::WriteError);
+    }
+}
+
+void TSerialClient::ReportWrite(const TPendingWrite& write)
+{
+    auto reg = write.Handler->Register();
+    if (reg->GetErrorState().test(TRegister::TError::WriteError)) {
+        if (ErrorCallback) {
+            ErrorCallback(reg);
+        }
+        return;
+    }
+    PollStatistics->AddWriteLatency(ceil<microseconds>(NowFn() - write.ValueSetTime));
+    if (ReadCallback) {
+        ReadCallback(reg);
     }
 }
 
@@ -136,12 +266,8 @@ void TSerialClient::WaitForPollAndFlush(steady_clock::time_point currentTime, st
 
 void TSerialClient::UpdateFlushNeeded()
 {
-    for (const auto& reg: RegList) {
-        auto handler = Handlers[reg];
-        if (handler->NeedToFlush()) {
-            FlushNeeded->Signal(RegisterUpdateSignal);
-            break;
-        }
+    if (!PendingWrites.IsEmpty()) {
+        FlushNeeded->Signal(RegisterUpdateSignal);
     }
 }
 
@@ -182,18 +308,28 @@ void TSerialClient::ClosedPortCycle()
 
     while (FlushNeeded->Wait(wait_until)) {
         if (FlushNeeded->GetSignalValue(RegisterUpdateSignal)) {
-            for (const auto& reg: RegList) {
-                auto handler = Handlers[reg];
-                if (!handler->NeedToFlush())
-                    continue;
-                reg->SetError(TRegister::TError::WriteError);
-                if (ErrorCallback) {
-                    ErrorCallback(reg);
+            ProcessPendingWrites([this](const std::vector<TRegisterHandler*>& handlers) {
+                for (auto handler: handlers) {
+                    auto reg = handler->Register();
+                    reg->SetError(TRegister::TError::WriteError);
+                    if (ErrorCallback) {
+                        ErrorCallback(reg);
+                    }
                 }
-            }
+            });
         }
         if (FlushNeeded->GetSignalValue(RPCSignal)) {
+            // RPC requests don't wait for the next reopen attempt
+            try {
+                OpenCloseLogic.Open(Port);
+            } catch (const std::exception& e) {
+                ConnectLogger.Log(e.what(), Debug, Error);
+            }
             RPCRequestHandler->RPCRequestHandling(Port);
+            if (Port->IsOpen()) {
+                // Registers are polled from the next cycle
+                return;
+            }
         }
     }
 
@@ -202,7 +338,10 @@ void TSerialClient::ClosedPortCycle()
 
 void TSerialClient::SetTextValue(PRegister reg, const std::string& value)
 {
-    GetHandler(reg)->SetTextValue(value);
+    auto handler = GetHandler(reg);
+    handler->SetTextValue(value, NowFn());
+    PendingWrites.Push(*handler);
+    NewWritesPending = true;
     FlushNeeded->Signal(RegisterUpdateSignal);
 }
 
@@ -230,10 +369,15 @@ void TSerialClient::OpenPortCycle()
     auto currentTime = NowFn();
     WaitForPollAndFlush(currentTime, RegReader->GetDeadline(currentTime));
 
+    // Values set since the previous read show that writes keep coming, so reads are limited to let next values
+    // in between them. Failed writes are retried later and don't limit reads.
+    // Otherwise a new write or RPC request cuts the guard interval before the read short
     auto device = RegReader->OpenPortCycle(
         *Port,
         [this](PRegister reg) { ProcessPolledRegister(reg); },
-        *LastAccessedDevice);
+        *LastAccessedDevice,
+        NewWritesPending.exchange(false),
+        FlushNeeded->GetFd());
 
     if (device) {
         OpenCloseLogic.CloseIfNeeded(Port, device->GetIsDisconnected());
@@ -253,11 +397,14 @@ void TSerialClient::RPCTransceive(PRPCRequest request) const
 TSerialClientRegisterAndEventsReader::TSerialClientRegisterAndEventsReader(const std::list<PRegister>& regList,
                                                                            std::chrono::milliseconds readEventsPeriod,
                                                                            util::TGetNowFn nowFn,
-                                                                           size_t lowPriorityRateLimit)
+                                                                           size_t lowPriorityRateLimit,
+                                                                           const TSerialClientSettings& settings)
     : EventsReader(MAX_EVENT_READ_ERRORS),
-      RegisterPoller(lowPriorityRateLimit),
+      RegisterPoller(lowPriorityRateLimit, settings),
       TimeBalancer(BALANCING_THRESHOLD, 0),
-      ReadEventsPeriod(readEventsPeriod),
+      ReadEventsPeriod(
+          (settings.MinReadEventsPeriod != milliseconds::zero()) ? settings.MinReadEventsPeriod : readEventsPeriod,
+          GetMaxReadEventsPeriod(regList, settings.MaxReadEventsPeriod)),
       SpentTime(nowFn),
       LastCycleWasTooSmallToPoll(false),
       NowFn(nowFn)
@@ -299,7 +446,9 @@ public:
 
 PSerialDevice TSerialClientRegisterAndEventsReader::OpenPortCycle(TPort& port,
                                                                   TCallback regCallback,
-                                                                  TSerialClientDeviceAccessHandler& lastAccessedDevice)
+                                                                  TSerialClientDeviceAccessHandler& lastAccessedDevice,
+                                                                  bool writesPending,
+                                                                  int wakeupFd)
 {
     // Count idle time as high priority task time to faster reach time balancing threshold
     if (LastCycleWasTooSmallToPoll) {
@@ -316,7 +465,7 @@ PSerialDevice TSerialClientRegisterAndEventsReader::OpenPortCycle(TPort& port,
     if (handler.TaskType == TClientTaskType::EVENTS) {
         if (EventsReader.HasDevicesWithEnabledEvents()) {
             lastAccessedDevice.PrepareToAccess(nullptr);
-            EventsReader.ReadEvents(
+            bool hasEvents = EventsReader.ReadEvents(
                 port,
                 MAX_POLL_TIME,
                 regCallback,
@@ -325,9 +474,17 @@ PSerialDevice TSerialClientRegisterAndEventsReader::OpenPortCycle(TPort& port,
                     RegisterPoller.DeviceDisconnected(device, NowFn());
                 },
                 NowFn);
+            ReadEventsPeriod.Update(hasEvents);
+            RegisterPoller.SetEventsReadFailed(EventsReader.IsReadFailed(), NowFn());
+            if (PollStatistics && LastEventsReadTime) {
+                PollStatistics->AddEventsRead(ReadEventsPeriod.Get(),
+                                              hasEvents,
+                                              ceil<microseconds>(NowFn() - *LastEventsReadTime));
+            }
+            LastEventsReadTime = SpentTime.GetStartTime();
             TimeBalancer.UpdateSelectionTime(ceil<milliseconds>(SpentTime.GetSpentTime()), TPriority::High);
             TimeBalancer.AddEntry(TClientTaskType::EVENTS,
-                                  SpentTime.GetStartTime() + ReadEventsPeriod,
+                                  SpentTime.GetStartTime() + ReadEventsPeriod.Get(),
                                   TPriority::High);
         }
         SpentTime.Start();
@@ -347,7 +504,9 @@ PSerialDevice TSerialClientRegisterAndEventsReader::OpenPortCycle(TPort& port,
                                             std::min(handler.PollLimit, MAX_POLL_TIME),
                                             readAtLeastOneRegister,
                                             lastAccessedDevice,
-                                            regCallback);
+                                            regCallback,
+                                            writesPending,
+                                            wakeupFd);
     TimeBalancer.AddEntry(TClientTaskType::POLLING, res.Deadline, TPriority::Low);
     if (res.NotEnoughTime) {
         LastCycleWasTooSmallToPoll = true;
@@ -357,7 +516,9 @@ PSerialDevice TSerialClientRegisterAndEventsReader::OpenPortCycle(TPort& port,
     }
 
     if (EventsReader.HasDevicesWithEnabledEvents() && !TimeBalancer.Contains(TClientTaskType::EVENTS)) {
-        TimeBalancer.AddEntry(TClientTaskType::EVENTS, SpentTime.GetStartTime() + ReadEventsPeriod, TPriority::High);
+        TimeBalancer.AddEntry(TClientTaskType::EVENTS,
+                              SpentTime.GetStartTime() + ReadEventsPeriod.Get(),
+                              TPriority::High);
     }
 
     SpentTime.Start();
@@ -374,3 +535,14 @@ TSerialClientEventsReader& TSerialClientRegisterAndEventsReader::GetEventsReader
 {
     return EventsReader;
 }
+
+void TSerialClientRegisterAndEventsReader::WriteRegisterAndRead(TRegisterWrite& write, TCallback regCallback)
+{
+    RegisterPoller.WriteRegisterAndRead(write, NowFn(), regCallback);
+}
+
+void TSerialClientRegisterAndEventsReader::SetPollStatistics(PPollStatistics statistics)
+{
+    PollStatistics = statistics;
+    RegisterPoller.SetPollStatistics(statistics);
+}
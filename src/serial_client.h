@@ -1,23 +1,31 @@
 #pragma once
 
 #include "binary_semaphore.h"
+#include "bus_load.h"
 #include "common_utils.h"
 #include "log.h"
 #include "modbus_ext_common.h"
 #include "poll_plan.h"
+#include "read_events_period.h"
 #include "register_handler.h"
 #include "rpc_request_handler.h"
 #include "serial_client_device_access_handler.h"
 #include "serial_client_events_reader.h"
 #include "serial_client_register_poller.h"
+#include "serial_client_settings.h"
+#include <atomic>
 #include <functional>
 #include <list>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 
 class TSerialDevice;
 typedef std::shared_ptr<TSerialDevice> PSerialDevice;
 
+//! Period of events reading depending on port's speed
+std::chrono::milliseconds GetReadEventsPeriod(const TPort& port);
+
 enum TClientTaskType
 {
     POLLING,
@@ -32,22 +40,32 @@ public:
     TSerialClientRegisterAndEventsReader(const std::list<PRegister>& regList,
                                          std::chrono::milliseconds readEventsPeriod,
                                          util::TGetNowFn nowFn,
-                                         size_t lowPriorityRateLimit = std::numeric_limits<size_t>::max());
+                                         size_t lowPriorityRateLimit = std::numeric_limits<size_t>::max(),
+                                         const TSerialClientSettings& settings = TSerialClientSettings());
 
     void ClosedPortCycle(std::chrono::steady_clock::time_point currentTime, TCallback regCallback);
     PSerialDevice OpenPortCycle(TPort& port,
                                 TCallback regCallback,
-                                TSerialClientDeviceAccessHandler& lastAccessedDevice);
+                                TSerialClientDeviceAccessHandler& lastAccessedDevice,
+                                bool writesPending = false,
+                                int wakeupFd = -1);
 
     std::chrono::steady_clock::time_point GetDeadline(std::chrono::steady_clock::time_point currentTime) const;
 
     TSerialClientEventsReader& GetEventsReader();
 
+    //! Write the value by one request with the device's next read if the device supports it
+    void WriteRegisterAndRead(TRegisterWrite& write, TCallback regCallback);
+
+    void SetPollStatistics(PPollStatistics statistics);
+
 private:
     TSerialClientEventsReader EventsReader;
     TSerialClientRegisterPoller RegisterPoller;
     TScheduler<TClientTaskType> TimeBalancer;
-    std::chrono::milliseconds ReadEventsPeriod;
+    TReadEventsPeriod ReadEventsPeriod;
+    std::optional<std::chrono::steady_clock::time_point> LastEventsReadTime;
+    PPollStatistics PollStatistics;
 
     util::TSpentTimeMeter SpentTime;
     bool LastCycleWasTooSmallToPoll;
@@ -62,7 +80,8 @@ public:
     TSerialClient(PPort port,
                   const TPortOpenCloseLogic::TSettings& openCloseSettings,
                   util::TGetNowFn nowFn,
-                  size_t lowPriorityRateLimit = std::numeric_limits<size_t>::max());
+                  size_t lowPriorityRateLimit = std::numeric_limits<size_t>::max(),
+                  const TSerialClientSettings& settings = TSerialClientSettings());
     ~TSerialClient();
 
     void AddRegister(PRegister reg);
@@ -73,22 +92,54 @@ public:
     PPort GetPort();
     void RPCTransceive(PRPCRequest request) const;
 
+    //! Estimate bus load of added registers. Must be called before polling is started
+    void CheckBusLoad();
+    const TBusLoadReport& GetBusLoad() const;
+
+    //! Polling statistics of the port. It is safe to use from other threads
+    PPollStatistics GetPollStatistics() const;
+
 private:
+    //! Value of a handler, which is written, and the result of writing
+    struct TPendingWrite
+    {
+        TRegisterHandler* Handler;
+        TRegisterWrite Write;
+        std::chrono::steady_clock::time_point ValueSetTime;
+    };
+
     void Activate();
     void Connect();
     void DoFlush();
+
+    //! Writes of the same device. Done writes are marked
+    void WriteCombined(std::vector<TPendingWrite>& writes);
+    void WriteWithRead(TPendingWrite& write);
+
+    //! Writes the value by its own request, errors are set to the register.
+    //! The device is prepared to access unless it is just prepared
+    void WriteSeparately(TPendingWrite& write, bool prepared);
+    void ReportWrite(const TPendingWrite& write);
     void WaitForPollAndFlush(std::chrono::steady_clock::time_point now,
                              std::chrono::steady_clock::time_point waitUntil);
     PRegisterHandler GetHandler(PRegister) const;
     void ClosedPortCycle();
     void OpenPortCycle();
     void UpdateFlushNeeded();
+    void ProcessPendingWrites(std::function<void(const std::vector<TRegisterHandler*>& handlers)> fn);
     void ProcessPolledRegister(PRegister reg);
 
     PPort Port;
     std::list<PRegister> RegList;
     std::unordered_map<PRegister, PRegisterHandler> Handlers;
 
+    //! Handlers with values set from other threads. Values are written by port's thread
+    TRegisterHandlerQueue PendingWrites;
+    std::vector<TRegisterHandler*> PendingWritesBuffer;
+
+    //! Values are set since the last read
+    std::atomic_bool NewWritesPending{false};
+
     TCallback ReadCallback;
     TCallback ErrorCallback;
     PBinarySemaphore FlushNeeded;
@@ -105,6 +156,12 @@ private:
     util::TGetNowFn NowFn;
 
     size_t LowPriorityRateLimit;
+
+    TSerialClientSettings Settings;
+
+    TBusLoadReport BusLoad;
+
+    PPollStatistics PollStatistics;
 };
 
 typedef std::shared_ptr<TSerialClient> PSerialClient;
@@ -114,10 +114,12 @@ namespace
 class TModbusExtEventsVisitor: public ModbusExt::IEventsVisitor
 {
     const TSerialClientEventsReader::TRegsMap& Regs;
+    const TSerialClientEventsReader::TSlaveRegsMap& SlaveRegs;
     std::unordered_set<uint8_t>& DevicesWithEnabledEvents;
     TSerialClientEventsReader::TRegisterCallback RegisterChangedCallback;
     TSerialClientEventsReader::TDeviceCallback DeviceRestartedCallback;
     uint8_t SlaveId = 0;
+    bool HasEvents = false;
     std::list<TEventsReaderRegisterDesc> RegsToDisable;
 
     void ProcessRegisterChangeEvent(uint8_t slaveId,
@@ -145,22 +147,23 @@ class TModbusExtEventsVisitor: public ModbusExt::IEventsVisitor
     void ProcessDeviceRestartedEvent(uint8_t slaveId)
     {
         DevicesWithEnabledEvents.erase(slaveId);
-        for (const auto& reg: Regs) {
-            if (reg.first.SlaveId == slaveId) {
-                LOG(Debug) << "Restart event from " << MakeDeviceDescriptionString(slaveId);
-                DeviceRestartedCallback(reg.second.front()->Device());
-                return;
-            }
+        auto slaveRegs = SlaveRegs.find(slaveId);
+        if (slaveRegs != SlaveRegs.end()) {
+            LOG(Debug) << "Restart event from " << MakeDeviceDescriptionString(slaveId);
+            DeviceRestartedCallback(slaveRegs->second.front()->second.front()->Device());
+            return;
         }
         LOG(Warn) << "Restart event from unknown device " << MakeDeviceDescriptionString(slaveId);
     }
 
 public:
     TModbusExtEventsVisitor(const TSerialClientEventsReader::TRegsMap& regs,
+                            const TSerialClientEventsReader::TSlaveRegsMap& slaveRegs,
                             std::unordered_set<uint8_t>& devicesWithEnabledEvents,
                             TSerialClientEventsReader::TRegisterCallback registerChangedCallback,
                             TSerialClientEventsReader::TDeviceCallback deviceRestartedCallback)
         : Regs(regs),
+          SlaveRegs(slaveRegs),
           DevicesWithEnabledEvents(devicesWithEnabledEvents),
           RegisterChangedCallback(registerChangedCallback),
           DeviceRestartedCallback(deviceRestartedCallback)
@@ -173,6 +176,7 @@ public:
                        size_t dataSize) override
     {
         SlaveId = slaveId;
+        HasEvents = true;
         switch (eventType) {
             case ModbusExt::TEventType::COIL:
             case ModbusExt::TEventType::DISCRETE:
@@ -197,6 +201,11 @@ public:
         return SlaveId;
     }
 
+    bool GetHasEvents() const
+    {
+        return HasEvents;
+    }
+
     const std::list<TEventsReaderRegisterDesc>& GetRegsToDisable() const
     {
         return RegsToDisable;
@@ -210,13 +219,17 @@ TSerialClientEventsReader::TSerialClientEventsReader(size_t maxReadErrors)
       ClearErrorsOnSuccessfulRead(false)
 {}
 
-void TSerialClientEventsReader::ReadEvents(TPort& port,
+bool TSerialClientEventsReader::ReadEvents(TPort& port,
                                            milliseconds maxReadingTime,
                                            TRegisterCallback registerCallback,
                                            TDeviceCallback deviceRestartedHandler,
                                            util::TGetNowFn nowFn)
 {
-    TModbusExtEventsVisitor visitor(Regs, DevicesWithEnabledEvents, registerCallback, deviceRestartedHandler);
+    TModbusExtEventsVisitor visitor(Regs,
+                                    SlaveRegs,
+                                    DevicesWithEnabledEvents,
+                                    registerCallback,
+                                    deviceRestartedHandler);
     util::TSpentTimeMeter spentTimeMeter(nowFn);
     spentTimeMeter.Start();
     for (auto spentTime = 0us; spentTime < maxReadingTime; spentTime = spentTimeMeter.GetSpentTime()) {
@@ -246,6 +259,7 @@ void TSerialClientEventsReader::ReadEvents(TPort& port,
         }
     }
     DisableEventsFromRegs(port, visitor.GetRegsToDisable());
+    return visitor.GetHasEvents();
 }
 
 void TSerialClientEventsReader::EnableEvents(PSerialDevice device, TPort& port)
@@ -267,12 +281,13 @@ void TSerialClientEventsReader::EnableEvents(PSerialDevice device, TPort& port)
                                  ModbusExt::TEventsEnabler::DISABLE_EVENTS_IN_HOLES);
 
     try {
-        for (const auto& regArray: Regs) {
-            if (regArray.first.SlaveId == slaveId) {
-                ev.AddRegister(regArray.first.Addr,
-                               static_cast<ModbusExt::TEventType>(regArray.first.Type),
-                               regArray.second.front()->IsHighPriority() ? ModbusExt::TEventPriority::HIGH
-                                                                         : ModbusExt::TEventPriority::LOW);
+        auto slaveRegs = SlaveRegs.find(slaveId);
+        if (slaveRegs != SlaveRegs.end()) {
+            for (const auto regArray: slaveRegs->second) {
+                ev.AddRegister(regArray->first.Addr,
+                               static_cast<ModbusExt::TEventType>(regArray->first.Type),
+                               regArray->second.front()->IsHighPriority() ? ModbusExt::TEventPriority::HIGH
+                                                                          : ModbusExt::TEventPriority::LOW);
             }
         }
         if (ev.HasEventsToSetup()) {
@@ -315,7 +330,11 @@ void TSerialClientEventsReader::AddRegister(PRegister reg)
             TEventsReaderRegisterDesc regDesc{static_cast<uint8_t>(dev->SlaveId),
                                               static_cast<uint16_t>(GetUint32RegisterAddress(reg->GetAddress())),
                                               ToEventRegisterType(static_cast<Modbus::RegisterType>(reg->Type))};
-            Regs[regDesc].push_back(reg);
+            auto res = Regs.try_emplace(regDesc);
+            if (res.second) {
+                SlaveRegs[regDesc.SlaveId].push_back(&(*res.first));
+            }
+            res.first->second.push_back(reg);
         }
     }
 }
@@ -365,6 +384,11 @@ bool TSerialClientEventsReader::HasDevicesWithEnabledEvents() const
     return !DevicesWithEnabledEvents.empty();
 }
 
+bool TSerialClientEventsReader::IsReadFailed() const
+{
+    return ClearErrorsOnSuccessfulRead;
+}
+
 bool TEventsReaderRegisterDesc::operator==(const TEventsReaderRegisterDesc& other) const
 {
     return SlaveId == other.SlaveId && Addr == other.Addr && Type == other.Type;
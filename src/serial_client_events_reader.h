@@ -37,13 +37,21 @@ public:
     // but represent different value regions
     typedef std::unordered_map<TEventsReaderRegisterDesc, std::vector<PRegister>> TRegsMap;
 
+    //! Elements of TRegsMap grouped by slave id. Pointers to unordered_map elements are not invalidated by insertion
+    typedef std::unordered_map<uint8_t, std::vector<const TRegsMap::value_type*>> TSlaveRegsMap;
+
     TSerialClientEventsReader(size_t maxReadErrors);
 
     void AddRegister(PRegister reg);
 
     void EnableEvents(PSerialDevice device, TPort& port);
 
-    void ReadEvents(TPort& port,
+    /**
+     * @brief Read events from all devices with enabled events
+     *
+     * @return true - at least one event is received
+     */
+    bool ReadEvents(TPort& port,
                     std::chrono::milliseconds maxReadingTime,
                     TRegisterCallback registerCallback,
                     TDeviceCallback deviceRestartedHandler,
@@ -54,6 +62,9 @@ public:
 
     bool HasDevicesWithEnabledEvents() const;
 
+    //! Events reading failed more than maxReadErrors times in a row and has not succeeded since then
+    bool IsReadFailed() const;
+
 private:
     uint8_t LastAccessedSlaveId;
     ModbusExt::TEventConfirmationState EventState;
@@ -62,6 +73,7 @@ private:
     bool ClearErrorsOnSuccessfulRead;
 
     TRegsMap Regs;
+    TSlaveRegsMap SlaveRegs;
     std::unordered_set<uint8_t> DevicesWithEnabledEvents;
 
     void OnEnabledEvent(uint8_t slaveId, uint8_t type, uint16_t addr, bool res);
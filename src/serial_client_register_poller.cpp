@@ -1,7 +1,9 @@
 #include "serial_client_register_poller.h"
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <unistd.h>
+#include <unordered_map>
 
 #include "log.h"
 #include "serial_device.h"
@@ -15,45 +17,204 @@ namespace
 {
     const auto MAX_LOW_PRIORITY_LAG = 1s;
 
+    // First interval between reads of disconnected device, it is doubled after every failed read
+    const auto MIN_PROBE_INTERVAL = 500ms;
+
+    // Shares of bus time of poll classes in TRegisterConfig::EPollClass order
+    const std::vector<size_t> POLL_CLASS_WEIGHTS = {8, 4, 1};
+
+    //! Maximum read time of a range by write latency target, zero target disables the limit
+    milliseconds GetMaxRangePollTime(milliseconds writeLatencyTarget)
+    {
+        return (writeLatencyTarget != milliseconds::zero()) ? writeLatencyTarget : milliseconds::max();
+    }
+
+    //! Registers of the entry are excluded from polling because their values are reported by events
+    bool IsCoveredByEvents(const TReadPlanEntry& entry)
+    {
+        return std::all_of(entry.Registers.begin(), entry.Registers.end(), [](const PRegister& reg) {
+            return reg->IsExcludedFromPolling() && reg->GetAvailable() != TRegisterAvailability::UNAVAILABLE;
+        });
+    }
+
     class TRegisterReader
     {
-        PRegisterRange RegisterRange;
+        std::vector<PRegisterRange>& RegisterRanges;
+        std::vector<PReadPlanEntry>& Entries;
         milliseconds MaxPollTime;
         PSerialDevice Device;
         TPriority Priority;
         bool ReadAtLeastOneRegister;
+        size_t MaxRanges;
+        milliseconds MaxRangePollTime;
+        milliseconds PendingWritesMaxRangePollTime;
+
+        milliseconds GetPollLimit(TItemAccumulationPolicy policy, milliseconds pollLimit) const
+        {
+            if (ReadAtLeastOneRegister) {
+                if (policy == TItemAccumulationPolicy::Force) {
+                    return milliseconds::max();
+                }
+                return pollLimit;
+            }
+            if (policy == TItemAccumulationPolicy::Force) {
+                return MaxPollTime;
+            }
+            return std::min(MaxPollTime, pollLimit);
+        }
+
+        bool AddToLastRange(const PReadPlanEntry& entry, TItemAccumulationPolicy policy, milliseconds limit)
+        {
+            auto& RegisterRange = RegisterRanges.back();
+            if (entry->Registers.size() == 1) {
+                auto registersCount = RegisterRange->RegisterList().size();
+                if (!RegisterRange->Add(entry->Registers.front(), limit)) {
+                    return false;
+                }
+                // Unavailable registers are skipped by range and are not polled anymore
+                if (RegisterRange->RegisterList().size() != registersCount) {
+                    Entries.push_back(entry);
+                }
+                return true;
+            }
+
+            // Planned ranges are not merged with other entries
+            if (!RegisterRange->RegisterList().empty()) {
+                return false;
+            }
+            const auto& registers = entry->Registers;
+            const auto first = entry->FirstUnreadRegister;
+            size_t firstUnread = 0;
+            for (auto i = first; i < registers.size(); ++i) {
+                // While writes are waiting, the entry is read by parts. First register of a part is read anyway
+                if (i != first && PendingWritesMaxRangePollTime < limit) {
+                    if (!RegisterRange->Add(registers[i], PendingWritesMaxRangePollTime)) {
+                        firstUnread = i;
+                        break;
+                    }
+                    continue;
+                }
+                if (!RegisterRange->Add(registers[i], limit)) {
+                    RegisterRange = Device->CreateRegisterRange();
+                    if (policy != TItemAccumulationPolicy::Force) {
+                        return false;
+                    }
+                    // Device's response time has been increased since the plan was built.
+                    // Read the rest of the entry and rebuild the plan
+                    for (auto j = first; j < registers.size(); ++j) {
+                        RegisterRange->Add(registers[j], milliseconds::max());
+                    }
+                    entry->Outdated = true;
+                    break;
+                }
+            }
+            entry->FirstUnreadRegister = firstUnread;
+            // Planned ranges fit write latency target, so the entry is split by rebuilding of the plan
+            if (ceil<milliseconds>(RegisterRange->GetPollTime()) > MaxRangePollTime) {
+                entry->Outdated = true;
+            }
+            Entries.push_back(entry);
+            return true;
+        }
 
     public:
-        TRegisterReader(milliseconds maxPollTime, bool readAtLeastOneRegister)
-            : MaxPollTime(maxPollTime),
-              ReadAtLeastOneRegister(readAtLeastOneRegister)
-        {}
+        //! Ranges and entries are stored to the given vectors, they are cleared after reading keeping their capacity.
+        //! pendingWritesMaxRangePollTime limits ranges of the cycle in addition to maxRangePollTime,
+        //! planned entries longer than the limit are read by parts
+        TRegisterReader(std::vector<PRegisterRange>& registerRanges,
+                        std::vector<PReadPlanEntry>& entries,
+                        milliseconds maxPollTime,
+                        bool readAtLeastOneRegister,
+                        size_t maxRanges = 1,
+                        milliseconds maxRangePollTime = milliseconds::max(),
+                        milliseconds pendingWritesMaxRangePollTime = milliseconds::max())
+            : RegisterRanges(registerRanges),
+              Entries(entries),
+              MaxPollTime(maxPollTime),
+              ReadAtLeastOneRegister(readAtLeastOneRegister),
+              MaxRanges(maxRanges),
+              MaxRangePollTime(maxRangePollTime),
+              PendingWritesMaxRangePollTime(pendingWritesMaxRangePollTime)
+        {
+            RegisterRanges.clear();
+            Entries.clear();
+        }
 
-        bool operator()(const PRegister& reg, TItemAccumulationPolicy policy, milliseconds pollLimit)
+        ~TRegisterReader()
+        {
+            // Pooled ranges must be released
+            RegisterRanges.clear();
+            Entries.clear();
+        }
+
+        bool operator()(const PReadPlanEntry& entry, TItemAccumulationPolicy policy, milliseconds pollLimit)
         {
             if (!Device) {
-                RegisterRange = reg->Device()->CreateRegisterRange();
-                Device = reg->Device();
-                Priority = reg->IsHighPriority() ? TPriority::High : TPriority::Low;
+                RegisterRanges.push_back(entry->Device->CreateRegisterRange());
+                Device = entry->Device;
+                Priority = entry->Priority;
             }
-            if (Device != reg->Device()) {
+            if (Device != entry->Device) {
                 return false;
             }
-            if (ReadAtLeastOneRegister) {
-                if (policy == TItemAccumulationPolicy::Force) {
-                    return RegisterRange->Add(reg, milliseconds::max());
-                }
-                return RegisterRange->Add(reg, pollLimit);
+            auto limit = GetPollLimit(policy, pollLimit);
+            // Long ranges delay writes, so they are split. First register of a range is read anyway
+            if (!RegisterRanges.back()->RegisterList().empty()) {
+                limit = std::min({limit, MaxRangePollTime, PendingWritesMaxRangePollTime});
             }
-            if (policy == TItemAccumulationPolicy::Force) {
-                return RegisterRange->Add(reg, MaxPollTime);
+            if (AddToLastRange(entry, policy, limit)) {
+                return true;
             }
-            return RegisterRange->Add(reg, std::min(MaxPollTime, pollLimit));
+            // The device can read several ranges at once
+            if (RegisterRanges.size() >= MaxRanges || RegisterRanges.back()->RegisterList().empty()) {
+                return false;
+            }
+            RegisterRanges.push_back(Device->CreateRegisterRange());
+            if (AddToLastRange(entry, policy, limit)) {
+                return true;
+            }
+            RegisterRanges.pop_back();
+            return false;
         }
 
-        PRegisterRange GetRegisterRange() const
+        //! Adds single register entry to the ranges if it doesn't make reading of a range longer
+        bool AddIfFree(const PReadPlanEntry& entry)
         {
-            return RegisterRange;
+            if (RegisterRanges.empty() || entry->Registers.size() != 1) {
+                return false;
+            }
+            // Planned ranges are not merged with other entries
+            if (std::any_of(Entries.begin(), Entries.end(), [](const PReadPlanEntry& e) {
+                    return e->Registers.size() != 1;
+                }))
+            {
+                return false;
+            }
+            for (const auto& range: RegisterRanges) {
+                // Range's device doesn't estimate reading time
+                auto pollTime = range->GetPollTime();
+                if (range->RegisterList().empty() || pollTime == microseconds::zero()) {
+                    continue;
+                }
+                auto registersCount = range->RegisterList().size();
+                if (range->Add(entry->Registers.front(), ceil<milliseconds>(pollTime)) &&
+                    range->RegisterList().size() != registersCount)
+                {
+                    Entries.push_back(entry);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const std::vector<PRegisterRange>& GetRegisterRanges() const
+        {
+            return RegisterRanges;
+        }
+
+        const std::vector<PReadPlanEntry>& GetEntries() const
+        {
+            return Entries;
         }
 
         TPriority GetPriority() const
@@ -64,59 +225,223 @@ namespace
 
     class TClosedPortRegisterReader
     {
-        std::list<PRegister> Regs;
+        std::list<PReadPlanEntry> Entries;
 
     public:
-        bool operator()(const PRegister& reg, TItemAccumulationPolicy policy, milliseconds pollLimit)
+        bool operator()(const PReadPlanEntry& entry, TItemAccumulationPolicy policy, milliseconds pollLimit)
         {
-            Regs.emplace_back(reg);
+            Entries.emplace_back(entry);
             return true;
         }
 
-        std::list<PRegister>& GetRegisters()
+        std::list<PReadPlanEntry>& GetEntries()
         {
-            return Regs;
+            return Entries;
         }
 
-        void ClearRegisters()
+        void ClearEntries()
         {
-            Regs.clear();
+            Entries.clear();
         }
     };
 };
 
-TSerialClientRegisterPoller::TSerialClientRegisterPoller(size_t lowPriorityRateLimit)
-    : Scheduler(MAX_LOW_PRIORITY_LAG, lowPriorityRateLimit),
-      ThrottlingStateLogger()
+TSerialClientRegisterPoller::TSerialClientRegisterPoller(size_t lowPriorityRateLimit,
+                                                         const TSerialClientSettings& settings)
+    : ReadPlan(settings),
+      Scheduler(MAX_LOW_PRIORITY_LAG, lowPriorityRateLimit, settings.LowPriorityBurstSize, POLL_CLASS_WEIGHTS),
+      ThrottlingStateLogger(),
+      SpreadReadPeriods(settings.SpreadReadPeriods),
+      PiggybackWindow(settings.PiggybackWindow),
+      MaxProbeInterval(settings.MaxProbeInterval),
+      ProbeJitterGenerator(std::random_device()()),
+      MaxRequestsInFlight(std::max<size_t>(settings.MaxRequestsInFlight, 1)),
+      EventsSafetyPollPeriod(settings.EventsSafetyPollPeriod),
+      MaxRangePollTime(GetMaxRangePollTime(settings.WriteLatencyTarget)),
+      PendingWritesMaxRangePollTime(GetMaxRangePollTime(settings.PendingWritesLatencyTarget))
 {}
 
 void TSerialClientRegisterPoller::PrepareRegisterRanges(const std::list<PRegister>& regList,
                                                         steady_clock::time_point currentTime)
 {
-    RegList = regList;
-    for (auto& reg: RegList) {
-        if (reg->AccessType != TRegisterConfig::EAccessType::WRITE_ONLY) {
-            Scheduler.AddEntry(reg, currentTime, reg->IsHighPriority() ? TPriority::High : TPriority::Low);
+    DeviceRegisters.clear();
+    for (const auto& reg: regList) {
+        DeviceRegisters[reg->Device()].push_back(reg);
+    }
+    ReadPlan.Build(regList);
+    for (const auto& device: ReadPlan.GetDevices()) {
+        for (const auto& entry: ReadPlan.GetEntries(device)) {
+            entry->Deadline = currentTime;
+        }
+    }
+    if (SpreadReadPeriods) {
+        SpreadReadPeriodPhases(ReadPlan, currentTime);
+    }
+    for (const auto& device: ReadPlan.GetDevices()) {
+        for (const auto& entry: ReadPlan.GetEntries(device)) {
+            Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
         }
     }
 }
 
-void TSerialClientRegisterPoller::ScheduleNextPoll(PRegister reg, steady_clock::time_point pollStartTime)
+void TSerialClientRegisterPoller::ScheduleNextPoll(PReadPlanEntry entry, steady_clock::time_point pollStartTime)
 {
-    if (reg->IsExcludedFromPolling()) {
-        return;
+    entry->FirstUnreadRegister = 0;
+    if (std::all_of(entry->Registers.begin(), entry->Registers.end(), [](const PRegister& reg) {
+            return reg->IsExcludedFromPolling();
+        }))
+    {
+        if (EventsSafetyPollPeriod == milliseconds::zero() || !IsCoveredByEvents(*entry)) {
+            return;
+        }
+        if (!EventsReadFailed) {
+            entry->Deadline = pollStartTime + EventsSafetyPollPeriod;
+            Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+            return;
+        }
     }
+    const auto& reg = entry->Registers.front();
     if (reg->IsHighPriority()) {
-        Scheduler.AddEntry(reg, pollStartTime + *(reg->ReadPeriod), TPriority::High);
-        return;
+        entry->Deadline = pollStartTime + *(reg->ReadPeriod);
+    } else if (reg->ReadRateLimit) {
+        entry->Deadline = pollStartTime + *(reg->ReadRateLimit);
+    } else {
+        // Low priority tasks should be scheduled to read as soon as possible,
+        // but with a small delay after current read.
+        entry->Deadline = pollStartTime + 1us;
     }
-    if (reg->ReadRateLimit) {
-        Scheduler.AddEntry(reg, pollStartTime + *(reg->ReadRateLimit), TPriority::Low);
+    Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+}
+
+template<class TReader>
+void TSerialClientRegisterPoller::AddDueSoonEntries(TReader& reader,
+                                                    PSerialDevice device,
+                                                    steady_clock::time_point currentTime)
+{
+    // Only registers with read period are read early.
+    // Reads of other registers are limited by low priority rate limit
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        if (entry->Priority == TPriority::High && entry->Deadline <= currentTime + PiggybackWindow &&
+            Scheduler.Contains(entry) && reader.AddIfFree(entry))
+        {
+            Scheduler.Remove(entry);
+        }
+    }
+}
+
+void TSerialClientRegisterPoller::RebuildReadPlan(PSerialDevice device, steady_clock::time_point currentTime)
+{
+    // New entries inherit the earliest deadline of their registers
+    std::unordered_map<PRegister, steady_clock::time_point> deadlines;
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        auto deadline = Scheduler.Remove(entry) ? entry->Deadline : currentTime;
+        for (const auto& reg: entry->Registers) {
+            deadlines[reg] = deadline;
+        }
+    }
+    ReadPlan.Rebuild(device);
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        entry->Deadline = steady_clock::time_point::max();
+        for (const auto& reg: entry->Registers) {
+            auto it = deadlines.find(reg);
+            entry->Deadline = std::min(entry->Deadline, (it != deadlines.end()) ? it->second : currentTime);
+        }
+        Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+    }
+    auto disconnectedDevice = DisconnectedDevices.find(device);
+    if (disconnectedDevice != DisconnectedDevices.end()) {
+        SuspendPolling(device, disconnectedDevice->second);
+        ScheduleProbe(disconnectedDevice->second, currentTime);
+    }
+}
+
+void TSerialClientRegisterPoller::StartProbing(PSerialDevice device,
+                                               steady_clock::time_point currentTime,
+                                               TRegisterCallback callback)
+{
+    if (ReadPlan.GetEntries(device).empty()) {
         return;
     }
-    // Low priority tasks should be scheduled to read as soon as possible,
-    // but with a small delay after current read.
-    Scheduler.AddEntry(reg, pollStartTime + 1us, TPriority::Low);
+    auto& state = DisconnectedDevices[device];
+    state.ProbeInterval = MIN_PROBE_INTERVAL;
+    SuspendPolling(device, state);
+    ScheduleProbe(state, currentTime);
+    LOG(Debug) << "Only one register of disconnected device " << device->ToString() << " is polled";
+
+    // Registers are not read till device's answer, so their values are not valid
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        for (const auto& reg: entry->Registers) {
+            reg->SetError(TRegister::TError::ReadError);
+            if (callback) {
+                callback(reg);
+            }
+        }
+    }
+}
+
+void TSerialClientRegisterPoller::StopProbing(PSerialDevice device, steady_clock::time_point currentTime)
+{
+    DisconnectedDevices.erase(device);
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        if (!Scheduler.Contains(entry) &&
+            std::any_of(entry->Registers.begin(), entry->Registers.end(), [](const PRegister& reg) {
+                return !reg->IsExcludedFromPolling();
+            }))
+        {
+            entry->Deadline = currentTime;
+            Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+        }
+    }
+}
+
+void TSerialClientRegisterPoller::SuspendPolling(PSerialDevice device, TDisconnectedDevice& state)
+{
+    state.ProbeEntry = nullptr;
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        Scheduler.Remove(entry);
+        entry->FirstUnreadRegister = 0;
+        if (!state.ProbeEntry &&
+            std::any_of(entry->Registers.begin(), entry->Registers.end(), [](const PRegister& reg) {
+                return !reg->IsExcludedFromPolling();
+            }))
+        {
+            state.ProbeEntry = entry;
+        }
+    }
+    if (!state.ProbeEntry) {
+        state.ProbeEntry = ReadPlan.GetEntries(device).front();
+    }
+}
+
+void TSerialClientRegisterPoller::ScheduleProbe(TDisconnectedDevice& state, steady_clock::time_point currentTime)
+{
+    // Random delay prevents simultaneous probes of devices disconnected at once
+    std::uniform_int_distribution<milliseconds::rep> jitter(0, state.ProbeInterval.count() / 2);
+    auto& entry = state.ProbeEntry;
+    Scheduler.Remove(entry);
+    entry->Deadline = currentTime + state.ProbeInterval / 2 + milliseconds(jitter(ProbeJitterGenerator));
+    Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+}
+
+void TSerialClientRegisterPoller::PostponeEntries(const std::vector<PReadPlanEntry>& entries,
+                                                  const std::vector<PRegisterRange>& ranges)
+{
+    for (auto& entry: entries) {
+        // A planned entry is read by its own range, the part starts from the range's first register
+        if (entry->Registers.size() > 1) {
+            for (const auto& range: ranges) {
+                if (range->RegisterList().empty()) {
+                    continue;
+                }
+                auto it = std::find(entry->Registers.begin(), entry->Registers.end(), range->RegisterList().front());
+                if (it != entry->Registers.end()) {
+                    entry->FirstUnreadRegister = it - entry->Registers.begin();
+                    break;
+                }
+            }
+        }
+        Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+    }
 }
 
 void TSerialClientRegisterPoller::ClosedPortCycle(steady_clock::time_point currentTime, TRegisterCallback callback)
@@ -125,17 +450,21 @@ void TSerialClientRegisterPoller::ClosedPortCycle(steady_clock::time_point curre
 
     TClosedPortRegisterReader reader;
     do {
-        reader.ClearRegisters();
+        reader.ClearEntries();
         Scheduler.AccumulateNext(currentTime, reader);
-        for (auto& reg: reader.GetRegisters()) {
-            reg->SetError(TRegister::TError::ReadError);
-            if (callback) {
-                callback(reg);
+        for (auto& entry: reader.GetEntries()) {
+            for (auto& reg: entry->Registers) {
+                reg->SetError(TRegister::TError::ReadError);
+                if (callback) {
+                    callback(reg);
+                }
+            }
+            ScheduleNextPoll(entry, currentTime);
+            for (auto& reg: entry->Registers) {
+                reg->Device()->SetTransferResult(false);
             }
-            ScheduleNextPoll(reg, currentTime);
-            reg->Device()->SetTransferResult(false);
         }
-    } while (!reader.GetRegisters().empty());
+    } while (!reader.GetEntries().empty());
 }
 
 TPollResult TSerialClientRegisterPoller::OpenPortCycle(TPort& port,
@@ -143,20 +472,28 @@ TPollResult TSerialClientRegisterPoller::OpenPortCycle(TPort& port,
                                                        std::chrono::milliseconds maxPollingTime,
                                                        bool readAtLeastOneRegister,
                                                        TSerialClientDeviceAccessHandler& lastAccessedDevice,
-                                                       TRegisterCallback callback)
+                                                       TRegisterCallback callback,
+                                                       bool writesPending,
+                                                       int wakeupFd)
 {
     TPollResult res;
 
-    TRegisterReader reader(maxPollingTime, readAtLeastOneRegister);
+    TRegisterReader reader(ReadRanges,
+                           ReadEntries,
+                           maxPollingTime,
+                           readAtLeastOneRegister,
+                           MaxRequestsInFlight,
+                           MaxRangePollTime,
+                           writesPending ? PendingWritesMaxRangePollTime : milliseconds::max());
 
     auto throttlingState = Scheduler.AccumulateNext(spentTime.GetStartTime(), reader);
     auto throttlingMsg = ThrottlingStateLogger.GetMessage(throttlingState);
     if (!throttlingMsg.empty()) {
         LOG(Warn) << port.GetDescription() << " " << throttlingMsg;
     }
-    auto range = reader.GetRegisterRange();
+    const auto& ranges = reader.GetRegisterRanges();
 
-    if (!range) {
+    if (ranges.empty()) {
         // Nothing to read
         res.Deadline =
             Scheduler.IsEmpty() ? spentTime.GetStartTime() + 1s : Scheduler.GetDeadline(spentTime.GetStartTime());
@@ -164,7 +501,7 @@ TPollResult TSerialClientRegisterPoller::OpenPortCycle(TPort& port,
     }
 
     // There are registers waiting read, but they don't fit in allowed poll limit
-    if (range->RegisterList().empty()) {
+    if (ranges.front()->RegisterList().empty()) {
         res.NotEnoughTime = true;
         if (reader.GetPriority() == TPriority::High) {
             // High priority registers are limited by maxPollingTime
@@ -176,24 +513,55 @@ TPollResult TSerialClientRegisterPoller::OpenPortCycle(TPort& port,
         return res;
     }
 
-    auto device = range->RegisterList().front()->Device();
+    auto device = ranges.front()->RegisterList().front()->Device();
+    if (PiggybackWindow != milliseconds::zero()) {
+        AddDueSoonEntries(reader, device, spentTime.GetStartTime());
+    }
     bool deviceWasConnected = !device->GetIsDisconnected();
 
+    // Nothing is sent in the cycle yet, so a write or RPC request can go first. While writes keep coming,
+    // reads aren't postponed, they are limited to let writes in between them
+    if (!writesPending && !port.SleepSinceLastInteractionOrWakeup(device->DeviceConfig()->RequestDelay, wakeupFd)) {
+        PostponeEntries(reader.GetEntries(), ranges);
+        res.Deadline = spentTime.GetStartTime();
+        return res;
+    }
+
     bool readOk = false;
     if (lastAccessedDevice.PrepareToAccess(device)) {
-        device->ReadRegisterRange(range);
+        if (ranges.size() == 1) {
+            device->ReadRegisterRange(ranges.front());
+        } else {
+            device->ReadRegisterRanges(ranges, MaxRequestsInFlight);
+        }
         readOk = true;
     }
 
-    for (auto& reg: range->RegisterList()) {
-        reg->SetLastPollTime(spentTime.GetStartTime());
-        if (!readOk) {
-            reg->SetError(TRegister::TError::ReadError);
+    for (auto& range: ranges) {
+        for (auto& reg: range->RegisterList()) {
+            reg->SetLastPollTime(spentTime.GetStartTime());
+            if (!readOk) {
+                reg->SetError(TRegister::TError::ReadError);
+            }
+            if (callback) {
+                callback(reg);
+            }
         }
-        if (callback) {
-            callback(reg);
+    }
+
+    bool rebuildReadPlan = false;
+    for (auto& entry: reader.GetEntries()) {
+        // The rest of the entry is read in the next cycle, statistics and the next poll wait for it
+        if (entry->FirstUnreadRegister != 0) {
+            Scheduler.AddEntry(entry, entry->Deadline, entry->Priority, static_cast<size_t>(entry->PollClass));
+            continue;
+        }
+        if (PollStatistics) {
+            auto latency = std::max(ceil<microseconds>(spentTime.GetStartTime() - entry->Deadline), 0us);
+            PollStatistics->AddReadLatency(entry->PollClass, latency);
         }
-        ScheduleNextPoll(reg, spentTime.GetStartTime());
+        ScheduleNextPoll(entry, spentTime.GetStartTime());
+        rebuildReadPlan = rebuildReadPlan || ReadPlan.NeedsRebuild(*entry);
     }
 
     if (deviceWasConnected && device->GetIsDisconnected()) {
@@ -201,6 +569,27 @@ TPollResult TSerialClientRegisterPoller::OpenPortCycle(TPort& port,
         if (DeviceDisconnectedCallback) {
             DeviceDisconnectedCallback(device);
         }
+    } else if (rebuildReadPlan) {
+        RebuildReadPlan(device, spentTime.GetStartTime());
+    }
+
+    auto disconnectedDevice = DisconnectedDevices.find(device);
+    if (disconnectedDevice != DisconnectedDevices.end()) {
+        if (PollStatistics) {
+            // Without probing all entries of the device would be read and fail instead of one
+            auto otherEntriesCount = static_cast<int>(ReadPlan.GetEntries(device).size()) - 1;
+            PollStatistics->AddDisconnectedDeviceProbe(ceil<microseconds>(spentTime.GetSpentTime()) *
+                                                       std::max(otherEntriesCount, 0));
+        }
+        if (device->GetIsDisconnected()) {
+            auto& state = disconnectedDevice->second;
+            state.ProbeInterval = std::min(state.ProbeInterval * 2, std::max(MaxProbeInterval, MIN_PROBE_INTERVAL));
+            ScheduleProbe(state, spentTime.GetStartTime());
+        } else {
+            StopProbing(device, spentTime.GetStartTime());
+        }
+    } else if (MaxProbeInterval != milliseconds::zero() && device->GetIsDisconnected()) {
+        StartProbing(device, spentTime.GetStartTime(), callback);
     }
 
     Scheduler.UpdateSelectionTime(ceil<milliseconds>(spentTime.GetSpentTime()), reader.GetPriority());
@@ -212,40 +601,116 @@ TPollResult TSerialClientRegisterPoller::OpenPortCycle(TPort& port,
 void TSerialClientRegisterPoller::DeviceDisconnected(PSerialDevice device,
                                                      std::chrono::steady_clock::time_point currentTime)
 {
-    for (auto& reg: RegList) {
-        if (reg->Device() == device) {
-            bool wasExcludedFromPolling = reg->IsExcludedFromPolling();
+    // Entries excluded from polling or waiting for events safety poll are scheduled as usual
+    std::vector<PReadPlanEntry> excludedEntries;
+    if (!DisconnectedDevices.count(device)) {
+        for (const auto& entry: ReadPlan.GetEntries(device)) {
+            if (std::all_of(entry->Registers.begin(), entry->Registers.end(), [](const PRegister& reg) {
+                    return reg->IsExcludedFromPolling();
+                }))
+            {
+                excludedEntries.push_back(entry);
+            }
+        }
+    }
+    auto deviceRegisters = DeviceRegisters.find(device);
+    if (deviceRegisters != DeviceRegisters.end()) {
+        for (auto& reg: deviceRegisters->second) {
             reg->SetAvailable(TRegisterAvailability::UNKNOWN);
             reg->IncludeInPolling();
-            if (wasExcludedFromPolling && !Scheduler.Contains(reg)) {
-                ScheduleNextPoll(reg, currentTime);
-            }
         }
     }
+    for (const auto& entry: excludedEntries) {
+        Scheduler.Remove(entry);
+        ScheduleNextPoll(entry, currentTime);
+    }
+    if (ReadPlan.IsMerging()) {
+        RebuildReadPlan(device, currentTime);
+    }
 }
 
-void TSerialClientRegisterPoller::SetDeviceDisconnectedCallback(TDeviceCallback deviceDisconnectedCallback)
+void TSerialClientRegisterPoller::SetEventsReadFailed(bool failed, steady_clock::time_point currentTime)
 {
-    DeviceDisconnectedCallback = deviceDisconnectedCallback;
+    if (EventsReadFailed == failed) {
+        return;
+    }
+    EventsReadFailed = failed;
+    if (!failed || EventsSafetyPollPeriod == milliseconds::zero()) {
+        return;
+    }
+    LOG(Warn) << "Events reading failed, registers with events are polled as usual";
+    for (const auto& device: ReadPlan.GetDevices()) {
+        for (const auto& entry: ReadPlan.GetEntries(device)) {
+            if (IsCoveredByEvents(*entry) && Scheduler.UpdateDeadline(entry, currentTime)) {
+                entry->Deadline = currentTime;
+            }
+        }
+    }
 }
 
-bool TRegisterComparePredicate::operator()(const PRegister& r1, const PRegister& r2) const
+void TSerialClientRegisterPoller::WriteRegisterAndRead(TRegisterWrite& write,
+                                                       steady_clock::time_point currentTime,
+                                                       TRegisterCallback callback)
 {
-    if (r1->Device() != r2->Device()) {
-        return r1->Device()->DeviceConfig()->SlaveId > r2->Device()->DeviceConfig()->SlaveId;
+    auto device = write.Register->Device();
+    if (!device->SupportsWriteAndRead() || DisconnectedDevices.count(device)) {
+        return;
     }
-    if (r1->Type != r2->Type) {
-        return r1->Type > r2->Type;
+    PReadPlanEntry nextEntry;
+    for (const auto& entry: ReadPlan.GetEntries(device)) {
+        if (entry->Registers.front()->Type == write.Register->Type && !entry->WriteAndReadRejected &&
+            Scheduler.Contains(entry) && (!nextEntry || entry->Deadline < nextEntry->Deadline))
+        {
+            nextEntry = entry;
+        }
     }
-    auto cmp = r1->GetAddress().Compare(r2->GetAddress());
-    if (cmp < 0) {
-        return false;
+    if (!nextEntry) {
+        return;
     }
-    if (cmp > 0) {
-        return true;
+    auto range = device->CreateRegisterRange();
+    for (const auto& reg: nextEntry->Registers) {
+        if (!range->Add(reg, milliseconds::max())) {
+            return;
+        }
+    }
+    try {
+        device->WriteRegisterAndReadRange(write, range);
+    } catch (const TSerialDevicePermanentRegisterException& e) {
+        nextEntry->WriteAndReadRejected = true;
+        if (ReadPlan.NeedsRebuild(*nextEntry)) {
+            RebuildReadPlan(device, currentTime);
+        }
+        return;
+    }
+    if (!write.Done) {
+        return;
+    }
+
+    Scheduler.Remove(nextEntry);
+    for (auto& reg: range->RegisterList()) {
+        reg->SetLastPollTime(currentTime);
+        if (callback) {
+            callback(reg);
+        }
+    }
+    if (PollStatistics) {
+        auto latency = std::max(ceil<microseconds>(currentTime - nextEntry->Deadline), 0us);
+        PollStatistics->AddReadLatency(nextEntry->PollClass, latency);
+    }
+    ScheduleNextPoll(nextEntry, currentTime);
+    if (ReadPlan.NeedsRebuild(*nextEntry)) {
+        RebuildReadPlan(device, currentTime);
     }
-    // addresses are equal, compare offsets
-    return r1->GetDataOffset() > r2->GetDataOffset();
+}
+
+void TSerialClientRegisterPoller::SetDeviceDisconnectedCallback(TDeviceCallback deviceDisconnectedCallback)
+{
+    DeviceDisconnectedCallback = deviceDisconnectedCallback;
+}
+
+void TSerialClientRegisterPoller::SetPollStatistics(PPollStatistics statistics)
+{
+    PollStatistics = statistics;
 }
 
 TThrottlingStateLogger::TThrottlingStateLogger(): FirstTime(true)
@@ -1,17 +1,26 @@
 #pragma once
 
+#include <random>
+#include <unordered_map>
+#include <vector>
+
 #include "poll_plan.h"
+#include "poll_statistics.h"
 #include "port.h"
+#include "read_plan.h"
 #include "register.h"
 #include "serial_client_device_access_handler.h"
+#include "serial_client_settings.h"
 
 class TSerialDevice;
 typedef std::shared_ptr<TSerialDevice> PSerialDevice;
+struct TRegisterWrite;
 
-struct TRegisterComparePredicate
-{
-    bool operator()(const PRegister& r1, const PRegister& r2) const;
-};
+#ifdef WB_MQTT_SERIAL_TIMING_WHEEL_SCHEDULER
+typedef TScheduler<PReadPlanEntry, TReadPlanEntryComparePredicate, TTimingWheelSchedule> TRegisterScheduler;
+#else
+typedef TScheduler<PReadPlanEntry, TReadPlanEntryComparePredicate> TRegisterScheduler;
+#endif
 
 class TThrottlingStateLogger
 {
@@ -36,27 +45,107 @@ public:
     typedef std::function<void(PRegister reg)> TRegisterCallback;
     typedef std::function<void(PSerialDevice dev)> TDeviceCallback;
 
-    TSerialClientRegisterPoller(size_t lowPriorityRateLimit = std::numeric_limits<size_t>::max());
+    TSerialClientRegisterPoller(size_t lowPriorityRateLimit = std::numeric_limits<size_t>::max(),
+                                const TSerialClientSettings& settings = TSerialClientSettings());
 
     void PrepareRegisterRanges(const std::list<PRegister>& regList, std::chrono::steady_clock::time_point currentTime);
     void ClosedPortCycle(std::chrono::steady_clock::time_point currentTime, TRegisterCallback callback);
+
+    /**
+     * @brief Read registers of the device with the nearest deadline.
+     *        While writesPending is set, ranges are limited by pending_writes_latency_target_ms.
+     *        A planned entry which doesn't fit the limit is read by parts. The rest of the entry keeps its deadline,
+     *        so it is read first in the next cycle after pending writes are flushed. The entry's next poll is
+     *        scheduled only after its last part is read. Polling suspension of a disconnected device or rebuilding
+     *        of the plan start the entry from the beginning.
+     *        If writes are not pending, the guard interval before the first request is cut short when wakeupFd
+     *        becomes readable. Nothing is read then and the entries keep their deadlines.
+     */
     TPollResult OpenPortCycle(TPort& port,
                               const util::TSpentTimeMeter& spentTime,
                               std::chrono::milliseconds maxPollingTime,
                               bool readAtLeastOneRegister,
                               TSerialClientDeviceAccessHandler& lastAccessedDevice,
-                              TRegisterCallback callback);
+                              TRegisterCallback callback,
+                              bool writesPending = false,
+                              int wakeupFd = -1);
     void SetDeviceDisconnectedCallback(TDeviceCallback callback);
+    void SetPollStatistics(PPollStatistics statistics);
     void DeviceDisconnected(PSerialDevice device, std::chrono::steady_clock::time_point currentTime);
 
+    /**
+     * @brief Registers with enabled events are polled as usual while events reading fails
+     *        and with EventsSafetyPollPeriod after successful reading
+     */
+    void SetEventsReadFailed(bool failed, std::chrono::steady_clock::time_point currentTime);
+
+    /**
+     * @brief Write the value by one request with the nearest due read of registers of the same type
+     *        if the device supports it. The read is scheduled as a usual poll
+     */
+    void WriteRegisterAndRead(TRegisterWrite& write,
+                              std::chrono::steady_clock::time_point currentTime,
+                              TRegisterCallback callback);
+
 private:
-    void ScheduleNextPoll(PRegister reg, std::chrono::steady_clock::time_point pollStartTime);
+    void ScheduleNextPoll(PReadPlanEntry entry, std::chrono::steady_clock::time_point pollStartTime);
+
+    //! Returns entries of ranges, which are not read, to the schedule with their deadlines
+    void PostponeEntries(const std::vector<PReadPlanEntry>& entries, const std::vector<PRegisterRange>& ranges);
+    void RebuildReadPlan(PSerialDevice device, std::chrono::steady_clock::time_point currentTime);
+
+    //! Moves registers of the device, which are due within PiggybackWindow, to the range being read,
+    //! if it doesn't make reading longer
+    template<class TReader>
+    void AddDueSoonEntries(TReader& reader, PSerialDevice device, std::chrono::steady_clock::time_point currentTime);
+
+    struct TDisconnectedDevice
+    {
+        //! The only entry of the device being polled
+        PReadPlanEntry ProbeEntry;
+        std::chrono::milliseconds ProbeInterval;
+    };
 
-    std::list<PRegister> RegList;
+    void StartProbing(PSerialDevice device,
+                      std::chrono::steady_clock::time_point currentTime,
+                      TRegisterCallback callback);
+    void StopProbing(PSerialDevice device, std::chrono::steady_clock::time_point currentTime);
+    void SuspendPolling(PSerialDevice device, TDisconnectedDevice& state);
+    void ScheduleProbe(TDisconnectedDevice& state, std::chrono::steady_clock::time_point currentTime);
+
+    //! Registers of every device in the order of the port's register list
+    std::unordered_map<PSerialDevice, std::vector<PRegister>> DeviceRegisters;
+
+    TReadPlan ReadPlan;
 
     TDeviceCallback DeviceDisconnectedCallback;
 
-    TScheduler<PRegister, TRegisterComparePredicate> Scheduler;
+    TRegisterScheduler Scheduler;
 
     TThrottlingStateLogger ThrottlingStateLogger;
+
+    bool SpreadReadPeriods;
+
+    std::chrono::milliseconds PiggybackWindow;
+
+    std::chrono::milliseconds MaxProbeInterval;
+    std::unordered_map<PSerialDevice, TDisconnectedDevice> DisconnectedDevices;
+    std::minstd_rand ProbeJitterGenerator;
+
+    size_t MaxRequestsInFlight;
+
+    std::chrono::milliseconds EventsSafetyPollPeriod;
+    bool EventsReadFailed = false;
+
+    //! Maximum read time of a range with more than one register
+    std::chrono::milliseconds MaxRangePollTime;
+
+    //! Maximum read time of a range with more than one register while writes are waiting
+    std::chrono::milliseconds PendingWritesMaxRangePollTime;
+
+    //! Ranges and entries of a cycle. They are kept between cycles, so vectors are not allocated every cycle
+    std::vector<PRegisterRange> ReadRanges;
+    std::vector<PReadPlanEntry> ReadEntries;
+
+    PPollStatistics PollStatistics;
 };
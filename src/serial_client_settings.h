@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+//! Port polling settings, which are set in port config and passed to TSerialClient
+struct TSerialClientSettings
+{
+    //! Poll registers by precomputed per-device read plans instead of per-register scheduling
+    bool UseReadPlan = false;
+
+    //! Spread first reads of high priority registers with the same read period over the period
+    bool SpreadReadPeriods = false;
+
+    //! Registers due within the window are read together with already scheduled ones if it doesn't make
+    //! the request longer. Zero disables such reads
+    std::chrono::milliseconds PiggybackWindow = std::chrono::milliseconds::zero();
+
+    //! Disconnected devices are polled by a single register with exponentially growing interval up to the value.
+    //! Zero disables such polling and all registers of disconnected devices are polled as usual
+    std::chrono::milliseconds MaxProbeInterval = std::chrono::milliseconds::zero();
+
+    //! Maximum number of read requests sent to a Modbus TCP device without waiting for responses.
+    //! Every request reads its own register range
+    size_t MaxRequestsInFlight = 1;
+
+    //! Register ranges are split to be read not longer than the time, so writes don't wait for long reads.
+    //! The first register of a range is read anyway. Zero disables splitting
+    std::chrono::milliseconds WriteLatencyTarget = std::chrono::milliseconds::zero();
+
+    //! The same as WriteLatencyTarget, but ranges are split only while values keep coming,
+    //! i.e. a value was set since the previous read. Zero disables splitting
+    std::chrono::milliseconds PendingWritesLatencyTarget = std::chrono::milliseconds::zero();
+
+    //! Period of events reading while devices report events. Zero - the period depends on port's speed
+    std::chrono::milliseconds MinReadEventsPeriod = std::chrono::milliseconds::zero();
+
+    //! Period of events reading is increased up to the value while there are no events.
+    //! It is limited by minimal read period of registers with events. Zero disables adaptation
+    std::chrono::milliseconds MaxReadEventsPeriod = std::chrono::milliseconds::zero();
+
+    //! Registers with enabled events are read with the period to check events delivery.
+    //! Zero disables reading of such registers
+    std::chrono::milliseconds EventsSafetyPollPeriod = std::chrono::milliseconds::zero();
+
+    //! Increase read rate limits of low priority registers if they don't fit bus capacity
+    bool StretchLowPriorityRateLimits = false;
+
+    //! Maximum number of low priority registers read at once after idle time, 0 - equal to rate limit
+    size_t LowPriorityBurstSize = 0;
+};
@@ -2,6 +2,7 @@
 #include "file_utils.h"
 #include "log.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <dirent.h>
 #include <fstream>
@@ -191,6 +192,27 @@ namespace
         return std::make_optional(res);
     }
 
+    //! Poll classes share bus time left from registers with read period, so they are not set for such registers
+    TRegisterConfig::EPollClass GetPollClass(const Json::Value& data, const std::string& errorMsgPrefix)
+    {
+        if (data.isMember("poll_class")) {
+            auto name = data["poll_class"].asString();
+            for (size_t i = 0; i < POLL_CLASS_COUNT; ++i) {
+                auto pollClass = static_cast<TRegisterConfig::EPollClass>(i);
+                if (name == GetPollClassName(pollClass)) {
+                    if (GetReadPeriod(data) && pollClass != TRegisterConfig::EPollClass::NORMAL) {
+                        LOG(Warn) << errorMsgPrefix << " poll_class \"" << name
+                                  << "\" is ignored, because read_period_ms is set";
+                        return TRegisterConfig::EPollClass::NORMAL;
+                    }
+                    return pollClass;
+                }
+            }
+            throw TConfigParserException("invalid poll_class: '" + name + "'");
+        }
+        return TRegisterConfig::EPollClass::NORMAL;
+    }
+
     struct TLoadingContext
     {
         // Full path to loaded item composed from device and channels names
@@ -288,6 +310,7 @@ namespace
 
         res.RegisterConfig->ReadRateLimit = GetReadRateLimit(register_data);
         res.RegisterConfig->ReadPeriod = GetReadPeriod(register_data);
+        res.RegisterConfig->PollClass = GetPollClass(register_data, readonly_override_error_message_prefix);
         return res;
     }
 
@@ -375,12 +398,14 @@ namespace
 
             auto read_rate_limit_ms = GetReadRateLimit(channel_data);
             auto read_period = GetReadPeriod(channel_data);
+            auto poll_class = GetPollClass(channel_data, errorMsgPrefix);
 
             const Json::Value& reg_data = channel_data["consists_of"];
             for (Json::ArrayIndex i = 0; i < reg_data.size(); ++i) {
                 auto reg = LoadRegisterConfig(reg_data[i], *device_config, errorMsgPrefix, context);
                 reg.RegisterConfig->ReadRateLimit = read_rate_limit_ms;
                 reg.RegisterConfig->ReadPeriod = read_period;
+                reg.RegisterConfig->PollClass = poll_class;
                 registers.push_back(reg.RegisterConfig);
                 if (!i)
                     default_type_str = reg.DefaultControlType;
@@ -578,7 +603,16 @@ namespace
         }
     }
 
-    void LoadDevice(PPortConfig port_config,
+    size_t GetChannelsCount(const TPortConfig& portConfig)
+    {
+        size_t res = 0;
+        for (const auto& device: portConfig.Devices) {
+            res += device->DeviceConfig()->DeviceChannelConfigs.size();
+        }
+        return res;
+    }
+
+    void LoadDevice(const std::vector<PPortConfig>& port_configs,
                     const Json::Value& device_data,
                     const std::string& default_id,
                     TTemplateMap& templates,
@@ -587,7 +621,19 @@ namespace
         if (device_data.isMember("enabled") && !device_data["enabled"].asBool())
             return;
 
-        port_config->AddDevice(deviceFactory.CreateDevice(device_data, default_id, port_config, templates));
+        // Devices are spread over port's connections one by one
+        size_t devicesCount = 0;
+        for (const auto& port_config: port_configs) {
+            devicesCount += port_config->Devices.size();
+        }
+        auto port_config = port_configs[devicesCount % port_configs.size()];
+        auto device = deviceFactory.CreateDevice(device_data, default_id, port_config, templates);
+        for (const auto& other_port_config: port_configs) {
+            if (other_port_config != port_config) {
+                other_port_config->CheckDuplicateDevice(device);
+            }
+        }
+        port_config->AddDevice(device);
     }
 
     PPort OpenSerialPort(const Json::Value& port_data, PRPCConfig rpcConfig)
@@ -642,13 +688,63 @@ namespace
         Get(port_data, "connection_timeout_ms", port_config->OpenCloseSettings.MaxFailTime);
         Get(port_data, "connection_max_fail_cycles", port_config->OpenCloseSettings.ConnectionMaxFailCycles);
 
+        Get(port_data, "enable_read_plan", port_config->ClientSettings.UseReadPlan);
+        Get(port_data, "spread_read_periods", port_config->ClientSettings.SpreadReadPeriods);
+        Get(port_data, "piggyback_window_ms", port_config->ClientSettings.PiggybackWindow);
+        Get(port_data, "max_probe_interval_ms", port_config->ClientSettings.MaxProbeInterval);
+        Get(port_data, "stretch_low_priority_rate_limits", port_config->ClientSettings.StretchLowPriorityRateLimits);
+        size_t lowPriorityRateLimit;
+        if (Get(port_data, "low_priority_rate_limit", lowPriorityRateLimit)) {
+            port_config->LowPriorityRegistersRateLimit = lowPriorityRateLimit;
+        }
+        Get(port_data, "low_priority_burst_size", port_config->ClientSettings.LowPriorityBurstSize);
+        Get(port_data, "write_latency_target_ms", port_config->ClientSettings.WriteLatencyTarget);
+        Get(port_data, "pending_writes_latency_target_ms", port_config->ClientSettings.PendingWritesLatencyTarget);
+        Get(port_data, "min_read_events_period_ms", port_config->ClientSettings.MinReadEventsPeriod);
+        Get(port_data, "max_read_events_period_ms", port_config->ClientSettings.MaxReadEventsPeriod);
+        Get(port_data, "events_safety_poll_period_ms", port_config->ClientSettings.EventsSafetyPollPeriod);
+
         std::tie(port_config->Port, port_config->IsModbusTcp) = portFactory(port_data, rpcConfig);
+        size_t connectionPoolSize = 1;
+        if (port_config->IsModbusTcp) {
+            Get(port_data, "max_requests_in_flight", port_config->ClientSettings.MaxRequestsInFlight);
+            Get(port_data, "connection_pool_size", connectionPoolSize);
+        }
+
+        // Every additional connection to the same endpoint is polled by its own serial client.
+        // Connections are available for RPC requests through the port's RPC port
+        std::vector<PPortConfig> port_configs{port_config};
+        if (connectionPoolSize > 1) {
+            for (size_t i = 1; i < connectionPoolSize; ++i) {
+                auto connection_config = make_shared<TPortConfig>(*port_config);
+                connection_config->Port = portFactory(port_data, make_shared<TRPCConfig>()).first;
+                rpcConfig->AddConnection(port_config->Port, connection_config->Port);
+                port_configs.push_back(connection_config);
+            }
+        }
 
         const Json::Value& array = port_data["devices"];
         for (Json::Value::ArrayIndex index = 0; index < array.size(); ++index)
-            LoadDevice(port_config, array[index], id_prefix + std::to_string(index), templates, deviceFactory);
+            LoadDevice(port_configs, array[index], id_prefix + std::to_string(index), templates, deviceFactory);
+
+        // Port's limit is shared by connections in proportion to their channels, as the global limit is shared
+        // by ports, see GetLowPriorityRegistersRateLimit
+        if (port_configs.size() > 1 && port_config->LowPriorityRegistersRateLimit) {
+            auto rateLimit = *port_config->LowPriorityRegistersRateLimit;
+            size_t channelsCount = 0;
+            for (const auto& config: port_configs) {
+                channelsCount += GetChannelsCount(*config);
+            }
+            for (const auto& config: port_configs) {
+                auto connectionRateLimit = (channelsCount != 0) ? rateLimit * GetChannelsCount(*config) / channelsCount
+                                                                : rateLimit / port_configs.size();
+                config->LowPriorityRegistersRateLimit = std::max(connectionRateLimit, size_t(1));
+            }
+        }
 
-        handlerConfig->AddPortConfig(port_config);
+        for (const auto& config: port_configs) {
+            handlerConfig->AddPortConfig(config);
+        }
     }
 
     void CheckNesting(const Json::Value& root, size_t nestingLevel, ITemplateMap& templates)
@@ -1003,7 +1099,12 @@ PHandlerConfig LoadConfig(const std::string& configFileName,
 
 void TPortConfig::AddDevice(PSerialDevice device)
 {
-    // try to find duplicate of this device
+    CheckDuplicateDevice(device);
+    Devices.push_back(device);
+}
+
+void TPortConfig::CheckDuplicateDevice(PSerialDevice device) const
+{
     for (auto dev: Devices) {
         if (dev->Protocol() == device->Protocol()) {
             if (dev->Protocol()->IsSameSlaveId(dev->DeviceConfig()->SlaveId, device->DeviceConfig()->SlaveId)) {
@@ -1014,8 +1115,6 @@ void TPortConfig::AddDevice(PSerialDevice device)
             }
         }
     }
-
-    Devices.push_back(device);
 }
 
 TDeviceChannelConfig::TDeviceChannelConfig(const std::string& type,
@@ -1139,6 +1238,32 @@ void THandlerConfig::AddPortConfig(PPortConfig portConfig)
     PortConfigs.push_back(portConfig);
 }
 
+namespace
+{
+    size_t GetChannelsCount(const THandlerConfig& config)
+    {
+        size_t res = 0;
+        for (const auto& portConfig: config.PortConfigs) {
+            res += GetChannelsCount(*portConfig);
+        }
+        return res;
+    }
+}
+
+size_t GetLowPriorityRegistersRateLimit(const THandlerConfig& config, const TPortConfig& portConfig)
+{
+    if (portConfig.LowPriorityRegistersRateLimit) {
+        return *portConfig.LowPriorityRegistersRateLimit;
+    }
+    auto rateLimit = config.LowPriorityRegistersRateLimit;
+    size_t totalChannels = GetChannelsCount(config);
+    if (totalChannels != 0) {
+        rateLimit *= GetChannelsCount(portConfig);
+        rateLimit /= totalChannels;
+    }
+    return std::max(rateLimit, size_t(1));
+}
+
 TConfigParserException::TConfigParserException(const std::string& message)
     : std::runtime_error("Error parsing config file: " + message)
 {}
@@ -13,6 +13,7 @@
 
 #include "port.h"
 #include "rpc_config.h"
+#include "serial_client_settings.h"
 #include "serial_device.h"
 
 struct TDeviceTemplate
@@ -108,6 +109,10 @@ struct TPortConfig
     std::optional<std::chrono::milliseconds> ReadRateLimit;
     std::chrono::microseconds RequestDelay = std::chrono::microseconds::zero();
     TPortOpenCloseLogic::TSettings OpenCloseSettings;
+    TSerialClientSettings ClientSettings;
+
+    //! Maximum low priority registers reads per second. If not set, a share of global rate limit is used
+    std::optional<size_t> LowPriorityRegistersRateLimit;
 
     /**
      * @brief Maximum allowed time from request to response for any device connected to the port.
@@ -119,6 +124,9 @@ struct TPortConfig
     bool IsModbusTcp = false;
 
     void AddDevice(PSerialDevice device);
+
+    //! Throws TConfigParserException if the port already has a device with the same protocol and slave id
+    void CheckDuplicateDevice(PSerialDevice device) const;
 };
 
 typedef std::shared_ptr<TPortConfig> PPortConfig;
@@ -135,6 +143,10 @@ struct THandlerConfig
 
 typedef std::shared_ptr<THandlerConfig> PHandlerConfig;
 
+//! Port's share of global low priority registers rate limit or port's own limit if it is set.
+//! Every connection of a connection pool has its own port config, so the global limit is shared by connections too
+size_t GetLowPriorityRegistersRateLimit(const THandlerConfig& config, const TPortConfig& portConfig);
+
 class TConfigParserException: public std::runtime_error
 {
 public:
@@ -1,6 +1,7 @@
 #include "serial_device.h"
 
 #include "log.h"
+#include <algorithm>
 #include <iostream>
 #include <string.h>
 #include <unistd.h>
@@ -114,6 +115,27 @@ void TSerialDevice::WriteRegister(PRegister reg, uint64_t value)
     WriteRegister(reg, TRegisterValue{value});
 }
 
+void TSerialDevice::WriteRegisters(std::vector<TRegisterWrite>& writes)
+{
+    WriteRegistersImpl(writes);
+    if (std::any_of(writes.begin(), writes.end(), [](const auto& write) { return write.Done; })) {
+        SetTransferResult(true);
+    }
+}
+
+bool TSerialDevice::SupportsWriteAndRead() const
+{
+    return false;
+}
+
+void TSerialDevice::WriteRegisterAndReadRange(TRegisterWrite& write, PRegisterRange range)
+{
+    WriteRegisterAndReadRangeImpl(write, range);
+    if (write.Done) {
+        SetTransferResult(true);
+    }
+}
+
 TRegisterValue TSerialDevice::ReadRegisterImpl(PRegister reg)
 {
     throw TSerialDeviceException("single register reading is not supported");
@@ -124,6 +146,12 @@ void TSerialDevice::WriteRegisterImpl(PRegister reg, const TRegisterValue& value
     throw TSerialDeviceException(ToString() + ": register writing is not supported");
 }
 
+void TSerialDevice::WriteRegistersImpl(std::vector<TRegisterWrite>& writes)
+{}
+
+void TSerialDevice::WriteRegisterAndReadRangeImpl(TRegisterWrite& write, PRegisterRange range)
+{}
+
 void TSerialDevice::ReadRegisterRange(PRegisterRange range)
 {
     for (auto& reg: range->RegisterList()) {
@@ -156,6 +184,13 @@ void TSerialDevice::ReadRegisterRange(PRegisterRange range)
     InvalidateReadCache();
 }
 
+void TSerialDevice::ReadRegisterRanges(const std::vector<PRegisterRange>& ranges, size_t maxRequestsInFlight)
+{
+    for (const auto& range: ranges) {
+        ReadRegisterRange(range);
+    }
+}
+
 void TSerialDevice::SetTransferResult(bool ok)
 {
     // disable reconnect functionality option
@@ -162,6 +162,14 @@ struct TUInt32SlaveId
     bool operator==(const TUInt32SlaveId& id) const;
 };
 
+//! Value to be written to a register. Done is set if the value is written
+struct TRegisterWrite
+{
+    PRegister Register;
+    TRegisterValue Value;
+    bool Done = false;
+};
+
 class TSerialDevice: public std::enable_shared_from_this<TSerialDevice>
 {
 public:
@@ -187,9 +195,24 @@ public:
 
     void WriteRegister(PRegister reg, uint64_t value);
 
+    // Write values of several registers by combined requests if the device supports it.
+    // Not written registers must be written one by one
+    void WriteRegisters(std::vector<TRegisterWrite>& writes);
+
+    // Write the value and read the range by one request if the device supports it.
+    // The write is marked as done on success, otherwise writing and reading must be done separately.
+    // TSerialDevicePermanentRegisterException is thrown if the device rejects the range or the register
+    void WriteRegisterAndReadRange(TRegisterWrite& write, PRegisterRange range);
+
+    // The device can write a value and read a range by one request
+    virtual bool SupportsWriteAndRead() const;
+
     // Read multiple registers
     virtual void ReadRegisterRange(PRegisterRange range);
 
+    // Read several ranges. Devices supporting it send up to maxRequestsInFlight requests without waiting for responses
+    virtual void ReadRegisterRanges(const std::vector<PRegisterRange>& ranges, size_t maxRequestsInFlight);
+
     virtual std::string ToString() const;
 
     // Initialize setup items' registers
@@ -214,6 +237,8 @@ protected:
     virtual void PrepareImpl();
     virtual TRegisterValue ReadRegisterImpl(PRegister reg);
     virtual void WriteRegisterImpl(PRegister reg, const TRegisterValue& value);
+    virtual void WriteRegistersImpl(std::vector<TRegisterWrite>& writes);
+    virtual void WriteRegisterAndReadRangeImpl(TRegisterWrite& write, PRegisterRange range);
     virtual void WriteSetupRegisters();
 
 private:
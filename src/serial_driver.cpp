@@ -11,40 +11,11 @@ using namespace WBMQTT;
 
 #define LOG(logger) ::logger.Log() << "[serial] "
 
-namespace
-{
-    size_t GetChannelsCount(PPortConfig portConfig)
-    {
-        size_t res = 0;
-        for (const auto& device: portConfig->Devices) {
-            res += device->DeviceConfig()->DeviceChannelConfigs.size();
-        }
-        return res;
-    }
-
-    size_t GetChannelsCount(PHandlerConfig config)
-    {
-        size_t res = 0;
-        for (const auto& portConfig: config->PortConfigs) {
-            res += GetChannelsCount(portConfig);
-        }
-        return res;
-    }
-}
-
 TMQTTSerialDriver::TMQTTSerialDriver(PDeviceDriver mqttDriver, PHandlerConfig config): Active(false)
 {
     try {
-        size_t totalChannels = GetChannelsCount(config);
         for (const auto& portConfig: config->PortConfigs) {
-            auto rateLimit = config->LowPriorityRegistersRateLimit;
-            if (totalChannels != 0) {
-                rateLimit *= GetChannelsCount(portConfig);
-                rateLimit /= totalChannels;
-            }
-            if (rateLimit < 1) {
-                rateLimit = 1;
-            }
+            auto rateLimit = GetLowPriorityRegistersRateLimit(*config, *portConfig);
             PortDrivers.push_back(
                 make_shared<TSerialPortDriver>(mqttDriver, portConfig, config->PublishParameters, rateLimit));
             PortDrivers.back()->SetUpDevices();
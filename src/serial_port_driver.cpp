@@ -28,7 +28,8 @@ TSerialPortDriver::TSerialPortDriver(WBMQTT::PDeviceDriver mqttDriver,
     SerialClient = PSerialClient(new TSerialClient(Config->Port,
                                                    Config->OpenCloseSettings,
                                                    std::chrono::steady_clock::now,
-                                                   lowPriorityRateLimit));
+                                                   lowPriorityRateLimit,
+                                                   Config->ClientSettings));
 }
 
 const std::string& TSerialPortDriver::GetShortDescription() const
@@ -74,6 +75,7 @@ void TSerialPortDriver::SetUpDevices()
         ClearDevices();
         throw;
     }
+    SerialClient->CheckBusLoad();
 }
 
 void TSerialPortDriver::HandleControlOnValueEvent(const WBMQTT::TControlOnValueEvent& event)
@@ -11,6 +11,7 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -65,11 +66,8 @@ void TTcpPort::Open()
             if (errno != EINPROGRESS) {
                 throw std::runtime_error("connect error: " + FormatErrno(errno));
             }
-            timeval tv = {CONNECTION_TIMEOUT_S, 0};
-            fd_set myset;
-            FD_ZERO(&myset);
-            FD_SET(Fd, &myset);
-            auto res = select(Fd + 1, NULL, &myset, NULL, &tv);
+            pollfd fd{Fd, POLLOUT, 0};
+            auto res = poll(&fd, 1, CONNECTION_TIMEOUT_S * 1000);
             if (res > 0) {
                 socklen_t lon = sizeof(int);
                 int valopt;
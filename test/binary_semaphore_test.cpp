@@ -0,0 +1,123 @@
+#include "binary_semaphore.h"
+#include "file_descriptor_port.h"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    //! File descriptor port connected to a socket, which isn't read
+    class TSocketPort: public TFileDescriptorPort
+    {
+        int PeerFd = -1;
+
+    public:
+        ~TSocketPort()
+        {
+            if (PeerFd >= 0) {
+                close(PeerFd);
+            }
+        }
+
+        void Open() override
+        {
+            int fds[2];
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+            Fd = fds[0];
+            PeerFd = fds[1];
+        }
+
+        std::string GetDescription(bool verbose = true) const override
+        {
+            return "<socket port>";
+        }
+    };
+
+    //! Signals the semaphore from another thread after a delay
+    class TDelayedSignal
+    {
+        std::thread Thread;
+
+    public:
+        TDelayedSignal(TBinarySemaphore& semaphore, PBinarySemaphoreSignal signal)
+        {
+            Thread = std::thread([&semaphore, signal]() {
+                std::this_thread::sleep_for(50ms);
+                semaphore.Signal(signal);
+            });
+        }
+
+        ~TDelayedSignal()
+        {
+            Thread.join();
+        }
+    };
+}
+
+TEST(TBinarySemaphoreTest, SignalWakesWait)
+{
+    TBinarySemaphore semaphore;
+    auto signal = semaphore.MakeSignal();
+    auto otherSignal = semaphore.MakeSignal();
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        TDelayedSignal delayedSignal(semaphore, signal);
+        EXPECT_TRUE(semaphore.Wait(start + 1h));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 10s);
+
+    // The signal is kept until it is read
+    EXPECT_TRUE(semaphore.Wait(std::chrono::steady_clock::now()));
+    EXPECT_FALSE(semaphore.GetSignalValue(otherSignal));
+    EXPECT_TRUE(semaphore.GetSignalValue(signal));
+    EXPECT_FALSE(semaphore.GetSignalValue(signal));
+}
+
+TEST(TBinarySemaphoreTest, WaitTimeout)
+{
+    TBinarySemaphore semaphore;
+    auto signal = semaphore.MakeSignal();
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(semaphore.Wait(start + 20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+
+    // Read signal doesn't wake waits anymore
+    semaphore.Signal(signal);
+    semaphore.Signal(signal);
+    EXPECT_TRUE(semaphore.GetSignalValue(signal));
+    EXPECT_FALSE(semaphore.Wait(std::chrono::steady_clock::now() + 1ms));
+}
+
+TEST(TBinarySemaphoreTest, SignalWakesPortSleep)
+{
+    TBinarySemaphore semaphore;
+    auto signal = semaphore.MakeSignal();
+    TSocketPort port;
+    port.Open();
+    uint8_t byte = 0;
+
+    port.WriteBytes(&byte, 1);
+    auto start = std::chrono::steady_clock::now();
+    {
+        TDelayedSignal delayedSignal(semaphore, signal);
+        EXPECT_FALSE(port.SleepSinceLastInteractionOrWakeup(1h, semaphore.GetFd()));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 10s);
+
+    // Pending signal doesn't let the port sleep
+    port.WriteBytes(&byte, 1);
+    EXPECT_FALSE(port.SleepSinceLastInteractionOrWakeup(1h, semaphore.GetFd()));
+
+    // Sleep isn't interrupted without signals
+    semaphore.GetSignalValue(signal);
+    port.WriteBytes(&byte, 1);
+    start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(port.SleepSinceLastInteractionOrWakeup(20ms, semaphore.GetFd()));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
@@ -0,0 +1,102 @@
+#include "bus_load.h"
+#include "poll_test_utils.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+class TBusLoadTest: public testing::Test
+{
+protected:
+    PPort Port;
+    TUint32SlaveIdProtocol Protocol{"test", TRegisterTypes({{0, "test", "value", U16}})};
+    std::shared_ptr<TPollTestDevice> Device;
+    TSerialClientSettings Settings;
+
+    void SetUp() override
+    {
+        Settings.UseReadPlan = true;
+        Port = std::make_shared<TPollTestPort>();
+        Device = std::make_shared<TPollTestDevice>(std::make_shared<TDeviceConfig>("test", "1", "test"),
+                                                   Port,
+                                                   &Protocol);
+        Device->RegisterPollTime = 10ms;
+    }
+};
+
+TEST_F(TBusLoadTest, Calculate)
+{
+    std::list<PRegister> regs;
+    // 2 requests of 40 and 20 ms every 200 ms
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr, 200ms));
+    }
+    // 10 ms every 100 ms
+    auto reg = Device->AddRegister(10);
+    reg->ReadRateLimit = 100ms;
+    regs.push_back(reg);
+    // 20 ms
+    regs.push_back(Device->AddRegister(20));
+    regs.push_back(Device->AddRegister(21));
+
+    auto report = CalculateBusLoad(regs, Settings);
+    ASSERT_EQ(report.Devices.size(), 1);
+    EXPECT_DOUBLE_EQ(report.Total.HighPriority, 0.3);
+    EXPECT_DOUBLE_EQ(report.Total.LowPriority, 0.1);
+    EXPECT_EQ(report.Total.LowPriorityCycleTime, 20ms);
+    EXPECT_EQ(report.Total.Requests, 4);
+    EXPECT_EQ(report.Total.UnestimatedRequests, 0);
+    EXPECT_TRUE(report.IsFeasible());
+
+    auto json = report.ToJson();
+    EXPECT_TRUE(json["feasible"].asBool());
+    EXPECT_EQ(json["devices"].size(), 1);
+    EXPECT_EQ(json["devices"][0]["requests"].asUInt(), 4);
+
+    EXPECT_EQ(StretchLowPriorityRateLimits(regs, report), 1);
+    EXPECT_EQ(*reg->ReadRateLimit, 100ms);
+}
+
+TEST_F(TBusLoadTest, Stretch)
+{
+    std::list<PRegister> regs{Device->AddRegister(1, 50ms)};
+    // 10 ms every 20 ms
+    auto reg = Device->AddRegister(10);
+    reg->ReadRateLimit = 20ms;
+    regs.push_back(reg);
+
+    auto report = CalculateBusLoad(regs, Settings);
+    EXPECT_DOUBLE_EQ(report.Total.HighPriority, 0.2);
+    EXPECT_DOUBLE_EQ(report.Total.LowPriority, 0.5);
+    EXPECT_TRUE(report.IsFeasible());
+
+    // High priority registers need 32% and low priority ones 80% of bus time
+    Device->RegisterPollTime = 16ms;
+    report = CalculateBusLoad(regs, Settings);
+    EXPECT_FALSE(report.IsFeasible());
+    EXPECT_DOUBLE_EQ(StretchLowPriorityRateLimits(regs, report), 0.8 / (0.9 - 0.32));
+    report = CalculateBusLoad(regs, Settings);
+    EXPECT_TRUE(report.IsFeasible());
+    EXPECT_EQ(*reg->ReadRateLimit, 28ms);
+    EXPECT_EQ(*regs.front()->ReadPeriod, 50ms);
+}
+
+TEST_F(TBusLoadTest, PlanSettings)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr, 200ms));
+    }
+
+    // Ranges are limited by write latency target as in serial client's read plan
+    Settings.WriteLatencyTarget = 20ms;
+    auto report = CalculateBusLoad(regs, Settings);
+    EXPECT_EQ(report.Total.Requests, 3);
+    EXPECT_DOUBLE_EQ(report.Total.HighPriority, 0.3);
+
+    // Without merging every register is a separate request
+    Settings.UseReadPlan = false;
+    report = CalculateBusLoad(regs, Settings);
+    EXPECT_EQ(report.Total.Requests, 6);
+    EXPECT_EQ(report.Total.UnestimatedRequests, 0);
+    EXPECT_DOUBLE_EQ(report.Total.HighPriority, 0.3);
+}
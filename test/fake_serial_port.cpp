@@ -175,6 +175,14 @@ TReadFrameResult TFakeSerialPort::ReadFrame(uint8_t* buf,
         throw std::runtime_error("TFakeSerialPort::ReadFrame: bad timeout: " + std::to_string(frameTimeout.count()) +
                                  " instead of " + std::to_string(ExpectedFrameTimeout.count()));
     }
+    // The boundary right after a response read to its end is not an empty response.
+    // It is left when responses to several requests are read without writes between them
+    if (RespPos > 0 && RespPos < Resp.size() && Resp[RespPos] == FRAME_BOUNDARY &&
+        Resp[RespPos - 1] != FRAME_BOUNDARY)
+    {
+        RespPos++;
+    }
+
     uint8_t* p = buf;
     for (; res.Count < count; ++res.Count) {
         if (RespPos == Resp.size())
@@ -0,0 +1,81 @@
+#include "devices/modbus_device.h"
+#include "fake_serial_port.h"
+#include "modbus_common.h"
+#include "poll_test_utils.h"
+
+using namespace std::chrono_literals;
+
+class TModbusAutoHolesTest: public TSerialDeviceTest
+{
+protected:
+    void SetUp() override
+    {
+        TSerialDeviceTest::SetUp();
+        // One byte per millisecond
+        SerialPort->SetBaudRate(11000);
+
+        TModbusDeviceConfig config;
+        config.CommonConfig = std::make_shared<TDeviceConfig>("modbus", "1", "modbus");
+        config.CommonConfig->MaxReadRegisters = 125;
+        Config = config.CommonConfig;
+        ModbusDev = std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                                    config,
+                                                    SerialPort,
+                                                    DeviceFactory.GetProtocol("modbus"));
+        // The device sets minimal frame timeout by baud rate, it doesn't matter here
+        Config->FrameTimeout = 0ms;
+    }
+
+    PRegister CreateRegister(uint32_t address)
+    {
+        auto reg = std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(Modbus::REG_HOLDING, address));
+        reg->SetAvailable(TRegisterAvailability::AVAILABLE);
+        return reg;
+    }
+
+    PDeviceConfig Config;
+    std::shared_ptr<TModbusDevice> ModbusDev;
+};
+
+TEST_F(TModbusAutoHolesTest, CostEffectiveHoles)
+{
+    // 13 service bytes and 20 ms response time against 2 ms of register's data
+    auto holes = Modbus::GetCostEffectiveHoles(*SerialPort, *Config, 20ms);
+    EXPECT_EQ(holes.Registers, 16);
+    EXPECT_EQ(holes.Bits, 264);
+
+    // Guard interval makes requests longer
+    Config->RequestDelay = 10ms;
+    holes = Modbus::GetCostEffectiveHoles(*SerialPort, *Config, 20ms);
+    EXPECT_EQ(holes.Registers, 21);
+
+    // Holes are limited by maximum request size
+    holes = Modbus::GetCostEffectiveHoles(*SerialPort, *Config, 1s);
+    EXPECT_EQ(holes.Registers, 125);
+    EXPECT_EQ(holes.Bits, 2000);
+
+    // Port doesn't estimate send time
+    TPollTestPort tcpPort;
+    holes = Modbus::GetCostEffectiveHoles(tcpPort, *Config, 20ms);
+    EXPECT_EQ(holes.Registers, 0);
+    EXPECT_EQ(holes.Bits, 0);
+}
+
+TEST_F(TModbusAutoHolesTest, Range)
+{
+    Modbus::THoles holes;
+    holes.Registers = 16;
+
+    Modbus::TModbusRegisterRange range(20ms);
+    range.SetAutoHoles(holes);
+    EXPECT_TRUE(range.Add(CreateRegister(1), 1h));
+    EXPECT_TRUE(range.Add(CreateRegister(18), 1h));
+    EXPECT_FALSE(range.Add(CreateRegister(36), 1h));
+
+    // Holes are disabled after errors
+    ModbusDev->SetSupportsHoles(false);
+    Modbus::TModbusRegisterRange otherRange(20ms);
+    otherRange.SetAutoHoles(holes);
+    EXPECT_TRUE(otherRange.Add(CreateRegister(1), 1h));
+    EXPECT_FALSE(otherRange.Add(CreateRegister(3), 1h));
+}
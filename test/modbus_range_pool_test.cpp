@@ -0,0 +1,254 @@
+#include "devices/modbus_device.h"
+#include "fake_serial_port.h"
+#include "modbus_common.h"
+#include "poll_test_utils.h"
+#include "serial_client_device_access_handler.h"
+#include "serial_client_events_reader.h"
+#include "serial_client_register_poller.h"
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace
+{
+    //! Allocations are counted only by the thread which has created TAllocationsCounter and only during its life
+    thread_local bool CountAllocations = false;
+    thread_local size_t AllocationsCount = 0;
+
+    class TAllocationsCounter
+    {
+    public:
+        TAllocationsCounter()
+        {
+            AllocationsCount = 0;
+            CountAllocations = true;
+        }
+
+        ~TAllocationsCounter()
+        {
+            CountAllocations = false;
+        }
+
+        size_t GetCount() const
+        {
+            return AllocationsCount;
+        }
+    };
+
+    //! Modbus TCP slave answering read holding registers requests by addresses of the registers without allocations
+    class TModbusTCPResponderPort: public TPollTestPort
+    {
+        // Maximum Modbus TCP ADU size
+        uint8_t Response[260];
+        size_t ResponseSize = 0;
+        size_t ResponsePos = 0;
+
+    public:
+        void WriteBytes(const uint8_t* buf, int count) override
+        {
+            // MBAP and function code are copied from the request
+            const int start = (buf[8] << 8) | buf[9];
+            const int wordsCount = (buf[10] << 8) | buf[11];
+            memcpy(Response, buf, 8);
+            Response[4] = 0;
+            Response[5] = 3 + wordsCount * 2;
+            Response[8] = wordsCount * 2;
+            for (int i = 0; i < wordsCount; ++i) {
+                Response[9 + i * 2] = (start + i) >> 8;
+                Response[10 + i * 2] = (start + i) & 0xFF;
+            }
+            ResponseSize = 9 + wordsCount * 2;
+            ResponsePos = 0;
+        }
+
+        TReadFrameResult ReadFrame(uint8_t* buf,
+                                   size_t count,
+                                   const std::chrono::microseconds& responseTimeout,
+                                   const std::chrono::microseconds& frameTimeout,
+                                   TFrameCompletePred frame_complete = 0) override
+        {
+            TReadFrameResult res;
+            res.Count = std::min(count, ResponseSize - ResponsePos);
+            memcpy(buf, Response + ResponsePos, res.Count);
+            ResponsePos += res.Count;
+            return res;
+        }
+    };
+}
+
+// The replacement behaves as the default operator new and only counts allocations inside of TAllocationsCounter.
+// Operators are not inlined, otherwise GCC reports free() of memory allocated by new
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    if (CountAllocations) {
+        ++AllocationsCount;
+    }
+    while (true) {
+        if (auto ptr = malloc(size ? size : 1)) {
+            return ptr;
+        }
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+class TModbusRangePoolTest: public TSerialDeviceTest
+{
+protected:
+    void SetUp() override
+    {
+        TSerialDeviceTest::SetUp();
+        Config = std::make_shared<TDeviceConfig>("modbus", "1", "modbus");
+        Config->MaxReadRegisters = 125;
+
+        TModbusDeviceConfig config;
+        config.CommonConfig = Config;
+        ModbusDev = std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                                    config,
+                                                    SerialPort,
+                                                    DeviceFactory.GetProtocol("modbus"));
+        for (int addr = 0; addr < 200; ++addr) {
+            Registers.push_back(
+                std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(Modbus::REG_HOLDING, addr)));
+        }
+    }
+
+    PDeviceConfig Config;
+    std::shared_ptr<TModbusDevice> ModbusDev;
+    std::vector<PRegister> Registers;
+    Modbus::TRegisterRangePool Pool;
+};
+
+TEST_F(TModbusRangePoolTest, ReuseRanges)
+{
+    auto range = Pool.Get(std::chrono::microseconds(100));
+    range->Add(Registers[0], std::chrono::hours(1));
+    auto rangePtr = range.get();
+
+    // The range is in use, so a new one is created
+    auto otherRange = Pool.Get(std::chrono::microseconds(100));
+    EXPECT_NE(otherRange.get(), rangePtr);
+
+    range.reset();
+    range = Pool.Get(std::chrono::microseconds(100));
+    EXPECT_EQ(range.get(), rangePtr);
+    EXPECT_TRUE(range->RegisterList().empty());
+}
+
+TEST_F(TModbusRangePoolTest, NoAllocationsInSteadyState)
+{
+    auto port = std::make_shared<TModbusTCPResponderPort>();
+    TModbusDeviceConfig modbusConfig;
+    modbusConfig.CommonConfig = Config;
+    auto traits = std::make_unique<Modbus::TModbusTCPTraits>(std::make_shared<uint16_t>(0));
+    auto device =
+        std::make_shared<TModbusDevice>(std::move(traits), modbusConfig, port, DeviceFactory.GetProtocol("modbus"));
+    std::list<PRegister> regList;
+    for (int addr = 0; addr < 200; ++addr) {
+        regList.push_back(std::make_shared<TRegister>(device, TRegisterConfig::Create(Modbus::REG_HOLDING, addr)));
+    }
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientRegisterPoller poller;
+    poller.PrepareRegisterRanges(regList, time);
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&]() {
+        spentTime.Start();
+        poller.OpenPortCycle(*port, spentTime, std::chrono::milliseconds(100), true, accessHandler, nullptr);
+        time += std::chrono::milliseconds(1);
+    };
+
+    // Registers of unknown availability are read one by one, then buffers and pooled ranges are allocated
+    for (size_t i = 0; i < 300; ++i) {
+        cycle();
+    }
+    ASSERT_EQ(regList.back()->GetValue(), 199);
+
+    TAllocationsCounter allocations;
+    for (size_t i = 0; i < 10000; ++i) {
+        cycle();
+    }
+    EXPECT_EQ(allocations.GetCount(), 0);
+}
+
+TEST_F(TModbusRangePoolTest, CachedRequests)
+{
+    Modbus::TModbusRTUTraits rtuTraits;
+    Modbus::TModbusTCPTraits tcpTraits(std::make_shared<uint16_t>(0));
+    auto getRequest = [&](const PRegisterRange& range,
+                          Modbus::IModbusTraits& traits,
+                          uint32_t addr,
+                          uint8_t slaveId = 1,
+                          int shift = 0) {
+        auto& modbusRange = static_cast<Modbus::TModbusRegisterRange&>(*range);
+        modbusRange.Reset(std::chrono::microseconds(100));
+        modbusRange.Add(Registers[addr], std::chrono::hours(1));
+        modbusRange.Add(Registers[addr + 1], std::chrono::hours(1));
+        return modbusRange.PrepareReadRequest(traits, slaveId, shift);
+    };
+    auto range = Pool.Get(std::chrono::microseconds(100));
+    auto notCachedRange = Modbus::CreateRegisterRange(std::chrono::microseconds(100));
+
+    // Cached RTU requests are the same as composed ones including CRC
+    for (uint32_t addr: {10, 20, 10}) {
+        EXPECT_EQ(getRequest(range, rtuTraits, addr), getRequest(notCachedRange, rtuTraits, addr));
+    }
+
+    // Changed slave id or shift gives another request
+    EXPECT_EQ(getRequest(range, rtuTraits, 10, 2), getRequest(notCachedRange, rtuTraits, 10, 2));
+    EXPECT_EQ(getRequest(range, rtuTraits, 10, 1, 5), getRequest(notCachedRange, rtuTraits, 10, 1, 5));
+    EXPECT_EQ(getRequest(range, rtuTraits, 15), getRequest(notCachedRange, rtuTraits, 10, 1, 5));
+    EXPECT_EQ(getRequest(range, rtuTraits, 10), getRequest(notCachedRange, rtuTraits, 10));
+
+    // Only transaction id is changed in cached TCP requests
+    auto request = getRequest(range, tcpTraits, 30);
+    auto cachedRequest = getRequest(range, tcpTraits, 30);
+    EXPECT_EQ(tcpTraits.GetTransactionId(cachedRequest), *tcpTraits.GetTransactionId(request) + 1);
+    EXPECT_EQ(std::vector<uint8_t>(request.begin() + 2, request.end()),
+              std::vector<uint8_t>(cachedRequest.begin() + 2, cachedRequest.end()));
+}
+
+TEST_F(TModbusRangePoolTest, DISABLED_CachedRequestsBenchmark)
+{
+    const size_t iterations = 1000000;
+    Modbus::TModbusRTUTraits rtuTraits;
+    auto measure = [&](const PRegisterRange& range) {
+        auto& modbusRange = static_cast<Modbus::TModbusRegisterRange&>(*range);
+        modbusRange.Add(Registers[10], std::chrono::hours(1));
+        modbusRange.Add(Registers[11], std::chrono::hours(1));
+
+        // Bytes of requests are summed up, so preparing can't be optimized away
+        uint64_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            const auto& request = modbusRange.PrepareReadRequest(rtuTraits, 1, 0);
+            checksum += request[request.size() - 1];
+        }
+        auto time = std::chrono::steady_clock::now() - start;
+        return std::make_pair(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count() / iterations,
+                              checksum);
+    };
+    auto composed = measure(Modbus::CreateRegisterRange(std::chrono::microseconds(100)));
+    auto cached = measure(Pool.Get(std::chrono::microseconds(100)));
+    std::cout << "RTU read request: composed " << composed.first << " ns, cached " << cached.first << " ns"
+              << std::endl;
+    EXPECT_EQ(composed.second, cached.second);
+}
@@ -0,0 +1,318 @@
+#include "devices/modbus_device.h"
+#include "fake_serial_port.h"
+#include "modbus_common.h"
+#include "modbus_expectations_base.h"
+
+namespace
+{
+    const int DEVICE_MAX_READ_REGISTERS = 4;
+
+    //! Fails reads of the size as many times as needed to decrease the limit
+    bool FailReads(Modbus::TReadRegistersLimit& limit, int count)
+    {
+        for (int i = 1; i < Modbus::TReadRegistersLimit::FAILURES_TO_DECREASE; ++i) {
+            if (!limit.OnReadFailure(count)) {
+                return false;
+            }
+        }
+        return limit.OnReadFailure(count);
+    }
+}
+
+class TModbusReadRegistersLimitTest: public TSerialDeviceTest, public TModbusExpectationsBase
+{
+protected:
+    PDeviceConfig Config;
+    std::shared_ptr<TModbusDevice> ModbusDev;
+    Modbus::TModbusRTUTraits Traits;
+    Modbus::TRegisterCache Cache;
+    Modbus::PReadRegistersLimit Limit;
+    std::vector<PRegister> Registers;
+
+    //! Larger reads are answered by fewer registers instead of ILLEGAL_DATA_VALUE exception
+    bool TruncateLargeReads = false;
+
+    void SetUp() override
+    {
+        SelectModbusType(MODBUS_RTU);
+        TSerialDeviceTest::SetUp();
+
+        TModbusDeviceConfig config;
+        config.CommonConfig = std::make_shared<TDeviceConfig>("modbus", "1", "modbus");
+        config.CommonConfig->MaxReadRegisters = 0;
+        Config = config.CommonConfig;
+        ModbusDev = std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                                    config,
+                                                    SerialPort,
+                                                    DeviceFactory.GetProtocol("modbus"));
+        Limit = std::make_shared<Modbus::TReadRegistersLimit>();
+        for (uint32_t addr = 0; addr < 10; ++addr) {
+            auto reg = std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(Modbus::REG_HOLDING, addr));
+            reg->SetAvailable(TRegisterAvailability::AVAILABLE);
+            Registers.push_back(reg);
+        }
+    }
+
+    void TearDown() override
+    {
+        if (SerialPort->IsOpen()) {
+            SerialPort->Close();
+        }
+        TSerialDeviceTest::TearDown();
+    }
+
+    std::vector<int> ReadHoldingRequest(uint16_t start, uint16_t count)
+    {
+        return WrapPDU({
+            0x03,                // function code
+            (start >> 8) & 0xFF, // starting address Hi
+            start & 0xFF,        // starting address Lo
+            (count >> 8) & 0xFF, // quantity Hi
+            count & 0xFF,        // quantity Lo
+        });
+    }
+
+    //! Registers are answered by their addresses
+    std::vector<int> ReadHoldingResponse(uint16_t start, uint16_t count)
+    {
+        std::vector<int> response = {0x03, count * 2};
+        for (int addr = start; addr < start + count; ++addr) {
+            response.push_back((addr >> 8) & 0xFF);
+            response.push_back(addr & 0xFF);
+        }
+        return WrapPDU(response);
+    }
+
+    void EnqueueReadHolding(uint16_t start, uint16_t count)
+    {
+        Expector()->Expect(ReadHoldingRequest(start, count), ReadHoldingResponse(start, count), __func__);
+    }
+
+    void EnqueueReadHoldingTooLarge(uint16_t start, uint16_t count)
+    {
+        if (TruncateLargeReads) {
+            Expector()->Expect(ReadHoldingRequest(start, count),
+                               ReadHoldingResponse(start, DEVICE_MAX_READ_REGISTERS),
+                               __func__);
+            return;
+        }
+        Expector()->Expect(ReadHoldingRequest(start, count),
+                           WrapPDU({
+                               0x83, // function code + exception flag
+                               0x03, // ILLEGAL_DATA_VALUE
+                           }),
+                           __func__);
+    }
+
+    void EnqueueRead(uint16_t start, uint16_t count)
+    {
+        if (count > DEVICE_MAX_READ_REGISTERS) {
+            EnqueueReadHoldingTooLarge(start, count);
+        } else {
+            EnqueueReadHolding(start, count);
+        }
+    }
+
+    //! Reads all registers by ranges and applies the limit like Modbus device does
+    void Poll()
+    {
+        std::shared_ptr<Modbus::TModbusRegisterRange> range;
+        auto read = [&]() {
+            Modbus::ReadRegisterRange(Traits, *SerialPort, 1, *range, Cache);
+            Config->MaxReadRegisters = Limit->Get();
+        };
+        for (const auto& reg: Registers) {
+            if (range && range->Add(reg, std::chrono::hours(1))) {
+                continue;
+            }
+            if (range) {
+                read();
+            }
+            range = std::make_shared<Modbus::TModbusRegisterRange>(std::chrono::microseconds(1));
+            range->SetReadRegistersLimit(Limit);
+            range->Add(reg, std::chrono::hours(1));
+        }
+        read();
+    }
+
+    //! Polls until the limit is learned, then checks that all registers are read by ranges of found size
+    void CheckLearnedLimit()
+    {
+        SerialPort->Open();
+
+        // Every size is rejected FAILURES_TO_DECREASE times before the limit is decreased.
+        // Successful reads increase it back until it meets the smallest rejected size
+        for (int i = 0; i < Modbus::TReadRegistersLimit::FAILURES_TO_DECREASE; ++i) {
+            EnqueueRead(0, 10);
+        }
+        EnqueueRead(0, 5);
+        EnqueueRead(5, 5);
+        EnqueueRead(0, 5);
+        EnqueueRead(5, 2);
+        EnqueueRead(7, 3);
+        EnqueueRead(0, 4);
+        EnqueueRead(4, 4);
+        EnqueueRead(8, 2);
+
+        for (size_t i = 0; i < 6 && !Limit->IsLearned(); ++i) {
+            Poll();
+        }
+        ASSERT_TRUE(Limit->IsLearned());
+        EXPECT_EQ(Limit->Get(), DEVICE_MAX_READ_REGISTERS);
+
+        // Registers rejected during probing are still polled
+        EnqueueRead(0, 4);
+        EnqueueRead(4, 4);
+        EnqueueRead(8, 2);
+        Poll();
+        for (const auto& reg: Registers) {
+            EXPECT_EQ(reg->GetAvailable(), TRegisterAvailability::AVAILABLE);
+            EXPECT_EQ(reg->GetValue(), GetUint32RegisterAddress(reg->GetAddress()));
+        }
+    }
+};
+
+TEST_F(TModbusReadRegistersLimitTest, Bisection)
+{
+    Modbus::TReadRegistersLimit limit;
+    EXPECT_EQ(limit.Get(), 0);
+
+    // Single failures don't change the limit
+    EXPECT_TRUE(limit.OnReadFailure(125));
+    EXPECT_TRUE(limit.OnReadFailure(125));
+    EXPECT_EQ(limit.Get(), 0);
+    EXPECT_TRUE(limit.OnReadFailure(125));
+    EXPECT_EQ(limit.Get(), 62);
+    EXPECT_TRUE(FailReads(limit, 62));
+    EXPECT_EQ(limit.Get(), 31);
+    limit.OnReadSuccess(31);
+    EXPECT_EQ(limit.Get(), 46);
+    EXPECT_TRUE(FailReads(limit, 46));
+    EXPECT_EQ(limit.Get(), 38);
+    limit.OnReadSuccess(38);
+    EXPECT_FALSE(limit.IsLearned());
+
+    // Errors of sizes read before aren't caused by request size
+    EXPECT_FALSE(limit.OnReadFailure(10));
+    EXPECT_FALSE(limit.OnReadFailure(1));
+
+    limit.OnReadSuccess(42);
+    EXPECT_TRUE(FailReads(limit, 43));
+    EXPECT_TRUE(limit.IsLearned());
+    EXPECT_EQ(limit.Get(), 42);
+    EXPECT_FALSE(FailReads(limit, 42));
+    EXPECT_EQ(limit.Get(), 42);
+}
+
+TEST_F(TModbusReadRegistersLimitTest, FailuresInRow)
+{
+    Modbus::TReadRegistersLimit limit;
+
+    // Successful read of the same or larger size breaks failures in a row
+    EXPECT_TRUE(limit.OnReadFailure(125));
+    EXPECT_TRUE(limit.OnReadFailure(100));
+    limit.OnReadSuccess(100);
+    EXPECT_TRUE(limit.OnReadFailure(125));
+    EXPECT_TRUE(limit.OnReadFailure(125));
+    EXPECT_EQ(limit.Get(), 0);
+
+    // Failures of different sizes decrease the limit by the smallest one
+    EXPECT_TRUE(limit.OnReadFailure(110));
+    EXPECT_EQ(limit.Get(), 105);
+}
+
+TEST_F(TModbusReadRegistersLimitTest, MaxCount)
+{
+    // Configured max_read_registers is the upper bound
+    Modbus::TReadRegistersLimit limit(50);
+    EXPECT_EQ(limit.Get(), 50);
+    EXPECT_EQ(limit.GetMaxCount(), 50);
+    limit.OnReadSuccess(50);
+    EXPECT_TRUE(limit.IsLearned());
+    EXPECT_EQ(limit.Get(), 50);
+
+    Modbus::TReadRegistersLimit smallerLimit(50);
+    EXPECT_TRUE(FailReads(smallerLimit, 50));
+    EXPECT_EQ(smallerLimit.Get(), 25);
+
+    // Stored limit is limited by the bound too
+    Modbus::TReadRegistersLimit storedLimit(20, 30);
+    EXPECT_EQ(storedLimit.Get(), 20);
+}
+
+TEST_F(TModbusReadRegistersLimitTest, StoredLimit)
+{
+    Modbus::TReadRegistersLimit limit(0, 16);
+    EXPECT_TRUE(limit.IsLearned());
+    EXPECT_EQ(limit.Get(), 16);
+
+    // Ranges built by larger configured max_read_registers fail until they are rebuilt by the stored limit
+    EXPECT_TRUE(FailReads(limit, 20));
+    EXPECT_TRUE(limit.IsLearned());
+    EXPECT_EQ(limit.Get(), 16);
+
+    // Stored limit is accepted after a successful read
+    limit.OnReadSuccess(16);
+    EXPECT_FALSE(FailReads(limit, 16));
+    EXPECT_TRUE(limit.IsLearned());
+
+    // Stored limit is searched again if it isn't accepted by the device anymore
+    Modbus::TReadRegistersLimit rejectedLimit(0, 16);
+    EXPECT_FALSE(rejectedLimit.OnReadFailure(15));
+    EXPECT_TRUE(FailReads(rejectedLimit, 16));
+    EXPECT_FALSE(rejectedLimit.IsLearned());
+    EXPECT_EQ(rejectedLimit.Get(), 8);
+}
+
+TEST_F(TModbusReadRegistersLimitTest, DeviceConfig)
+{
+    // Unknown limit starts from configured max_read_registers, it isn't replaced on device creation
+    TModbusDeviceConfig config;
+    config.CommonConfig = std::make_shared<TDeviceConfig>("modbus", "2", "modbus");
+    config.CommonConfig->MaxReadRegisters = 10;
+    config.AutoMaxReadRegisters = true;
+    auto device = std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                                  config,
+                                                  SerialPort,
+                                                  DeviceFactory.GetProtocol("modbus"));
+    EXPECT_EQ(config.CommonConfig->MaxReadRegisters, 10);
+
+    auto range = std::dynamic_pointer_cast<Modbus::TModbusRegisterRange>(device->CreateRegisterRange());
+    ASSERT_TRUE(range->GetReadRegistersLimit());
+    EXPECT_EQ(range->GetReadRegistersLimit()->Get(), 10);
+    EXPECT_EQ(range->GetReadRegistersLimit()->GetMaxCount(), 10);
+}
+
+TEST_F(TModbusReadRegistersLimitTest, ReadRanges)
+{
+    CheckLearnedLimit();
+}
+
+TEST_F(TModbusReadRegistersLimitTest, TruncatedResponses)
+{
+    TruncateLargeReads = true;
+    CheckLearnedLimit();
+}
+
+TEST_F(TModbusReadRegistersLimitTest, MalformedResponses)
+{
+    // Responses broken on the line don't decrease the limit
+    SerialPort->Open();
+    for (int i = 0; i < Modbus::TReadRegistersLimit::FAILURES_TO_DECREASE; ++i) {
+        auto response = ReadHoldingResponse(0, 10);
+        response.back() ^= 0xFF;
+        Expector()->Expect(ReadHoldingRequest(0, 10), response, "EnqueueReadHoldingBadCRC");
+    }
+
+    Modbus::TModbusRegisterRange range(std::chrono::microseconds(1));
+    range.SetReadRegistersLimit(Limit);
+    for (const auto& reg: Registers) {
+        range.Add(reg, std::chrono::hours(1));
+    }
+    for (int i = 0; i < Modbus::TReadRegistersLimit::FAILURES_TO_DECREASE; ++i) {
+        Modbus::ReadRegisterRange(Traits, *SerialPort, 1, range, Cache);
+    }
+    EXPECT_EQ(range.GetCount(), 10);
+    EXPECT_EQ(Limit->Get(), 0);
+    EXPECT_EQ(Registers[0]->GetErrorState().count(), 1);
+}
@@ -0,0 +1,150 @@
+#include "devices/modbus_device.h"
+#include "fake_serial_port.h"
+#include "modbus_common.h"
+#include "modbus_expectations_base.h"
+
+class TModbusReadWriteTest: public TSerialDeviceTest, public TModbusExpectationsBase
+{
+protected:
+    void SetUp() override
+    {
+        SelectModbusType(MODBUS_RTU);
+        TSerialDeviceTest::SetUp();
+
+        TModbusDeviceConfig config;
+        config.CommonConfig = std::make_shared<TDeviceConfig>("modbus", "1", "modbus");
+        config.CommonConfig->MaxReadRegisters = 10;
+        ModbusDev = std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                                    config,
+                                                    SerialPort,
+                                                    DeviceFactory.GetProtocol("modbus"));
+        for (uint32_t addr = 1; addr <= 3; ++addr) {
+            Range.Add(CreateRegister(addr), std::chrono::hours(1));
+        }
+        SerialPort->Open();
+    }
+
+    void TearDown() override
+    {
+        if (SerialPort->IsOpen()) {
+            SerialPort->Close();
+        }
+        TSerialDeviceTest::TearDown();
+    }
+
+    PRegister CreateRegister(uint32_t address, int type = Modbus::REG_HOLDING)
+    {
+        auto reg = std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(type, address));
+        reg->SetAvailable(TRegisterAvailability::AVAILABLE);
+        return reg;
+    }
+
+    //! Registers from address 1 are read and answered by their addresses
+    void EnqueueReadWriteMultiple(uint16_t writeAddress, uint16_t writeValue, uint16_t readCount = 3)
+    {
+        std::vector<int> response = {
+            0x17,          // function code
+            readCount * 2, // byte count
+        };
+        for (int addr = 1; addr <= readCount; ++addr) {
+            response.push_back((addr >> 8) & 0xFF);
+            response.push_back(addr & 0xFF);
+        }
+        Expector()->Expect(WrapPDU({
+                               0x17,                       // function code
+                               0x00,                       // read starting address Hi
+                               0x01,                       // read starting address Lo
+                               (readCount >> 8) & 0xFF,    // read quantity Hi
+                               readCount & 0xFF,           // read quantity Lo
+                               (writeAddress >> 8) & 0xFF, // write starting address Hi
+                               writeAddress & 0xFF,        // write starting address Lo
+                               0x00,                       // write quantity Hi
+                               0x01,                       // write quantity Lo
+                               0x02,                       // write byte count
+                               (writeValue >> 8) & 0xFF,   // value Hi
+                               writeValue & 0xFF,          // value Lo
+                           }),
+                           WrapPDU(response),
+                           __func__);
+    }
+
+    void EnqueueReadWriteMultipleException(uint8_t exceptionCode)
+    {
+        Expector()->Expect(WrapPDU({0x17, 0x00, 0x01, 0x00, 0x03, 0x00, 0x05, 0x00, 0x01, 0x02, 0x00, 0x01}),
+                           WrapPDU({0x97, exceptionCode}),
+                           __func__);
+    }
+
+    std::shared_ptr<TModbusDevice> ModbusDev;
+    Modbus::TModbusRTUTraits Traits;
+    Modbus::TRegisterCache Cache;
+    Modbus::TModbusRegisterRange Range{std::chrono::microseconds(1)};
+};
+
+TEST_F(TModbusReadWriteTest, WriteAndRead)
+{
+    EnqueueReadWriteMultiple(5, 0x1234);
+
+    auto reg = CreateRegister(5);
+    ASSERT_TRUE(Modbus::WriteRegisterAndReadRange(Traits, *SerialPort, 1, *reg, TRegisterValue{0x1234}, Range, Cache));
+
+    for (const auto& readReg: Range.RegisterList()) {
+        EXPECT_EQ(readReg->GetValue(), GetUint32RegisterAddress(readReg->GetAddress()));
+    }
+    ASSERT_NE(Cache.Find(Modbus::REG_HOLDING, 5), nullptr);
+    EXPECT_EQ(*Cache.Find(Modbus::REG_HOLDING, 5), 0x1234);
+}
+
+TEST_F(TModbusReadWriteTest, MinReadRegisters)
+{
+    // The read part is extended to min_read_registers like usual read request
+    ModbusDev->DeviceConfig()->MinReadRegisters = 5;
+    EnqueueReadWriteMultiple(10, 0x1234, 5);
+
+    auto reg = CreateRegister(10);
+    ASSERT_TRUE(Modbus::WriteRegisterAndReadRange(Traits, *SerialPort, 1, *reg, TRegisterValue{0x1234}, Range, Cache));
+
+    EXPECT_EQ(Range.GetCount(), 5);
+    for (const auto& readReg: Range.RegisterList()) {
+        EXPECT_EQ(readReg->GetValue(), GetUint32RegisterAddress(readReg->GetAddress()));
+    }
+    ASSERT_NE(Cache.Find(Modbus::REG_HOLDING, 10), nullptr);
+    EXPECT_EQ(*Cache.Find(Modbus::REG_HOLDING, 10), 0x1234);
+}
+
+TEST_F(TModbusReadWriteTest, NotHoldingRegisters)
+{
+    // Nothing is sent
+    auto coil = CreateRegister(5, Modbus::REG_COIL);
+    EXPECT_FALSE(Modbus::WriteRegisterAndReadRange(Traits, *SerialPort, 1, *coil, TRegisterValue{1}, Range, Cache));
+    auto single = CreateRegister(5, Modbus::REG_HOLDING_SINGLE);
+    EXPECT_FALSE(Modbus::WriteRegisterAndReadRange(Traits, *SerialPort, 1, *single, TRegisterValue{1}, Range, Cache));
+}
+
+TEST_F(TModbusReadWriteTest, IllegalFunction)
+{
+    EnqueueReadWriteMultipleException(0x01);
+
+    auto reg = CreateRegister(5);
+    EXPECT_THROW(Modbus::WriteRegisterAndReadRange(Traits, *SerialPort, 1, *reg, TRegisterValue{1}, Range, Cache),
+                 Modbus::TIllegalFunctionError);
+    EXPECT_EQ(Cache.Find(Modbus::REG_HOLDING, 5), nullptr);
+    for (const auto& readReg: Range.RegisterList()) {
+        EXPECT_EQ(readReg->GetErrorState().count(), 0);
+    }
+}
+
+TEST_F(TModbusReadWriteTest, IllegalDataValue)
+{
+    // The device rejects the range or the written register, registers aren't changed
+    EnqueueReadWriteMultipleException(0x03);
+
+    auto reg = CreateRegister(5);
+    EXPECT_THROW(Modbus::WriteRegisterAndReadRange(Traits, *SerialPort, 1, *reg, TRegisterValue{1}, Range, Cache),
+                 TSerialDevicePermanentRegisterException);
+    EXPECT_EQ(Cache.Find(Modbus::REG_HOLDING, 5), nullptr);
+    for (const auto& readReg: Range.RegisterList()) {
+        EXPECT_EQ(readReg->GetAvailable(), TRegisterAvailability::AVAILABLE);
+        EXPECT_EQ(readReg->GetErrorState().count(), 0);
+    }
+}
@@ -0,0 +1,198 @@
+#include "devices/modbus_device.h"
+#include "fake_serial_port.h"
+#include "modbus_common.h"
+#include "modbus_expectations_base.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+namespace
+{
+    const int RANGE_SIZE = 125;
+}
+
+class TModbusRegisterCacheTest: public TSerialDeviceTest, public TModbusExpectationsBase
+{
+protected:
+    void SetUp() override
+    {
+        SelectModbusType(MODBUS_RTU);
+        TSerialDeviceTest::SetUp();
+
+        TModbusDeviceConfig config;
+        config.CommonConfig = std::make_shared<TDeviceConfig>("modbus", "1", "modbus");
+        config.CommonConfig->MaxReadRegisters = 10;
+        ModbusDev = std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                                    config,
+                                                    SerialPort,
+                                                    DeviceFactory.GetProtocol("modbus"));
+    }
+
+    void TearDown() override
+    {
+        if (SerialPort->IsOpen()) {
+            SerialPort->Close();
+        }
+        TSerialDeviceTest::TearDown();
+    }
+
+    PRegister CreateRegister(uint32_t address)
+    {
+        auto reg = std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(Modbus::REG_HOLDING, address));
+        reg->SetAvailable(TRegisterAvailability::AVAILABLE);
+        return reg;
+    }
+
+    void EnqueueReadHolding()
+    {
+        Expector()->Expect(WrapPDU({
+                               0x03, // function code
+                               0x03, // starting address Hi
+                               0xE8, // starting address Lo
+                               0x00, // quantity Hi
+                               0x04, // quantity Lo
+                           }),
+                           WrapPDU({
+                               0x03, // function code
+                               0x08, // byte count
+                               0x11, // register 1000 Hi
+                               0x11, // register 1000 Lo
+                               0x22, // register 1001 Hi
+                               0x22, // register 1001 Lo
+                               0x33, // register 1002 Hi
+                               0x33, // register 1002 Lo
+                               0x44, // register 1003 Hi
+                               0x44, // register 1003 Lo
+                           }),
+                           __func__);
+    }
+
+    void EnqueueWriteMultipleRegisters()
+    {
+        Expector()->Expect(WrapPDU({
+                               0x10, // function code
+                               0x03, // starting address Hi
+                               0xE8, // starting address Lo
+                               0x00, // quantity Hi
+                               0x04, // quantity Lo
+                               0x08, // byte count
+                               0x00, // register 1000 Hi
+                               0x01, // register 1000 Lo
+                               0x22, // cached register 1001 Hi
+                               0x22, // cached register 1001 Lo
+                               0x33, // cached register 1002 Hi
+                               0x33, // cached register 1002 Lo
+                               0x00, // register 1003 Hi
+                               0x02, // register 1003 Lo
+                           }),
+                           WrapPDU({0x10, 0x03, 0xE8, 0x00, 0x04}),
+                           __func__);
+    }
+
+    std::shared_ptr<TModbusDevice> ModbusDev;
+    Modbus::TModbusRTUTraits Traits;
+};
+
+TEST_F(TModbusRegisterCacheTest, Values)
+{
+    Modbus::TRegisterCache cache;
+    EXPECT_EQ(cache.Find(Modbus::REG_HOLDING, 1), nullptr);
+
+    const uint16_t values[] = {1, 2, 3, 4};
+    // Values are stored across pages boundary
+    cache.Set(Modbus::REG_HOLDING, 254, values, 4);
+    cache.Set(Modbus::REG_COIL, 255, 5);
+    cache.Set(Modbus::REG_HOLDING, 0x10000, 6);
+
+    EXPECT_EQ(cache.Find(Modbus::REG_HOLDING, 253), nullptr);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_NE(cache.Find(Modbus::REG_HOLDING, 254 + i), nullptr);
+        EXPECT_EQ(*cache.Find(Modbus::REG_HOLDING, 254 + i), values[i]);
+    }
+    EXPECT_EQ(cache.Find(Modbus::REG_HOLDING, 258), nullptr);
+    ASSERT_NE(cache.Find(Modbus::REG_COIL, 255), nullptr);
+    EXPECT_EQ(*cache.Find(Modbus::REG_COIL, 255), 5);
+    EXPECT_EQ(cache.Find(Modbus::REG_INPUT, 255), nullptr);
+
+    // Addresses out of 16-bit range are not cached
+    EXPECT_EQ(cache.Find(Modbus::REG_HOLDING, 0x10000), nullptr);
+    EXPECT_EQ(cache.Find(Modbus::REG_HOLDING, -1), nullptr);
+}
+
+TEST_F(TModbusRegisterCacheTest, ReadAndWrite)
+{
+    SerialPort->Open();
+    EnqueueReadHolding();
+    EnqueueWriteMultipleRegisters();
+
+    Modbus::TRegisterCache cache;
+    Modbus::TModbusRegisterRange range(std::chrono::microseconds(1));
+    for (uint32_t addr = 1000; addr < 1004; ++addr) {
+        EXPECT_TRUE(range.Add(CreateRegister(addr), std::chrono::hours(1)));
+    }
+    Modbus::ReadRegisterRange(Traits, *SerialPort, 1, range, cache);
+    for (int addr = 1000; addr < 1004; ++addr) {
+        ASSERT_NE(cache.Find(Modbus::REG_HOLDING, addr), nullptr);
+        EXPECT_EQ(*cache.Find(Modbus::REG_HOLDING, addr), (addr - 999) * 0x1111);
+    }
+
+    // Read values fill the hole between written registers
+    std::vector<TRegisterWrite> writes{TRegisterWrite{CreateRegister(1000), TRegisterValue{1}},
+                                       TRegisterWrite{CreateRegister(1003), TRegisterValue{2}}};
+    Modbus::WriteRegisters(Traits, *SerialPort, 1, writes, cache, 10, 2);
+    EXPECT_TRUE(writes[0].Done);
+    EXPECT_TRUE(writes[1].Done);
+    EXPECT_EQ(*cache.Find(Modbus::REG_HOLDING, 1000), 1);
+    EXPECT_EQ(*cache.Find(Modbus::REG_HOLDING, 1003), 2);
+}
+
+TEST_F(TModbusRegisterCacheTest, DISABLED_Benchmark)
+{
+    const size_t iterations = 100000;
+    uint16_t values[RANGE_SIZE] = {};
+
+    // Looked up values are summed up, so lookups can't be optimized away
+    uint64_t mapChecksum = 0;
+    uint64_t cacheChecksum = 0;
+
+    // Storing and lookup of a range of words as it was done with std::map keyed by type and address
+    std::map<int64_t, uint16_t> map;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        values[i % RANGE_SIZE] = i;
+        for (int addr = 0; addr < RANGE_SIZE; ++addr) {
+            map[(int64_t(addr) << 32) | Modbus::REG_HOLDING] = values[addr];
+        }
+        for (int addr = 0; addr < RANGE_SIZE; ++addr) {
+            auto key = (int64_t(addr) << 32) | Modbus::REG_HOLDING;
+            if (map.count(key)) {
+                mapChecksum += map.at(key);
+            }
+        }
+    }
+    auto mapTime = std::chrono::steady_clock::now() - start;
+
+    std::fill(std::begin(values), std::end(values), 0);
+    Modbus::TRegisterCache cache;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        values[i % RANGE_SIZE] = i;
+        cache.Set(Modbus::REG_HOLDING, 0, values, RANGE_SIZE);
+        for (int addr = 0; addr < RANGE_SIZE; ++addr) {
+            auto value = cache.Find(Modbus::REG_HOLDING, addr);
+            if (value) {
+                cacheChecksum += *value;
+            }
+        }
+    }
+    auto cacheTime = std::chrono::steady_clock::now() - start;
+
+    auto toUs = [&](std::chrono::steady_clock::duration time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count() / iterations / 1000.0;
+    };
+    std::cout << RANGE_SIZE << " words, store and lookup: std::map " << toUs(mapTime) << " us, paged cache "
+              << toUs(cacheTime) << " us" << std::endl;
+    std::cout << "checksums: std::map " << mapChecksum << ", paged cache " << cacheChecksum << std::endl;
+    EXPECT_EQ(mapChecksum, cacheChecksum);
+}
@@ -1,3 +1,4 @@
+#include "devices/modbus_device.h"
 #include "fake_serial_port.h"
 #include "modbus_common.h"
 
@@ -199,3 +200,151 @@ TEST_F(TModbusTCPTraitsTest, ReadFrameTimeout)
 
     ASSERT_THROW(traits.ReadFrame(port, t, t, req, resp), TSerialDeviceTransientErrorException);
 }
+
+TEST_F(TModbusTCPTraitsTest, ReadAnyFrameKeepsTransactionId)
+{
+    std::vector<uint8_t> r = {0, 2, 0, 0, 0, 4, 100, 7, 8, 9};
+    TPortMock port(r);
+
+    Modbus::TModbusTCPTraits traits(std::make_shared<uint16_t>(10));
+    std::chrono::milliseconds t(10);
+
+    Modbus::TResponse resp;
+
+    auto pduSize = traits.ReadAnyFrame(port, t, t, resp).Count;
+    resp.resize(traits.GetPacketSize(pduSize));
+    TestEqual(resp, r);
+    ASSERT_EQ(traits.GetTransactionId(resp), 2);
+}
+
+class TModbusTCPReadRangesTest: public TSerialDeviceTest
+{
+protected:
+    void SetUp() override
+    {
+        TSerialDeviceTest::SetUp();
+        Config = std::make_shared<TDeviceConfig>("modbus", "1", "modbus");
+        Config->ResponseTimeout = std::chrono::milliseconds(500);
+        Config->DeviceTimeout = std::chrono::milliseconds(0);
+        Config->DeviceMaxFailCycles = 3;
+
+        TModbusDeviceConfig config;
+        config.CommonConfig = Config;
+        ModbusDev =
+            std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusTCPTraits>(std::make_shared<uint16_t>(0)),
+                                            config,
+                                            SerialPort,
+                                            DeviceFactory.GetProtocol("modbus"));
+        SerialPort->Open();
+    }
+
+    void TearDown() override
+    {
+        if (SerialPort->IsOpen()) {
+            SerialPort->Close();
+        }
+        TSerialDeviceTest::TearDown();
+    }
+
+    //! Creates a range of a single holding register
+    PRegisterRange CreateRange(uint16_t address)
+    {
+        auto reg = std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(Modbus::REG_HOLDING, address));
+        auto range = Modbus::CreateRegisterRange(std::chrono::microseconds(100));
+        range->Add(reg, std::chrono::hours(1));
+        return range;
+    }
+
+    //! Response to a read of a single register with its address as the value
+    std::vector<int> ReadResponse(uint16_t transactionId, uint16_t address)
+    {
+        return {
+            transactionId >> 8,   // transaction id Hi
+            transactionId & 0xFF, // transaction id Lo
+            0x00,                 // protocol id Hi
+            0x00,                 // protocol id Lo
+            0x00,                 // length Hi
+            0x05,                 // length Lo
+            0x01,                 // unit id
+            0x03,                 // function code
+            0x02,                 // byte count
+            address >> 8,         // value Hi
+            address & 0xFF,       // value Lo
+        };
+    }
+
+    //! Expects a read request of a single register. Requests in flight are answered in any order,
+    //! so responses are queued regardless of requests. No responses mean a timeout
+    void EnqueueReadRequest(uint16_t transactionId,
+                            uint16_t address,
+                            const std::vector<std::vector<int>>& responses = {})
+    {
+        std::vector<int> response;
+        for (const auto& item: responses) {
+            response.insert(response.end(), item.begin(), item.end());
+        }
+        Expector()->Expect(
+            {
+                transactionId >> 8,   // transaction id Hi
+                transactionId & 0xFF, // transaction id Lo
+                0x00,                 // protocol id Hi
+                0x00,                 // protocol id Lo
+                0x00,                 // length Hi
+                0x06,                 // length Lo
+                0x01,                 // unit id
+                0x03,                 // function code
+                address >> 8,         // starting address Hi
+                address & 0xFF,       // starting address Lo
+                0x00,                 // quantity Hi
+                0x01,                 // quantity Lo
+            },
+            response,
+            __func__);
+    }
+
+    bool HasReadError(const PRegisterRange& range) const
+    {
+        return range->RegisterList().front()->GetErrorState().test(TRegister::TError::ReadError);
+    }
+
+    PDeviceConfig Config;
+    std::shared_ptr<TModbusDevice> ModbusDev;
+};
+
+TEST_F(TModbusTCPReadRangesTest, ResponsesInAnyOrder)
+{
+    std::vector<PRegisterRange> ranges{CreateRange(0), CreateRange(10), CreateRange(20)};
+
+    // A response with unknown transaction id is skipped
+    EnqueueReadRequest(1, 0, {ReadResponse(7, 0)});
+    EnqueueReadRequest(2, 10, {ReadResponse(2, 10)});
+    EnqueueReadRequest(3, 20, {ReadResponse(1, 0), ReadResponse(3, 20)});
+    ModbusDev->ReadRegisterRanges(ranges, 2);
+
+    for (const auto& range: ranges) {
+        EXPECT_FALSE(HasReadError(range));
+        auto reg = range->RegisterList().front();
+        EXPECT_EQ(reg->GetValue().Get<uint16_t>(), GetUint32RegisterAddress(reg->GetAddress()));
+    }
+}
+
+TEST_F(TModbusTCPReadRangesTest, LostResponses)
+{
+    std::vector<PRegisterRange> ranges{CreateRange(0), CreateRange(10), CreateRange(20), CreateRange(30)};
+
+    // Responses to the first and the third requests are lost, they fail together by one timeout.
+    // The last range is sent after that and fails alone
+    EnqueueReadRequest(1, 0, {ReadResponse(2, 10)});
+    EnqueueReadRequest(2, 10);
+    EnqueueReadRequest(3, 20);
+    EnqueueReadRequest(4, 30);
+    ModbusDev->ReadRegisterRanges(ranges, 2);
+
+    EXPECT_TRUE(HasReadError(ranges[0]));
+    EXPECT_FALSE(HasReadError(ranges[1]));
+    EXPECT_TRUE(HasReadError(ranges[2]));
+    EXPECT_TRUE(HasReadError(ranges[3]));
+
+    // Each lost exchange is counted as one failed cycle of the device
+    EXPECT_FALSE(ModbusDev->GetIsDisconnected());
+}
@@ -2,6 +2,7 @@
 #include "fake_serial_port.h"
 #include "modbus_common.h"
 #include "modbus_expectations.h"
+#include "serial_client.h"
 
 #include <wblib/control.h>
 
@@ -410,6 +411,62 @@ TEST_F(TModbusTest, MinReadRegisters)
     EXPECT_EQ(reg->GetValue(), 0x15);
 }
 
+TEST_F(TModbusTest, PendingWritesReadByParts)
+{
+    TSerialClientSettings settings;
+    settings.UseReadPlan = true;
+    // Reading of 2 registers takes 62 ms at 9600 baud with 20 ms frame timeout, of 4 registers - 67 ms
+    settings.PendingWritesLatencyTarget = std::chrono::milliseconds(63);
+    auto serialClient = std::make_shared<TSerialClient>(SerialPort,
+                                                        TPortOpenCloseLogic::TSettings(),
+                                                        std::chrono::steady_clock::now,
+                                                        std::numeric_limits<size_t>::max(),
+                                                        settings);
+    std::vector<PRegister> regs;
+    for (uint32_t addr = 4; addr < 8; ++addr) {
+        regs.push_back(TRegister::Intern(ModbusDev, TRegisterConfig::Create(Modbus::REG_HOLDING, addr, U16)));
+        regs.back()->SetAvailable(TRegisterAvailability::AVAILABLE);
+        serialClient->AddRegister(regs.back());
+    }
+
+    // New value of the first register comes from MQTT while the second register is read
+    std::vector<std::string> values{"1", "2"};
+    serialClient->SetReadCallback([&](PRegister reg) {
+        if (reg == regs[1] && !values.empty()) {
+            serialClient->SetTextValue(regs[0], values.front());
+            values.erase(values.begin());
+        }
+    });
+
+    auto enqueueRead = [&](int address, int count) {
+        std::vector<int> response{0x03, count * 2};
+        for (int i = 0; i < count; ++i) {
+            response.push_back(0x00);
+            response.push_back(address + i);
+        }
+        Expector()->Expect(WrapPDU({0x03, 0x00, address, 0x00, count}), WrapPDU(response), "ReadHolding");
+    };
+    auto enqueueWrite = [&](int value) {
+        Expector()->Expect(WrapPDU({0x06, 0x00, 0x04, 0x00, value}),
+                           WrapPDU({0x06, 0x00, 0x04, 0x00, value}),
+                           "WriteHolding");
+    };
+
+    // Without pending writes the entry is read by one request.
+    // While values keep coming, the entry is read by parts and the values are written between them.
+    // The rest of the entry is read after the write without waiting for its next poll
+    enqueueRead(4, 4);
+    enqueueWrite(1);
+    enqueueRead(4, 2);
+    enqueueWrite(2);
+    enqueueRead(6, 2);
+    for (int i = 0; i < 3; ++i) {
+        Note() << "Cycle()";
+        serialClient->Cycle();
+    }
+    SerialPort->Close();
+}
+
 class TModbusIntegrationTest: public TSerialDeviceIntegrationTest, public TModbusExpectations
 {
 protected:
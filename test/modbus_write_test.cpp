@@ -0,0 +1,210 @@
+#include "devices/modbus_device.h"
+#include "fake_serial_port.h"
+#include "modbus_common.h"
+#include "modbus_expectations_base.h"
+#include "serial_client.h"
+
+class TModbusWriteRegistersTest: public TSerialDeviceTest, public TModbusExpectationsBase
+{
+protected:
+    void SetUp() override
+    {
+        SelectModbusType(MODBUS_RTU);
+        TSerialDeviceTest::SetUp();
+        ModbusDev = CreateDevice(std::make_shared<TDeviceConfig>("modbus", "1", "modbus"));
+        SerialPort->Open();
+    }
+
+    void TearDown() override
+    {
+        if (SerialPort->IsOpen()) {
+            SerialPort->Close();
+        }
+        TSerialDeviceTest::TearDown();
+    }
+
+    std::shared_ptr<TModbusDevice> CreateDevice(PDeviceConfig config)
+    {
+        TModbusDeviceConfig modbusConfig;
+        modbusConfig.CommonConfig = config;
+        modbusConfig.CommonConfig->MaxReadRegisters = 10;
+        modbusConfig.MaxWriteRegisters = 10;
+        return std::make_shared<TModbusDevice>(std::make_unique<Modbus::TModbusRTUTraits>(),
+                                               modbusConfig,
+                                               SerialPort,
+                                               DeviceFactory.GetProtocol("modbus"));
+    }
+
+    TRegisterWrite Write(int type, uint32_t address, uint64_t value)
+    {
+        return TRegisterWrite{std::make_shared<TRegister>(ModbusDev, TRegisterConfig::Create(type, address)),
+                              TRegisterValue{value}};
+    }
+
+    void EnqueueWriteMultipleRegisters(uint8_t slaveId, uint16_t address, const std::vector<int>& values)
+    {
+        std::vector<int> request = {
+            0x10,                                // function code
+            (address >> 8) & 0xFF,               // starting address Hi
+            address & 0xFF,                      // starting address Lo
+            0x00,                                // quantity Hi
+            static_cast<int>(values.size()),     // quantity Lo
+            static_cast<int>(values.size() * 2), // byte count
+        };
+        for (auto value: values) {
+            request.push_back((value >> 8) & 0xFF);
+            request.push_back(value & 0xFF);
+        }
+        Expector()->Expect(WrapPDU(request, slaveId),
+                           WrapPDU({0x10, (address >> 8) & 0xFF, address & 0xFF, 0x00, request[4]}, slaveId),
+                           __func__);
+    }
+
+    void EnqueueWriteSingleRegister(uint16_t address, uint16_t value)
+    {
+        std::vector<int> pdu = {
+            0x06,                  // function code
+            (address >> 8) & 0xFF, // register address Hi
+            address & 0xFF,        // register address Lo
+            (value >> 8) & 0xFF,   // value Hi
+            value & 0xFF,          // value Lo
+        };
+        Expector()->Expect(WrapPDU(pdu), WrapPDU(pdu), __func__);
+    }
+
+    void EnqueueWriteMultipleCoils(uint16_t address, uint16_t count, uint8_t values)
+    {
+        Expector()->Expect(WrapPDU({
+                               0x0F,                  // function code
+                               (address >> 8) & 0xFF, // starting address Hi
+                               address & 0xFF,        // starting address Lo
+                               (count >> 8) & 0xFF,   // quantity Hi
+                               count & 0xFF,          // quantity Lo
+                               0x01,                  // byte count
+                               values,                // coils
+                           }),
+                           WrapPDU({0x0F, (address >> 8) & 0xFF, address & 0xFF, (count >> 8) & 0xFF, count & 0xFF}),
+                           __func__);
+    }
+
+    void EnqueueReadHolding(uint8_t slaveId, uint16_t address, const std::vector<int>& values)
+    {
+        std::vector<int> response = {0x03, static_cast<int>(values.size() * 2)};
+        for (auto value: values) {
+            response.push_back((value >> 8) & 0xFF);
+            response.push_back(value & 0xFF);
+        }
+        Expector()->Expect(WrapPDU(
+                               {
+                                   0x03,                            // function code
+                                   (address >> 8) & 0xFF,           // starting address Hi
+                                   address & 0xFF,                  // starting address Lo
+                                   0x00,                            // quantity Hi
+                                   static_cast<int>(values.size()), // quantity Lo
+                               },
+                               slaveId),
+                           WrapPDU(response, slaveId),
+                           __func__);
+    }
+
+    std::shared_ptr<TModbusDevice> ModbusDev;
+    Modbus::TModbusRTUTraits Traits;
+    Modbus::TRegisterCache Cache;
+};
+
+TEST_F(TModbusWriteRegistersTest, Adjacent)
+{
+    EnqueueWriteMultipleRegisters(1, 1, {0x0101, 0x0202, 0x0303});
+
+    std::vector<TRegisterWrite> writes{Write(Modbus::REG_HOLDING, 2, 0x0202),
+                                       Write(Modbus::REG_HOLDING, 1, 0x0101),
+                                       Write(Modbus::REG_HOLDING, 3, 0x0303),
+                                       Write(Modbus::REG_HOLDING, 10, 0x1010)};
+    Modbus::WriteRegisters(Traits, *SerialPort, 1, writes, Cache, 10, 0);
+
+    EXPECT_TRUE(writes[0].Done);
+    EXPECT_TRUE(writes[1].Done);
+    EXPECT_TRUE(writes[2].Done);
+    // Single register is written as usual
+    EXPECT_FALSE(writes[3].Done);
+}
+
+TEST_F(TModbusWriteRegistersTest, MaxWriteRegisters)
+{
+    EnqueueWriteMultipleRegisters(1, 1, {1, 2});
+    EnqueueWriteMultipleRegisters(1, 3, {3, 4});
+
+    std::vector<TRegisterWrite> writes{Write(Modbus::REG_HOLDING, 1, 1),
+                                       Write(Modbus::REG_HOLDING, 2, 2),
+                                       Write(Modbus::REG_HOLDING, 3, 3),
+                                       Write(Modbus::REG_HOLDING, 4, 4)};
+    Modbus::WriteRegisters(Traits, *SerialPort, 1, writes, Cache, 2, 0);
+
+    for (const auto& write: writes) {
+        EXPECT_TRUE(write.Done);
+    }
+}
+
+TEST_F(TModbusWriteRegistersTest, HoleFilledByCache)
+{
+    // Cache the value of register 2
+    EnqueueWriteSingleRegister(2, 0x2222);
+    auto cached = Write(Modbus::REG_HOLDING, 2, 0x2222);
+    Modbus::WriteRegister(Traits, *SerialPort, 1, *cached.Register, cached.Value, Cache);
+
+    // Registers 4 and 5 are not cached, so register 6 is not written together with others
+    EnqueueWriteMultipleRegisters(1, 1, {1, 0x2222, 3});
+    std::vector<TRegisterWrite> writes{Write(Modbus::REG_HOLDING, 1, 1),
+                                       Write(Modbus::REG_HOLDING, 3, 3),
+                                       Write(Modbus::REG_HOLDING, 6, 6)};
+    Modbus::WriteRegisters(Traits, *SerialPort, 1, writes, Cache, 10, 2);
+
+    EXPECT_TRUE(writes[0].Done);
+    EXPECT_TRUE(writes[1].Done);
+    EXPECT_FALSE(writes[2].Done);
+}
+
+TEST_F(TModbusWriteRegistersTest, Coils)
+{
+    EnqueueWriteMultipleCoils(8, 3, 0x05);
+
+    std::vector<TRegisterWrite> writes{Write(Modbus::REG_COIL, 8, 1),
+                                       Write(Modbus::REG_COIL, 9, 0),
+                                       Write(Modbus::REG_COIL, 10, 1)};
+    Modbus::WriteRegisters(Traits, *SerialPort, 1, writes, Cache, 10, 0);
+
+    for (const auto& write: writes) {
+        EXPECT_TRUE(write.Done);
+    }
+}
+
+TEST_F(TModbusWriteRegistersTest, SerialClientFlush)
+{
+    auto serialClient = std::make_shared<TSerialClient>(SerialPort, TPortOpenCloseLogic::TSettings(), []() {
+        return std::chrono::steady_clock::now();
+    });
+    std::vector<std::shared_ptr<TModbusDevice>> devices{
+        ModbusDev,
+        CreateDevice(std::make_shared<TDeviceConfig>("modbus2", "2", "modbus"))};
+    std::vector<PRegister> regs;
+    for (const auto& device: devices) {
+        for (uint32_t addr = 1; addr <= 3; ++addr) {
+            regs.push_back(std::make_shared<TRegister>(device, TRegisterConfig::Create(Modbus::REG_HOLDING, addr)));
+            serialClient->AddRegister(regs.back());
+        }
+    }
+
+    // Pending writes of a device are flushed together by one request before polling.
+    // Devices are flushed in order of their first pending writes
+    EnqueueWriteMultipleRegisters(2, 1, {4, 5});
+    EnqueueWriteMultipleRegisters(1, 1, {1, 2, 3});
+    EnqueueReadHolding(1, 1, {1, 2, 3});
+
+    // Writes of the devices are interleaved
+    serialClient->SetTextValue(regs[4], "5");
+    serialClient->SetTextValue(regs[2], "3");
+    serialClient->SetTextValue(regs[3], "4");
+    serialClient->SetTextValue(regs[0], "1");
+    serialClient->SetTextValue(regs[1], "2");
+    serialClient->Cycle();
+}
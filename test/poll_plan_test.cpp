@@ -1,6 +1,9 @@
 #include "poll_plan.h"
 #include "gtest/gtest.h"
 #include <chrono>
+#include <memory>
+#include <random>
+#include <string>
 #include <vector>
 
 using namespace std::chrono_literals;
@@ -37,15 +40,250 @@ TEST(PollPlanTest, PriorityQueueSchedule)
     EXPECT_FALSE(schedule.HasReadyItems(std::chrono::steady_clock::now()));
 }
 
+TEST(PollPlanTest, IndexedPriorityQueueSchedule)
+{
+    TIndexedPriorityQueueSchedule<int, std::less<int>> schedule;
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_TRUE(schedule.IsEmpty());
+    EXPECT_FALSE(schedule.Remove(1));
+    EXPECT_FALSE(schedule.UpdateDeadline(1, now));
+    for (int i = 1; i <= 10; ++i) {
+        schedule.AddEntry(i, now + std::chrono::milliseconds(i));
+    }
+    EXPECT_TRUE(schedule.Contains(5));
+    EXPECT_TRUE(schedule.Remove(5));
+    EXPECT_FALSE(schedule.Contains(5));
+    EXPECT_FALSE(schedule.Remove(5));
+    EXPECT_TRUE(schedule.UpdateDeadline(8, now));
+    EXPECT_TRUE(schedule.UpdateDeadline(1, now + 20ms));
+    // Adding of already scheduled entry updates its deadline
+    schedule.AddEntry(2, now + 30ms);
+    std::vector<int> result;
+    while (!schedule.IsEmpty()) {
+        result.push_back(schedule.GetTop().Data);
+        schedule.Pop();
+    }
+    EXPECT_EQ(std::vector<int>({8, 3, 4, 6, 7, 9, 10, 1, 2}), result);
+    EXPECT_FALSE(schedule.Contains(8));
+    schedule.AddEntry(8, now);
+    EXPECT_TRUE(schedule.Contains(8));
+    EXPECT_EQ(now, schedule.GetDeadline());
+}
+
+TEST(PollPlanTest, TimingWheelSchedule)
+{
+    TTimingWheelSchedule<int, std::less<int>> schedule;
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_TRUE(schedule.IsEmpty());
+    EXPECT_EQ(std::chrono::steady_clock::time_point::max(), schedule.GetDeadline());
+    schedule.AddEntry(1, now);
+    schedule.AddEntry(2, now + 100ms);
+    schedule.AddEntry(3, now);
+    schedule.AddEntry(4, now + 10h);
+    schedule.AddEntry(5, now + 100us);
+    EXPECT_TRUE(schedule.Contains(4));
+    EXPECT_FALSE(schedule.Contains(6));
+    EXPECT_TRUE(schedule.HasReadyItems(now));
+    // Same deadline, order is defined by the compare predicate as in TPriorityQueueSchedule
+    EXPECT_EQ(3, schedule.GetTop().Data);
+    schedule.Pop();
+    EXPECT_EQ(1, schedule.GetTop().Data);
+    schedule.Pop();
+    EXPECT_FALSE(schedule.HasReadyItems(now));
+    EXPECT_EQ(now + 100us, schedule.GetDeadline());
+    EXPECT_EQ(5, schedule.GetTop().Data);
+    schedule.Pop();
+    EXPECT_EQ(2, schedule.GetTop().Data);
+    schedule.Pop();
+    EXPECT_EQ(now + 10h, schedule.GetDeadline());
+    EXPECT_EQ(4, schedule.GetTop().Data);
+    schedule.Pop();
+    EXPECT_TRUE(schedule.IsEmpty());
+    EXPECT_FALSE(schedule.HasReadyItems(now + 11h));
+}
+
+namespace
+{
+    struct TTestEntry: public TScheduleEntryState
+    {};
+
+    typedef std::shared_ptr<TTestEntry> PTestEntry;
+}
+
+TEST(PollPlanTest, ScheduleEntryStates)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto e1 = std::make_shared<TTestEntry>();
+    auto e2 = std::make_shared<TTestEntry>();
+
+    // Entries keep their positions, so equal positions in different heaps must not be confused
+    TIndexedPriorityQueueSchedule<PTestEntry, std::less<PTestEntry>> heap1;
+    TIndexedPriorityQueueSchedule<PTestEntry, std::less<PTestEntry>> heap2;
+    heap1.AddEntry(e1, now);
+    heap2.AddEntry(e2, now);
+    EXPECT_EQ(e1->HeapPosition, 0);
+    EXPECT_EQ(e2->HeapPosition, 0);
+    EXPECT_TRUE(heap1.Contains(e1));
+    EXPECT_FALSE(heap2.Contains(e1));
+    EXPECT_FALSE(heap2.Remove(e1));
+    EXPECT_FALSE(heap2.UpdateDeadline(e1, now));
+    heap1.Pop();
+    EXPECT_EQ(e1->HeapPosition, TScheduleEntryState::NPOS);
+    EXPECT_TRUE(heap1.IsEmpty());
+    EXPECT_EQ(heap2.GetTop().Data, e2);
+
+    TTimingWheelSchedule<PTestEntry, std::less<PTestEntry>> wheel1;
+    TTimingWheelSchedule<PTestEntry, std::less<PTestEntry>> wheel2;
+    wheel1.AddEntry(e1, now + 1h);
+    EXPECT_TRUE(wheel1.Contains(e1));
+    EXPECT_FALSE(wheel2.Contains(e1));
+    EXPECT_FALSE(wheel2.Remove(e1));
+    EXPECT_TRUE(wheel2.IsEmpty());
+    EXPECT_TRUE(wheel1.Remove(e1));
+    EXPECT_TRUE(wheel1.IsEmpty());
+    EXPECT_TRUE(e1->IsUnused());
+
+    // Other entries keep their states in a map
+    TIndexedPriorityQueueSchedule<std::string, std::less<std::string>> strings;
+    strings.AddEntry("b", now);
+    strings.AddEntry("a", now);
+    EXPECT_EQ(strings.GetTop().Data, "b");
+    strings.Pop();
+    EXPECT_FALSE(strings.Contains("b"));
+    EXPECT_TRUE(strings.Remove("a"));
+    EXPECT_TRUE(strings.IsEmpty());
+}
+
+template<class TSchedule> void SimulatePolling(TSchedule& schedule,
+                                               std::chrono::steady_clock::time_point start,
+                                               size_t entriesCount,
+                                               size_t pollsCount,
+                                               std::vector<int>& result)
+{
+    std::mt19937 rnd(1);
+    std::uniform_int_distribution<int> period(0, 100000);
+    for (size_t i = 0; i < entriesCount; ++i) {
+        schedule.AddEntry(i, start + std::chrono::microseconds(period(rnd)));
+    }
+    for (size_t i = 0; i < pollsCount; ++i) {
+        auto item = schedule.GetTop();
+        schedule.Pop();
+        result.push_back(item.Data);
+        // Occasionally reschedule for a long time to exercise upper wheel levels
+        auto delay = (i % 101 == 0) ? std::chrono::hours(5) : std::chrono::microseconds(period(rnd));
+        schedule.AddEntry(item.Data, item.Deadline + delay);
+    }
+}
+
+TEST(PollPlanTest, TimingWheelScheduleEqualsPriorityQueueSchedule)
+{
+    auto now = std::chrono::steady_clock::now();
+    TPriorityQueueSchedule<int, std::less<int>> heap;
+    TIndexedPriorityQueueSchedule<int, std::less<int>> indexedHeap;
+    TTimingWheelSchedule<int, std::less<int>> wheel;
+    std::vector<int> heapResult;
+    std::vector<int> indexedHeapResult;
+    std::vector<int> wheelResult;
+    SimulatePolling(heap, now, 1000, 100000, heapResult);
+    SimulatePolling(indexedHeap, now, 1000, 100000, indexedHeapResult);
+    SimulatePolling(wheel, now, 1000, 100000, wheelResult);
+    EXPECT_EQ(heapResult, indexedHeapResult);
+    EXPECT_EQ(heapResult, wheelResult);
+}
+
+TEST(PollPlanTest, TimingWheelScheduleRemoveAndUpdate)
+{
+    auto now = std::chrono::steady_clock::now();
+    TIndexedPriorityQueueSchedule<int, std::less<int>> heap;
+    TTimingWheelSchedule<int, std::less<int>> wheel;
+    std::mt19937 rnd(1);
+    std::uniform_int_distribution<int> entry(0, 999);
+    std::uniform_int_distribution<int> delay(0, 100000000);
+    for (size_t i = 0; i < 100000; ++i) {
+        auto e = entry(rnd);
+        auto deadline = now + std::chrono::microseconds(delay(rnd));
+        switch (i % 4) {
+            case 0:
+                heap.AddEntry(e, deadline);
+                wheel.AddEntry(e, deadline);
+                break;
+            case 1:
+                ASSERT_EQ(heap.Remove(e), wheel.Remove(e));
+                break;
+            case 2:
+                ASSERT_EQ(heap.UpdateDeadline(e, deadline), wheel.UpdateDeadline(e, deadline));
+                break;
+            default:
+                ASSERT_EQ(heap.IsEmpty(), wheel.IsEmpty());
+                if (!heap.IsEmpty()) {
+                    ASSERT_EQ(heap.GetTop().Data, wheel.GetTop().Data);
+                    ASSERT_EQ(heap.GetDeadline(), wheel.GetDeadline());
+                    heap.Pop();
+                    wheel.Pop();
+                }
+        }
+        ASSERT_EQ(heap.Contains(e), wheel.Contains(e));
+    }
+}
+
+//! Returns the best time of several runs to reduce noise
+template<class TSchedule> std::chrono::milliseconds MeasureSchedule(size_t entriesCount)
+{
+    auto best = std::chrono::steady_clock::duration::max();
+    std::vector<int> result;
+    result.reserve(1000000);
+    for (size_t i = 0; i < 5; ++i) {
+        result.clear();
+        TSchedule schedule;
+        auto start = std::chrono::steady_clock::now();
+        SimulatePolling(schedule, start, entriesCount, 1000000, result);
+        best = std::min(best, std::chrono::steady_clock::now() - start);
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(best);
+}
+
+TEST(PollPlanTest, DISABLED_ScheduleBenchmark)
+{
+    for (size_t entries: {1000, 10000}) {
+        auto heapTime = MeasureSchedule<TPriorityQueueSchedule<int, std::less<int>>>(entries);
+        auto indexedHeapTime = MeasureSchedule<TIndexedPriorityQueueSchedule<int, std::less<int>>>(entries);
+        auto wheelTime = MeasureSchedule<TTimingWheelSchedule<int, std::less<int>>>(entries);
+        std::cout << entries << " entries, 1000000 polls: priority queue " << heapTime.count()
+                  << " ms, indexed d-ary heap " << indexedHeapTime.count() << " ms, timing wheel "
+                  << wheelTime.count() << " ms" << std::endl;
+    }
+}
+
 TEST(PollPlanTest, RateLimiter)
 {
+    auto now = std::chrono::steady_clock::now();
     TRateLimiter limiter(2);
-    limiter.NewItem(std::chrono::steady_clock::now());
-    EXPECT_FALSE(limiter.IsOverLimit(std::chrono::steady_clock::now()));
-    limiter.NewItem(std::chrono::steady_clock::now());
-    EXPECT_FALSE(limiter.IsOverLimit(std::chrono::steady_clock::now()));
-    limiter.NewItem(std::chrono::steady_clock::now());
-    EXPECT_TRUE(limiter.IsOverLimit(std::chrono::steady_clock::now()));
+    limiter.NewItem(now);
+    EXPECT_FALSE(limiter.IsOverLimit(now));
+    EXPECT_EQ(limiter.GetDeadline(now), now);
+    limiter.NewItem(now);
+    EXPECT_TRUE(limiter.IsOverLimit(now));
+    // Tokens are refilled evenly
+    EXPECT_EQ(limiter.GetDeadline(now), now + 500ms);
+    EXPECT_TRUE(limiter.IsOverLimit(now + 499ms));
+    EXPECT_FALSE(limiter.IsOverLimit(now + 500ms));
+    limiter.NewItem(now + 500ms);
+    EXPECT_EQ(limiter.GetDeadline(now + 500ms), now + 1s);
+    // Tokens are not accumulated over burst size
+    limiter.NewItem(now + 10s);
+    limiter.NewItem(now + 10s);
+    EXPECT_TRUE(limiter.IsOverLimit(now + 10s));
+
+    TRateLimiter burstLimiter(2, 1);
+    burstLimiter.NewItem(now);
+    EXPECT_TRUE(burstLimiter.IsOverLimit(now));
+    EXPECT_EQ(burstLimiter.GetDeadline(now), now + 500ms);
+
+    TRateLimiter unlimited(0);
+    for (size_t i = 0; i < 1000; ++i) {
+        unlimited.NewItem(now);
+    }
+    EXPECT_FALSE(unlimited.IsOverLimit(now));
 }
 
 TEST(PollPlanTest, Scheduler)
@@ -74,24 +312,20 @@ TEST(PollPlanTest, Scheduler)
     scheduler.UpdateSelectionTime(1ms, TPriority::High);
     // Emplace another 1 high priority item
     scheduler.AddEntry(7, init + 6us, TPriority::High);
-    // Next 3 low priority items should be taken, throttling (rate limit is 2 per 1s)
+    // Next 2 low priority items should be taken, throttling (rate limit is 2 per 1s)
     EXPECT_EQ(scheduler.AccumulateNext(now, accumulator), TThrottlingState::LowPriorityRateLimit);
-    EXPECT_EQ(accumulator.Data.size(), 3);
+    EXPECT_EQ(accumulator.Data.size(), 2);
     EXPECT_EQ(std::get<0>(accumulator.Data[0]), 2);
     EXPECT_EQ(std::get<1>(accumulator.Data[0]), TItemAccumulationPolicy::Force);
     EXPECT_EQ(std::get<2>(accumulator.Data[0]), std::chrono::milliseconds::zero());
     EXPECT_EQ(std::get<0>(accumulator.Data[1]), 4);
     EXPECT_EQ(std::get<1>(accumulator.Data[1]), TItemAccumulationPolicy::AccordingToPollLimitTime);
     EXPECT_EQ(std::get<2>(accumulator.Data[1]), std::chrono::milliseconds::zero());
-    EXPECT_EQ(std::get<0>(accumulator.Data[2]), 5);
-    EXPECT_EQ(std::get<1>(accumulator.Data[2]), TItemAccumulationPolicy::AccordingToPollLimitTime);
-    EXPECT_EQ(std::get<2>(accumulator.Data[2]), std::chrono::milliseconds::zero());
     accumulator.Data.clear();
     scheduler.UpdateSelectionTime(1ms, TPriority::Low);
     // Wait for 1s (rate limit is 2 per 1s)
-    sleep(1);
-    // Next 1 high priority item should be taken, no throttling
     now += 1s;
+    // Next 1 high priority item should be taken, no throttling
     EXPECT_EQ(scheduler.AccumulateNext(now, accumulator), TThrottlingState::NoThrottling);
     EXPECT_EQ(accumulator.Data.size(), 1);
     EXPECT_EQ(std::get<0>(accumulator.Data[0]), 7);
@@ -99,11 +333,110 @@ TEST(PollPlanTest, Scheduler)
     EXPECT_EQ(std::get<2>(accumulator.Data[0]), std::chrono::milliseconds::max());
     accumulator.Data.clear();
     scheduler.UpdateSelectionTime(1ms, TPriority::High);
-    // Next 1 low priority item should be taken, no throttling
+    // Next 2 low priority items should be taken, throttling (2 tokens are refilled in 1s)
     now += 1ms;
-    EXPECT_EQ(scheduler.AccumulateNext(now, accumulator), TThrottlingState::NoThrottling);
-    EXPECT_EQ(accumulator.Data.size(), 1);
-    EXPECT_EQ(std::get<0>(accumulator.Data[0]), 6);
+    EXPECT_EQ(scheduler.AccumulateNext(now, accumulator), TThrottlingState::LowPriorityRateLimit);
+    EXPECT_EQ(accumulator.Data.size(), 2);
+    EXPECT_EQ(std::get<0>(accumulator.Data[0]), 5);
     EXPECT_EQ(std::get<1>(accumulator.Data[0]), TItemAccumulationPolicy::Force);
     EXPECT_EQ(std::get<2>(accumulator.Data[0]), std::chrono::milliseconds::max());
+    EXPECT_EQ(std::get<0>(accumulator.Data[1]), 6);
+    EXPECT_EQ(std::get<1>(accumulator.Data[1]), TItemAccumulationPolicy::AccordingToPollLimitTime);
+    EXPECT_EQ(std::get<2>(accumulator.Data[1]), std::chrono::milliseconds::max());
+    accumulator.Data.clear();
+    // Next low priority item is allowed when a token is refilled
+    scheduler.AddEntry(8, now, TPriority::Low);
+    EXPECT_EQ(scheduler.GetDeadline(now), now + 500ms);
+}
+
+TEST(PollPlanTest, TimingWheelScheduler)
+{
+    TScheduler<int, std::less<int>, TTimingWheelSchedule> scheduler(1ms, 0);
+    auto init = std::chrono::steady_clock::now();
+    scheduler.AddEntry(1, init, TPriority::High);
+    scheduler.AddEntry(2, init + 1us, TPriority::Low);
+    scheduler.AddEntry(3, init + 2us, TPriority::High);
+    scheduler.AddEntry(4, init + 1s, TPriority::High);
+    EXPECT_TRUE(scheduler.Contains(2));
+    EXPECT_EQ(scheduler.GetDeadline(init), init);
+    scheduler.AddEntry(5, init, TPriority::High);
+    EXPECT_TRUE(scheduler.Remove(5));
+    EXPECT_FALSE(scheduler.Remove(5));
+    Accumulator accumulator;
+    EXPECT_EQ(scheduler.AccumulateNext(init + 1ms, accumulator), TThrottlingState::NoThrottling);
+    EXPECT_EQ(accumulator.Data.size(), 2);
+    EXPECT_EQ(std::get<0>(accumulator.Data[0]), 1);
+    EXPECT_EQ(std::get<0>(accumulator.Data[1]), 3);
+    accumulator.Data.clear();
+    scheduler.UpdateSelectionTime(1ms, TPriority::High);
+    EXPECT_EQ(scheduler.AccumulateNext(init + 1ms, accumulator), TThrottlingState::NoThrottling);
+    EXPECT_EQ(accumulator.Data.size(), 1);
+    EXPECT_EQ(std::get<0>(accumulator.Data[0]), 2);
+    EXPECT_FALSE(scheduler.Contains(2));
+    EXPECT_EQ(scheduler.GetDeadline(init + 1ms), init + 1s);
+}
+
+TEST(PollPlanTest, SchedulerRemoveAndUpdateDeadline)
+{
+    TScheduler<int, std::less<int>> scheduler(1ms, 0);
+    auto init = std::chrono::steady_clock::now();
+    scheduler.AddEntry(1, init, TPriority::High);
+    scheduler.AddEntry(2, init, TPriority::Low);
+    scheduler.AddEntry(3, init + 1s, TPriority::High);
+    EXPECT_TRUE(scheduler.Contains(1));
+    EXPECT_TRUE(scheduler.Remove(1));
+    EXPECT_FALSE(scheduler.Contains(1));
+    EXPECT_FALSE(scheduler.Remove(1));
+    EXPECT_TRUE(scheduler.UpdateDeadline(2, init + 2s));
+    EXPECT_FALSE(scheduler.UpdateDeadline(1, init));
+    EXPECT_EQ(scheduler.GetDeadline(init), init + 1s);
+    EXPECT_TRUE(scheduler.UpdateDeadline(3, init + 3s));
+    EXPECT_EQ(scheduler.GetDeadline(init), init + 2s);
+    EXPECT_EQ(scheduler.GetHighPriorityDeadline(), init + 3s);
+}
+
+TEST(PollPlanTest, SchedulerLowPriorityClasses)
+{
+    // Class 0 has 3 times more bus time than class 1
+    TScheduler<int, std::less<int>> scheduler(1ms, 0, 0, {3, 1});
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i) {
+        scheduler.AddEntry(i, now, TPriority::Low, 0);
+        scheduler.AddEntry(100 + i, now, TPriority::Low, 1);
+    }
+
+    size_t reads[2] = {0, 0};
+    for (size_t i = 0; i < 80; ++i) {
+        int item = -1;
+        auto accumulator = [&](int value, TItemAccumulationPolicy policy, std::chrono::milliseconds pollLimit) {
+            if (item != -1) {
+                return false;
+            }
+            item = value;
+            return true;
+        };
+        scheduler.AccumulateNext(now, accumulator);
+        ASSERT_NE(item, -1);
+        ++reads[item / 100];
+        scheduler.UpdateSelectionTime(10ms, TPriority::Low);
+    }
+    EXPECT_EQ(reads[0], 60);
+    EXPECT_EQ(reads[1], 20);
+
+    // Single class takes all bus time
+    for (int i = 0; i < 100; ++i) {
+        if (scheduler.Contains(i)) {
+            scheduler.Remove(i);
+        }
+    }
+    for (size_t i = 0; i < 20; ++i) {
+        int item = -1;
+        auto accumulator = [&](int value, TItemAccumulationPolicy policy, std::chrono::milliseconds pollLimit) {
+            item = value;
+            return false;
+        };
+        scheduler.AccumulateNext(now, accumulator);
+        EXPECT_GE(item, 100);
+        scheduler.UpdateSelectionTime(10ms, TPriority::Low);
+    }
 }
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "serial_device.h"
+
+#include <optional>
+#include <set>
+#include <vector>
+
+// Port, device and register range without real data exchange for register pollers testing
+
+class TPollTestPort: public TPort
+{
+public:
+    void Open() override
+    {}
+
+    void Close() override
+    {}
+
+    bool IsOpen() const override
+    {
+        return true;
+    }
+
+    void CheckPortOpen() const override
+    {}
+
+    void WriteBytes(const uint8_t* buf, int count) override
+    {}
+
+    uint8_t ReadByte(const std::chrono::microseconds& timeout) override
+    {
+        return 0;
+    }
+
+    TReadFrameResult ReadFrame(uint8_t* buf,
+                               size_t count,
+                               const std::chrono::microseconds& responseTimeout,
+                               const std::chrono::microseconds& frameTimeout,
+                               TFrameCompletePred frame_complete = 0) override
+    {
+        return TReadFrameResult();
+    }
+
+    void SkipNoise() override
+    {}
+
+    void SleepSinceLastInteraction(const std::chrono::microseconds& us) override
+    {}
+
+    //! Sleeps before reading are cut short as if a write is waiting
+    bool WriteWaiting = false;
+
+    bool SleepSinceLastInteractionOrWakeup(const std::chrono::microseconds& us, int wakeupFd) override
+    {
+        return !WriteWaiting;
+    }
+
+    std::string GetDescription(bool verbose = true) const override
+    {
+        return "<poll test port>";
+    }
+};
+
+//! Reads up to MaxRegisters contiguous registers, every register takes RegisterPollTime
+class TPollTestRegisterRange: public TRegisterRange
+{
+    size_t MaxRegisters;
+    std::chrono::milliseconds RegisterPollTime;
+
+public:
+    TPollTestRegisterRange(size_t maxRegisters, std::chrono::milliseconds registerPollTime)
+        : MaxRegisters(maxRegisters),
+          RegisterPollTime(registerPollTime)
+    {}
+
+    bool Add(PRegister reg, std::chrono::milliseconds pollLimit) override
+    {
+        if (reg->GetAvailable() == TRegisterAvailability::UNAVAILABLE) {
+            return true;
+        }
+        if (HasOtherDeviceAndType(reg) || RegisterList().size() >= MaxRegisters) {
+            return false;
+        }
+        if (!RegisterList().empty() &&
+            GetUint32RegisterAddress(RegisterList().back()->GetAddress()) + 1 != GetUint32RegisterAddress(reg->GetAddress()))
+        {
+            return false;
+        }
+        if (RegisterPollTime * (RegisterList().size() + 1) > pollLimit) {
+            return false;
+        }
+        RegisterList().push_back(reg);
+        return true;
+    }
+
+    std::chrono::microseconds GetPollTime() const override
+    {
+        return RegisterPollTime * RegisterList().size();
+    }
+};
+
+class TPollTestDevice: public TSerialDevice
+{
+public:
+    size_t MaxRegisters = 4;
+    std::chrono::milliseconds RegisterPollTime = std::chrono::milliseconds(1);
+
+    //! Addresses of registers which become unavailable after first read
+    std::set<uint32_t> UnsupportedAddresses;
+
+    //! Addresses of registers of every ReadRegisterRange call
+    std::vector<std::vector<uint32_t>> Reads;
+
+    //! Values are written by one request with reads
+    bool WriteAndReadSupported = false;
+
+    //! Writes with reads are rejected by permanent register errors
+    bool WriteAndReadRejected = false;
+
+    //! Addresses of registers written with reads
+    std::vector<uint32_t> WritesWithReads;
+
+    TPollTestDevice(PDeviceConfig config, PPort port, PProtocol protocol): TSerialDevice(config, port, protocol)
+    {}
+
+    bool SupportsWriteAndRead() const override
+    {
+        return WriteAndReadSupported;
+    }
+
+    PRegisterRange CreateRegisterRange() const override
+    {
+        return std::make_shared<TPollTestRegisterRange>(MaxRegisters, RegisterPollTime);
+    }
+
+    void ReadRegisterRange(PRegisterRange range) override
+    {
+        Reads.emplace_back();
+        for (auto& reg: range->RegisterList()) {
+            auto addr = GetUint32RegisterAddress(reg->GetAddress());
+            Reads.back().push_back(addr);
+            if (UnsupportedAddresses.count(addr)) {
+                reg->SetAvailable(TRegisterAvailability::UNAVAILABLE);
+                reg->SetError(TRegister::TError::ReadError);
+            } else {
+                reg->SetAvailable(TRegisterAvailability::AVAILABLE);
+                reg->SetValue(TRegisterValue{addr});
+            }
+        }
+        SetTransferResult(true);
+    }
+
+    PRegister AddRegister(uint32_t addr, std::optional<std::chrono::milliseconds> readPeriod = std::nullopt)
+    {
+        auto config = TRegisterConfig::Create(0, addr);
+        config->ReadPeriod = readPeriod;
+        return std::make_shared<TRegister>(shared_from_this(), config);
+    }
+
+protected:
+    void PrepareImpl() override
+    {}
+
+    void WriteRegisterAndReadRangeImpl(TRegisterWrite& write, PRegisterRange range) override
+    {
+        if (WriteAndReadRejected) {
+            throw TSerialDevicePermanentRegisterException("illegal data address");
+        }
+        if (WriteAndReadSupported) {
+            WritesWithReads.push_back(GetUint32RegisterAddress(write.Register->GetAddress()));
+            ReadRegisterRange(range);
+            write.Done = true;
+        }
+    }
+};
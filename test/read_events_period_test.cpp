@@ -0,0 +1,32 @@
+#include "read_events_period.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+TEST(TReadEventsPeriodTest, Fixed)
+{
+    TReadEventsPeriod period(50ms, 0ms);
+    EXPECT_EQ(period.Get(), 50ms);
+    period.Update(false);
+    EXPECT_EQ(period.Get(), 50ms);
+}
+
+TEST(TReadEventsPeriodTest, Adaptation)
+{
+    TReadEventsPeriod period(50ms, 1050ms);
+    EXPECT_EQ(period.Get(), 50ms);
+
+    // Period slowly grows on a quiet bus
+    period.Update(false);
+    EXPECT_EQ(period.Get(), 150ms);
+    for (size_t i = 0; i < 100; ++i) {
+        period.Update(false);
+    }
+    EXPECT_EQ(period.Get(), 1050ms);
+
+    // and fast decreases when events appear
+    period.Update(true);
+    EXPECT_EQ(period.Get(), 550ms);
+    period.Update(true);
+    EXPECT_EQ(period.Get(), 300ms);
+}
@@ -0,0 +1,477 @@
+#include "poll_test_utils.h"
+#include "read_plan.h"
+#include "serial_client_register_poller.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    std::vector<uint32_t> GetAddresses(const TReadPlanEntry& entry)
+    {
+        std::vector<uint32_t> res;
+        for (const auto& reg: entry.Registers) {
+            res.push_back(GetUint32RegisterAddress(reg->GetAddress()));
+        }
+        return res;
+    }
+
+    std::vector<std::vector<uint32_t>> GetAddresses(const std::vector<PReadPlanEntry>& entries)
+    {
+        std::vector<std::vector<uint32_t>> res;
+        for (const auto& entry: entries) {
+            res.push_back(GetAddresses(*entry));
+        }
+        return res;
+    }
+}
+
+class TReadPlanTest: public testing::Test
+{
+protected:
+    PPort Port;
+    TUint32SlaveIdProtocol Protocol{"test", TRegisterTypes({{0, "test", "value", U16}})};
+    std::shared_ptr<TPollTestDevice> Device;
+
+    void SetUp() override
+    {
+        Port = std::make_shared<TPollTestPort>();
+        Device = std::make_shared<TPollTestDevice>(std::make_shared<TDeviceConfig>("test", "1", "test"),
+                                                   Port,
+                                                   &Protocol);
+    }
+};
+
+TEST_F(TReadPlanTest, WithoutMerging)
+{
+    std::list<PRegister> regs{Device->AddRegister(2), Device->AddRegister(1), Device->AddRegister(3, 100ms)};
+    TReadPlan plan(false, 100ms);
+    plan.Build(regs);
+    ASSERT_EQ(plan.GetDevices().size(), 1);
+    auto& entries = plan.GetEntries(Device);
+    EXPECT_EQ(GetAddresses(entries), std::vector<std::vector<uint32_t>>({{2}, {1}, {3}}));
+    EXPECT_EQ(entries[2]->Priority, TPriority::High);
+    EXPECT_FALSE(plan.NeedsRebuild(*entries[0]));
+}
+
+TEST_F(TReadPlanTest, Merging)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr: {7, 6, 5, 4, 3, 2, 1, 10, 11}) {
+        regs.push_back(Device->AddRegister(addr));
+    }
+    regs.push_back(Device->AddRegister(20, 100ms));
+    regs.push_back(Device->AddRegister(21, 100ms));
+    regs.push_back(Device->AddRegister(22, 200ms));
+    auto excluded = Device->AddRegister(12);
+    excluded->ExcludeFromPolling();
+    regs.push_back(excluded);
+    auto sporadic = Device->AddRegister(13);
+    sporadic->SporadicMode = TRegisterConfig::TSporadicMode::ENABLED;
+    regs.push_back(sporadic);
+
+    // Registers which may be reported by events have their own entries
+    TReadPlan plan(true, 100ms);
+    plan.Build(regs);
+    auto& entries = plan.GetEntries(Device);
+    EXPECT_EQ(GetAddresses(entries),
+              std::vector<std::vector<uint32_t>>({{20, 21}, {22}, {1, 2, 3, 4}, {5, 6, 7}, {10, 11}, {12}, {13}}));
+    EXPECT_EQ(entries[0]->Priority, TPriority::High);
+    EXPECT_EQ(entries[2]->Priority, TPriority::Low);
+    EXPECT_FALSE(plan.NeedsRebuild(*entries[2]));
+
+    // Poll time limit splits ranges
+    Device->RegisterPollTime = 40ms;
+    plan.Rebuild(Device);
+    EXPECT_EQ(GetAddresses(plan.GetEntries(Device)),
+              std::vector<std::vector<uint32_t>>({{20, 21}, {22}, {1, 2}, {3, 4}, {5, 6}, {7}, {10, 11}, {12}, {13}}));
+}
+
+TEST_F(TReadPlanTest, NeedsRebuild)
+{
+    std::list<PRegister> regs{Device->AddRegister(1), Device->AddRegister(2), Device->AddRegister(3)};
+    TReadPlan plan(true, 100ms);
+    plan.Build(regs);
+    auto entry = plan.GetEntries(Device).front();
+    EXPECT_FALSE(plan.NeedsRebuild(*entry));
+
+    regs.front()->SetAvailable(TRegisterAvailability::AVAILABLE);
+    EXPECT_TRUE(plan.NeedsRebuild(*entry));
+    plan.Rebuild(Device);
+    entry = plan.GetEntries(Device).front();
+    EXPECT_FALSE(plan.NeedsRebuild(*entry));
+
+    Device->DeviceConfig()->MaxRegHole = 10;
+    EXPECT_TRUE(plan.NeedsRebuild(*entry));
+    plan.Rebuild(Device);
+    entry = plan.GetEntries(Device).front();
+
+    Device->SetSupportsHoles(false);
+    EXPECT_TRUE(plan.NeedsRebuild(*entry));
+    plan.Rebuild(Device);
+    entry = plan.GetEntries(Device).front();
+
+    // Registers excluded from polling stay in the plan
+    regs.back()->ExcludeFromPolling();
+    EXPECT_FALSE(plan.NeedsRebuild(*entry));
+    plan.Rebuild(Device);
+    EXPECT_EQ(GetAddresses(plan.GetEntries(Device)), std::vector<std::vector<uint32_t>>({{1, 2}, {3}}));
+
+    // Own entry of a register with events isn't rebuilt when events set availability
+    entry = plan.GetEntries(Device).back();
+    regs.back()->SetAvailable(TRegisterAvailability::AVAILABLE);
+    EXPECT_FALSE(plan.NeedsRebuild(*entry));
+
+    regs.front()->SetAvailable(TRegisterAvailability::UNAVAILABLE);
+    EXPECT_TRUE(plan.NeedsRebuild(*plan.GetEntries(Device).front()));
+    plan.Rebuild(Device);
+    EXPECT_EQ(GetAddresses(plan.GetEntries(Device)), std::vector<std::vector<uint32_t>>({{2}, {3}}));
+}
+
+TEST_F(TReadPlanTest, Poller)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr));
+    }
+    Device->UnsupportedAddresses.insert(3);
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.UseReadPlan = true;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges(regs, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    for (size_t i = 0; i < 4; ++i) {
+        spentTime.Start();
+        poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr);
+        time += 1ms;
+    }
+
+    // Register 3 is unavailable after first read, so the plan is rebuilt immediately
+    EXPECT_EQ(Device->Reads, std::vector<std::vector<uint32_t>>({{1, 2, 3, 4}, {4, 5, 6}, {1, 2}, {4, 5, 6}}));
+}
+
+TEST_F(TReadPlanTest, WriteLatencyTarget)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr));
+    }
+    Device->RegisterPollTime = 2ms;
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.WriteLatencyTarget = 5ms;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges(regs, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    for (size_t i = 0; i < 3; ++i) {
+        spentTime.Start();
+        poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr);
+        time += 1ms;
+    }
+
+    // Ranges are limited by 2 registers instead of 4
+    EXPECT_EQ(Device->Reads, std::vector<std::vector<uint32_t>>({{1, 2}, {3, 4}, {5, 6}}));
+}
+
+TEST_F(TReadPlanTest, PendingWritesLatencyTarget)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr));
+    }
+    Device->RegisterPollTime = 2ms;
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.PendingWritesLatencyTarget = 5ms;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges(regs, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&](bool writesPending) {
+        spentTime.Start();
+        poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr, writesPending);
+        time += 1ms;
+    };
+
+    // Ranges are limited only while writes are waiting
+    for (bool writesPending: {false, false, true, true, true, false}) {
+        cycle(writesPending);
+    }
+    EXPECT_EQ(Device->Reads,
+              std::vector<std::vector<uint32_t>>({{1, 2, 3, 4}, {5, 6}, {1, 2}, {3, 4}, {5, 6}, {1, 2, 3, 4}}));
+}
+
+TEST_F(TReadPlanTest, PendingWritesLatencyTargetWithMerging)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr));
+        regs.back()->SetAvailable(TRegisterAvailability::AVAILABLE);
+    }
+    Device->RegisterPollTime = 2ms;
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.UseReadPlan = true;
+    settings.PendingWritesLatencyTarget = 5ms;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges(regs, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&](bool writesPending) {
+        spentTime.Start();
+        poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr, writesPending);
+        time += 1ms;
+    };
+
+    // Planned ranges are full-size without writes and are read by parts while writes are waiting
+    for (bool writesPending: {false, false, true, true, true, false, false}) {
+        cycle(writesPending);
+    }
+    EXPECT_EQ(Device->Reads,
+              std::vector<std::vector<uint32_t>>({{1, 2, 3, 4}, {5, 6}, {1, 2}, {3, 4}, {5, 6}, {1, 2, 3, 4}, {5, 6}}));
+
+    // Reading by parts doesn't rebuild the plan
+    Device->Reads.clear();
+    Device->RegisterPollTime = 3ms;
+    for (bool writesPending: {true, true, true, true, false, false}) {
+        cycle(writesPending);
+    }
+    EXPECT_EQ(Device->Reads, std::vector<std::vector<uint32_t>>({{1}, {2}, {3}, {4}, {5, 6}, {1, 2, 3, 4}}));
+}
+
+TEST_F(TReadPlanTest, WriteCutsGuardIntervalShort)
+{
+    std::list<PRegister> regs;
+    for (uint32_t addr = 1; addr <= 6; ++addr) {
+        regs.push_back(Device->AddRegister(addr));
+        regs.back()->SetAvailable(TRegisterAvailability::AVAILABLE);
+    }
+    Device->RegisterPollTime = 2ms;
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.UseReadPlan = true;
+    settings.PendingWritesLatencyTarget = 5ms;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges(regs, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&](bool writesPending) {
+        spentTime.Start();
+        poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr, writesPending);
+        time += 1ms;
+    };
+
+    // A new write postpones the read of the entry's part, while writes keep coming reads go on
+    auto& port = static_cast<TPollTestPort&>(*Port);
+    cycle(true);
+    port.WriteWaiting = true;
+    cycle(false);
+    cycle(true);
+    port.WriteWaiting = false;
+    cycle(false);
+    cycle(false);
+    EXPECT_EQ(Device->Reads, std::vector<std::vector<uint32_t>>({{1, 2}, {3, 4}, {5, 6}, {1, 2, 3, 4}}));
+    for (const auto& reg: regs) {
+        EXPECT_EQ(reg->GetErrorState().count(), 0);
+    }
+}
+
+TEST_F(TReadPlanTest, SpreadReadPeriodPhases)
+{
+    auto device2 = std::make_shared<TPollTestDevice>(std::make_shared<TDeviceConfig>("test", "2", "test"),
+                                                     Port,
+                                                     &Protocol);
+    std::list<PRegister> regs{Device->AddRegister(1, 100ms),
+                              Device->AddRegister(2, 100ms),
+                              Device->AddRegister(3, 200ms),
+                              Device->AddRegister(4),
+                              device2->AddRegister(1, 100ms)};
+    TReadPlan plan(false, 100ms);
+    plan.Build(regs);
+    auto time = std::chrono::steady_clock::now();
+    auto& entries = plan.GetEntries(Device);
+    auto& entries2 = plan.GetEntries(device2);
+    for (const auto& entry: entries) {
+        entry->Deadline = time;
+    }
+    entries2.front()->Deadline = time;
+    SpreadReadPeriodPhases(plan, time);
+
+    // Registers of a device with the same period stay aligned to be read by one request
+    ASSERT_EQ(entries.size(), 4);
+    for (const auto& entry: entries) {
+        EXPECT_EQ(entry->Deadline, time);
+    }
+    EXPECT_EQ(entries2.front()->Deadline, time + 50ms);
+}
+
+TEST_F(TReadPlanTest, EventsSafetyPollPeriod)
+{
+    auto reg = Device->AddRegister(1, 10ms);
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.EventsSafetyPollPeriod = 100ms;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges({reg}, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&](std::chrono::milliseconds duration) {
+        for (auto end = time + duration; time < end; time += 1ms) {
+            spentTime.Start();
+            poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr);
+        }
+    };
+
+    cycle(1ms);
+    // Events are enabled, the register is read once more by old schedule and then with safety poll period
+    reg->ExcludeFromPolling();
+    cycle(300ms);
+    EXPECT_EQ(Device->Reads.size(), 4);
+
+    // Events reading fails, the register is read as usual
+    poller.SetEventsReadFailed(true, time);
+    cycle(100ms);
+    EXPECT_EQ(Device->Reads.size(), 14);
+
+    poller.SetEventsReadFailed(false, time);
+    cycle(100ms);
+    EXPECT_EQ(Device->Reads.size(), 15);
+
+    // Device is disconnected, events are disabled
+    poller.DeviceDisconnected(Device, time);
+    cycle(100ms);
+    EXPECT_EQ(Device->Reads.size(), 24);
+}
+
+TEST_F(TReadPlanTest, EventsSafetyPollPeriodWithMerging)
+{
+    auto reg = Device->AddRegister(1, 10ms);
+    auto eventsReg = Device->AddRegister(2, 10ms);
+    eventsReg->SporadicMode = TRegisterConfig::TSporadicMode::ENABLED;
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientSettings settings;
+    settings.UseReadPlan = true;
+    settings.EventsSafetyPollPeriod = 100ms;
+    TSerialClientRegisterPoller poller(std::numeric_limits<size_t>::max(), settings);
+    poller.PrepareRegisterRanges({reg, eventsReg}, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&](std::chrono::milliseconds duration) {
+        for (auto end = time + duration; time < end; time += 1ms) {
+            spentTime.Start();
+            poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr);
+        }
+    };
+    auto countReads = [&](uint32_t addr) {
+        return std::count_if(Device->Reads.begin(), Device->Reads.end(), [&](const std::vector<uint32_t>& read) {
+            return std::find(read.begin(), read.end(), addr) != read.end();
+        });
+    };
+
+    cycle(1ms);
+    EXPECT_EQ(Device->Reads, std::vector<std::vector<uint32_t>>({{1, 2}}));
+
+    // Events are enabled, the register is read once more by old schedule and then with safety poll period
+    eventsReg->ExcludeFromPolling();
+    eventsReg->SetAvailable(TRegisterAvailability::AVAILABLE);
+    cycle(300ms);
+    EXPECT_EQ(countReads(2), 4);
+    EXPECT_EQ(countReads(1), 31);
+
+    // Events reading fails, the register is read as usual
+    poller.SetEventsReadFailed(true, time);
+    cycle(100ms);
+    EXPECT_EQ(countReads(2), 14);
+
+    poller.SetEventsReadFailed(false, time);
+    cycle(100ms);
+    EXPECT_EQ(countReads(2), 15);
+
+    // Device is disconnected, events are disabled
+    poller.DeviceDisconnected(Device, time);
+    cycle(100ms);
+    EXPECT_EQ(countReads(2), 24);
+    EXPECT_EQ(countReads(1), 61);
+}
+
+TEST_F(TReadPlanTest, WriteAndRead)
+{
+    std::list<PRegister> regs{Device->AddRegister(1, 10ms), Device->AddRegister(3, 100ms)};
+    auto written = Device->AddRegister(5);
+
+    auto time = std::chrono::steady_clock::now();
+    TSerialClientRegisterPoller poller;
+    poller.PrepareRegisterRanges(regs, time);
+
+    TSerialClientEventsReader eventsReader(1);
+    TSerialClientDeviceAccessHandler accessHandler(eventsReader);
+    util::TSpentTimeMeter spentTime([&]() { return time; });
+    auto cycle = [&]() {
+        spentTime.Start();
+        poller.OpenPortCycle(*Port, spentTime, 100ms, true, accessHandler, nullptr);
+    };
+    cycle();
+    cycle();
+    ASSERT_EQ(Device->Reads.size(), 2);
+
+    // The device doesn't support it
+    time += 5ms;
+    TRegisterWrite write{written, TRegisterValue{1}};
+    poller.WriteRegisterAndRead(write, time, nullptr);
+    EXPECT_FALSE(write.Done);
+    EXPECT_EQ(Device->Reads.size(), 2);
+
+    // The nearest due register is read with the write
+    Device->WriteAndReadSupported = true;
+    std::vector<PRegister> readRegisters;
+    poller.WriteRegisterAndRead(write, time, [&](PRegister reg) { readRegisters.push_back(reg); });
+    EXPECT_TRUE(write.Done);
+    EXPECT_EQ(Device->WritesWithReads, std::vector<uint32_t>({5}));
+    EXPECT_EQ(Device->Reads.back(), std::vector<uint32_t>({1}));
+    EXPECT_EQ(readRegisters, std::vector<PRegister>({regs.front()}));
+
+    // The register read with the write is polled by its period from the write
+    time += 7ms;
+    cycle();
+    EXPECT_EQ(Device->Reads.size(), 3);
+    time += 3ms;
+    cycle();
+    EXPECT_EQ(Device->Reads.size(), 4);
+
+    // Registers rejected with a write aren't read with writes anymore
+    Device->WriteAndReadRejected = true;
+    write.Done = false;
+    poller.WriteRegisterAndRead(write, time, nullptr);
+    EXPECT_FALSE(write.Done);
+    EXPECT_EQ(Device->Reads.size(), 4);
+
+    Device->WriteAndReadRejected = false;
+    poller.WriteRegisterAndRead(write, time, nullptr);
+    EXPECT_TRUE(write.Done);
+    EXPECT_EQ(Device->WritesWithReads, std::vector<uint32_t>({5, 5}));
+    EXPECT_EQ(Device->Reads.back(), std::vector<uint32_t>({3}));
+}
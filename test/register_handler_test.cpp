@@ -0,0 +1,86 @@
+#include "poll_test_utils.h"
+#include "register_handler.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <thread>
+
+TEST(TRegisterHandlerQueueTest, PushAndPop)
+{
+    TRegisterHandler h1(nullptr, nullptr);
+    TRegisterHandler h2(nullptr, nullptr);
+    TRegisterHandlerQueue queue;
+    std::vector<TRegisterHandler*> handlers;
+
+    EXPECT_TRUE(queue.IsEmpty());
+    EXPECT_TRUE(queue.Push(h1));
+    EXPECT_TRUE(queue.Push(h2));
+    EXPECT_FALSE(queue.Push(h1));
+    EXPECT_FALSE(queue.IsEmpty());
+
+    queue.PopAll(handlers);
+    ASSERT_EQ(handlers.size(), 2);
+    EXPECT_EQ(handlers[0], &h1);
+    EXPECT_EQ(handlers[1], &h2);
+    EXPECT_TRUE(queue.IsEmpty());
+
+    // Popped handlers can be pushed again
+    EXPECT_TRUE(queue.Push(h2));
+    handlers.clear();
+    queue.PopAll(handlers);
+    ASSERT_EQ(handlers.size(), 1);
+    EXPECT_EQ(handlers[0], &h2);
+}
+
+TEST(TRegisterHandlerQueueTest, ConcurrentPush)
+{
+    const size_t THREADS_COUNT = 4;
+    const size_t HANDLERS_COUNT = 1000;
+    std::vector<std::unique_ptr<TRegisterHandler>> handlers;
+    for (size_t i = 0; i < HANDLERS_COUNT; ++i) {
+        handlers.emplace_back(std::make_unique<TRegisterHandler>(nullptr, nullptr));
+    }
+    TRegisterHandlerQueue queue;
+
+    // Every handler is pushed by all threads, but must be popped once
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS_COUNT; ++t) {
+        threads.emplace_back([&]() {
+            for (auto& handler: handlers) {
+                queue.Push(*handler);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    std::vector<TRegisterHandler*> popped;
+    queue.PopAll(popped);
+    ASSERT_EQ(popped.size(), HANDLERS_COUNT);
+    std::sort(popped.begin(), popped.end());
+    EXPECT_EQ(std::unique(popped.begin(), popped.end()), popped.end());
+}
+
+TEST(TRegisterHandlerTest, ValueSetTimeOfNewerValue)
+{
+    TUint32SlaveIdProtocol protocol{"test", TRegisterTypes({{0, "test", "value", U16}})};
+    auto device = std::make_shared<TPollTestDevice>(std::make_shared<TDeviceConfig>("test", "1", "test"),
+                                                    std::make_shared<TPollTestPort>(),
+                                                    &protocol);
+    TRegisterHandler handler(device, device->AddRegister(1));
+    auto time = std::chrono::steady_clock::now();
+
+    handler.SetTextValue("1", time);
+    auto value = handler.GetValueToSet();
+
+    // Newer value comes while the older one is written
+    handler.SetTextValue("2", time + std::chrono::seconds(1));
+    EXPECT_EQ(handler.GetValueSetTime(), time);
+
+    handler.SetFlushed(value);
+    EXPECT_TRUE(handler.NeedToFlush());
+    EXPECT_EQ(handler.GetValueSetTime(), time + std::chrono::seconds(1));
+
+    handler.SetFlushed(handler.GetValueToSet());
+    EXPECT_FALSE(handler.NeedToFlush());
+}
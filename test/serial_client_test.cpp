@@ -226,6 +226,42 @@ TEST_F(TSerialClientReopenTest, ReopenTimeout)
     SerialClient->Cycle();
 }
 
+TEST_F(TSerialClientReopenTest, RPCDuringReopenTimeout)
+{
+    // RPC request wakes the port thread and doesn't wait for the next port open attempt
+
+    PRegister reg0 = Reg(0, U8);
+    SerialClient->AddRegister(reg0);
+
+    Port->SetAllowOpen(false);
+
+    Note() << "Cycle() [port open error]";
+    SerialClient->Cycle();
+
+    Port->SetAllowOpen(true);
+    Port->Expect({0x01, 0x02}, {0x03, 0x04}, "RPC");
+
+    PRPCRequest request = std::make_shared<TRPCRequest>();
+    request->ResponseTimeout = std::chrono::milliseconds(500);
+    request->FrameTimeout = std::chrono::milliseconds(0);
+    request->TotalTimeout = std::chrono::seconds(10);
+    request->Message = {0x01, 0x02};
+    request->ResponseSize = 2;
+    request->OnResult = [this](const std::vector<uint8_t>& response) {
+        Emit() << "RPC response size: " << response.size();
+    };
+    request->OnError = [this](const TMqttRpcErrorCode code, const std::string& message) {
+        Emit() << "RPC error: " << message;
+    };
+    SerialClient->RPCTransceive(request);
+
+    Note() << "Cycle() [RPC request]";
+    SerialClient->Cycle();
+
+    Note() << "Cycle() [port is open]";
+    SerialClient->Cycle();
+}
+
 TEST_F(TSerialClientTest, Poll)
 {
 
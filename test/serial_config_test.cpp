@@ -310,3 +310,50 @@ TEST_F(TConfigParserTest, ParseReadonlyParameters)
     EXPECT_EQ(setupItems.size(), 1);
     EXPECT_EQ(setupItems[0]->GetName(), "p2");
 }
+
+TEST_F(TConfigParserTest, ParseModbusTcpConnectionPool)
+{
+    auto portConfigs = GetConfig("configs/parse_test_modbus_tcp_connection_pool.json")->PortConfigs;
+    ASSERT_EQ(portConfigs.size(), 2);
+    EXPECT_NE(portConfigs[0]->Port, portConfigs[1]->Port);
+    ASSERT_EQ(portConfigs[0]->Devices.size(), 2);
+    ASSERT_EQ(portConfigs[1]->Devices.size(), 1);
+    EXPECT_EQ(portConfigs[0]->Devices[0]->DeviceConfig()->Id, "Device1");
+    EXPECT_EQ(portConfigs[1]->Devices[0]->DeviceConfig()->Id, "Device2");
+    EXPECT_EQ(portConfigs[0]->Devices[1]->DeviceConfig()->Id, "Device3");
+    for (const auto& portConfig: portConfigs) {
+        for (const auto& device: portConfig->Devices) {
+            EXPECT_EQ(device->Port(), portConfig->Port);
+        }
+    }
+    ASSERT_EQ(RPCConfig->GetPorts().size(), 1);
+    EXPECT_EQ(RPCConfig->GetPorts()[0]->GetPort(), portConfigs[0]->Port);
+    EXPECT_TRUE(RPCConfig->GetPorts()[0]->HasPort(portConfigs[1]->Port));
+}
+
+TEST_F(TConfigParserTest, PollClass)
+{
+    // Registers with read period are read by the period, so their poll class is ignored
+    auto config = GetConfig("configs/parse_test_poll_class.json");
+    ASSERT_EQ(config->PortConfigs.size(), 1);
+    const auto& channels = config->PortConfigs[0]->Devices[0]->DeviceConfig()->DeviceChannelConfigs;
+    ASSERT_EQ(channels.size(), 3);
+    EXPECT_EQ(channels[0]->RegisterConfigs[0]->PollClass, TRegisterConfig::EPollClass::CRITICAL);
+    EXPECT_EQ(channels[1]->RegisterConfigs[0]->PollClass, TRegisterConfig::EPollClass::NORMAL);
+    EXPECT_EQ(channels[2]->RegisterConfigs[0]->PollClass, TRegisterConfig::EPollClass::NORMAL);
+}
+
+TEST_F(TConfigParserTest, ModbusTcpConnectionPoolRateLimit)
+{
+    // Limits are shared in proportion to channels of connections: 2 and 1
+    auto config = GetConfig("configs/parse_test_modbus_tcp_connection_pool.json");
+    auto rateLimit = config->LowPriorityRegistersRateLimit;
+    ASSERT_EQ(config->PortConfigs.size(), 2);
+    EXPECT_EQ(GetLowPriorityRegistersRateLimit(*config, *config->PortConfigs[0]), rateLimit * 2 / 3);
+    EXPECT_EQ(GetLowPriorityRegistersRateLimit(*config, *config->PortConfigs[1]), rateLimit / 3);
+
+    config = GetConfig("configs/parse_test_modbus_tcp_connection_pool_rate_limit.json");
+    ASSERT_EQ(config->PortConfigs.size(), 2);
+    EXPECT_EQ(GetLowPriorityRegistersRateLimit(*config, *config->PortConfigs[0]), 20);
+    EXPECT_EQ(GetLowPriorityRegistersRateLimit(*config, *config->PortConfigs[1]), 10);
+}